@@ -20,10 +20,12 @@
 #include <stddef.h>
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 #include <tcf/framework/errors.h>
 #include <tcf/framework/cpudefs.h>
 #include <tcf/framework/context.h>
 #include <tcf/framework/myalloc.h>
+#include <tcf/framework/trace.h>
 #include <tcf/services/symbols.h>
 #if ENABLE_ContextMux
 #include <tcf/framework/cpudefs-mdep-mux.h>
@@ -31,6 +33,32 @@
 #include <tcf/cpudefs-mdep.h>
 #include <machine/x86_64/tcf/disassembler-x86_64.h>
 
+#if ENABLE_HardwareBreakpoints && defined(__linux__)
+#  include <linux/perf_event.h>
+#endif
+
+#if !defined(ENABLE_PerfBreakpoints)
+#  if ENABLE_HardwareBreakpoints && defined(__linux__) && defined(PERF_ATTR_SIZE_VER7)
+#    define ENABLE_PerfBreakpoints 1
+#  else
+#    define ENABLE_PerfBreakpoints 0
+#  endif
+#endif
+
+#if ENABLE_PerfBreakpoints
+#  include <errno.h>
+#  include <signal.h>
+#  include <unistd.h>
+#  include <sys/ptrace.h>
+#  include <sys/syscall.h>
+#  include <sys/resource.h>
+#  include <dirent.h>
+#  include <linux/hw_breakpoint.h>
+#  ifndef TRAP_PERF
+#    define TRAP_PERF 6
+#  endif
+#endif
+
 #if defined(__i386__) || defined(__x86_64__)
 
 #define REG_OFFSET(name) offsetof(REG_SET, name)
@@ -1090,12 +1118,18 @@ static void ini_eflags_bits(void) {
 #define ENABLE_BP_ACCESS_INSTRUCTION 0
 
 typedef struct ContextExtensionX86 {
-    ContextBreakpoint * triggered_hw_bps[MAX_HW_BPS + 1];
+    ContextBreakpoint * triggered_hw_bps[MAX_HW_BPS + 2];
     unsigned            hw_bps_regs_generation;
 
     ContextBreakpoint * hw_bps[MAX_HW_BPS];
     unsigned            hw_idx[MAX_HW_BPS];
     unsigned            hw_bps_generation;
+
+#if ENABLE_PerfBreakpoints
+    ContextBreakpoint ** perf_bps;
+    unsigned            perf_bps_cnt;
+    unsigned            perf_bps_max;
+#endif
 } ContextExtensionX86;
 
 static size_t context_extension_offset = 0;
@@ -1152,8 +1186,8 @@ static int set_debug_regs(Context * ctx, int check_ip, int * step_over_hw_bp) {
 
     for (i = 0; i < MAX_HW_BPS; i++) {
         ContextBreakpoint * bp = bps->hw_bps[i];
-        if (bp == NULL) {
-            /* nothing */
+        if (bp == NULL || bp->ext != NULL) {
+            /* Free slot or reserved for a perf_event breakpoint */
         }
         else if (check_ip && bp->address == ip && (bp->access_types & CTX_BP_ACCESS_INSTRUCTION)) {
             /* Skipping the breakpoint */
@@ -1210,6 +1244,234 @@ static int set_debug_regs(Context * ctx, int check_ip, int * step_over_hw_bp) {
     return 0;
 }
 
+#if ENABLE_PerfBreakpoints
+
+/*
+ * Data watchpoints implemented as perf_event breakpoints.
+ * Kernel manages debug registers of every thread of the process, events are
+ * inherited by new threads, and a triggered watchpoint is reported to the tracee
+ * as synchronous SIGTRAP with si_code TRAP_PERF, so planting a watchpoint does not
+ * require stopping threads and rewriting their debug registers with ptrace.
+ * An address range is split into naturally aligned chunks, one event per chunk.
+ * The kernel uses a debug register for each event, so every chunk also reserves
+ * a slot in hw_bps, the slots are not written by set_debug_regs().
+ * Every existing thread needs its own event, planting is refused if the events would
+ * take the second half of RLIMIT_NOFILE, so the agent can still open files and sockets.
+ */
+
+typedef struct PerfBreakpoint {
+    ContextAddress  chunk_addr[MAX_HW_BPS];
+    unsigned        chunk_len[MAX_HW_BPS];
+    unsigned        chunk_cnt;
+    int *           fds;
+    unsigned        fds_cnt;
+    unsigned        fds_max;
+} PerfBreakpoint;
+
+static int perf_bps_disabled = 0;
+
+static int perf_bp_check_fds(unsigned cnt) {
+    struct rlimit lim;
+    struct dirent * e;
+    unsigned open_cnt = 0;
+    DIR * dir = NULL;
+    if (getrlimit(RLIMIT_NOFILE, &lim) < 0) return -1;
+    if (lim.rlim_cur == RLIM_INFINITY) return 0;
+    dir = opendir("/proc/self/fd");
+    if (dir == NULL) return -1;
+    while ((e = readdir(dir)) != NULL) {
+        if (e->d_name[0] != '.') open_cnt++;
+    }
+    closedir(dir);
+    if ((rlim_t)open_cnt + cnt <= lim.rlim_cur / 2) return 0;
+    trace(LOG_CONTEXT, "perf_event watchpoint needs %u file descriptors, %u open, RLIMIT_NOFILE %u",
+        cnt, open_cnt, (unsigned)lim.rlim_cur);
+    set_fmt_errno(ERR_OTHER, "Not enough file descriptors for a watchpoint: need %u, %u open, limit %u",
+        cnt, open_cnt, (unsigned)lim.rlim_cur);
+    return -1;
+}
+
+static int perf_bp_open(pid_t pid, ContextAddress addr, unsigned len, unsigned type) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_BREAKPOINT;
+    attr.size = sizeof(attr);
+    attr.bp_type = type;
+    attr.bp_addr = addr;
+    attr.bp_len = len;
+    attr.sample_period = 1;
+    attr.inherit = 1;
+    attr.inherit_thread = 1;
+    attr.remove_on_exec = 1;
+    attr.sigtrap = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+static void perf_bp_release_slots(ContextBreakpoint * bp) {
+    unsigned i;
+    ContextExtensionX86 * bps = EXT(bp->ctx);
+    for (i = 0; i < MAX_HW_BPS; i++) {
+        if (bps->hw_bps[i] == bp) bps->hw_bps[i] = NULL;
+    }
+}
+
+static void perf_bp_free(PerfBreakpoint * pb) {
+    unsigned i;
+    for (i = 0; i < pb->fds_cnt; i++) close(pb->fds[i]);
+    loc_free(pb->fds);
+    loc_free(pb);
+}
+
+static int perf_bp_plant(ContextBreakpoint * bp) {
+    unsigned type = 0;
+    ContextAddress addr = bp->address;
+    ContextAddress size = bp->length;
+    ContextExtensionX86 * bps = EXT(bp->ctx);
+    PerfBreakpoint * pb = NULL;
+    LINK * l = NULL;
+    unsigned m = 0;
+    unsigned i;
+
+    if (bp->access_types == (CTX_BP_ACCESS_DATA_WRITE | CTX_BP_ACCESS_VIRTUAL)) {
+        type = HW_BREAKPOINT_W;
+    }
+    else if (bp->access_types == (CTX_BP_ACCESS_DATA_READ | CTX_BP_ACCESS_DATA_WRITE | CTX_BP_ACCESS_VIRTUAL)) {
+        type = HW_BREAKPOINT_RW;
+    }
+    else {
+        /* Read-only and instruction breakpoints need debug registers filtering */
+        errno = ERR_UNSUPPORTED;
+        return -1;
+    }
+
+    pb = (PerfBreakpoint *)loc_alloc_zero(sizeof(PerfBreakpoint));
+    while (size > 0) {
+        unsigned len = 8;
+        while (len > 1 && ((addr & (len - 1)) != 0 || len > size)) len >>= 1;
+        if (pb->chunk_cnt >= MAX_HW_BPS) {
+            perf_bp_free(pb);
+            set_errno(ERR_UNSUPPORTED, "Invalid hardware breakpoint: address range is too large");
+            return -1;
+        }
+        pb->chunk_addr[pb->chunk_cnt] = addr;
+        pb->chunk_len[pb->chunk_cnt] = len;
+        pb->chunk_cnt++;
+        addr += len;
+        size -= len;
+    }
+
+    for (i = 0; i < MAX_HW_BPS && m < pb->chunk_cnt; i++) {
+        assert(bps->hw_bps[i] != bp);
+        if (bps->hw_bps[i] == NULL) {
+            bps->hw_bps[i] = bp;
+            bps->hw_idx[i] = m++;
+        }
+    }
+    if (m < pb->chunk_cnt) {
+        perf_bp_release_slots(bp);
+        perf_bp_free(pb);
+        set_errno(ERR_UNSUPPORTED, "All hardware breakpoints are already in use");
+        return -1;
+    }
+
+    /* Check the file descriptor budget before opening events for all threads */
+    for (l = context_root.next; l != &context_root; l = l->next) {
+        Context * c = ctxl2ctxp(l);
+        if (c->exited || !context_has_state(c)) continue;
+        if (context_get_group(c, CONTEXT_GROUP_BREAKPOINT) != bp->ctx) continue;
+        pb->fds_max += pb->chunk_cnt;
+    }
+    if (perf_bp_check_fds(pb->fds_max) < 0) {
+        int error = errno;
+        perf_bp_release_slots(bp);
+        perf_bp_free(pb);
+        errno = error;
+        return -1;
+    }
+    pb->fds = (int *)loc_alloc(sizeof(int) * (pb->fds_max + 1));
+
+    for (l = context_root.next; l != &context_root; l = l->next) {
+        pid_t pid = 0;
+        Context * c = ctxl2ctxp(l);
+        if (c->exited || !context_has_state(c)) continue;
+        if (context_get_group(c, CONTEXT_GROUP_BREAKPOINT) != bp->ctx) continue;
+        pid = id2pid(c->id, NULL);
+        for (i = 0; i < pb->chunk_cnt; i++) {
+            int fd = perf_bp_open(pid, pb->chunk_addr[i], pb->chunk_len[i], type);
+            if (fd < 0) {
+                int error = errno;
+                if (error == ENOSYS || error == EACCES || error == EPERM || error == E2BIG) perf_bps_disabled = 1;
+                perf_bp_release_slots(bp);
+                perf_bp_free(pb);
+                errno = error;
+                return -1;
+            }
+            if (pb->fds_cnt >= pb->fds_max) {
+                pb->fds_max += 16;
+                pb->fds = (int *)loc_realloc(pb->fds, sizeof(int) * pb->fds_max);
+            }
+            pb->fds[pb->fds_cnt++] = fd;
+        }
+    }
+    if (pb->fds_cnt == 0) {
+        perf_bp_release_slots(bp);
+        perf_bp_free(pb);
+        errno = ERR_UNSUPPORTED;
+        return -1;
+    }
+
+    if (bps->perf_bps_cnt >= bps->perf_bps_max) {
+        bps->perf_bps_max += 4;
+        bps->perf_bps = (ContextBreakpoint **)loc_realloc(bps->perf_bps, sizeof(ContextBreakpoint *) * bps->perf_bps_max);
+    }
+    bps->perf_bps[bps->perf_bps_cnt++] = bp;
+    bp->ext = pb;
+    return 0;
+}
+
+static void perf_bp_remove(ContextBreakpoint * bp) {
+    unsigned i;
+    ContextExtensionX86 * bps = EXT(bp->ctx);
+    for (i = 0; i < bps->perf_bps_cnt; i++) {
+        if (bps->perf_bps[i] != bp) continue;
+        bps->perf_bps[i] = bps->perf_bps[--bps->perf_bps_cnt];
+        break;
+    }
+    if (bps->perf_bps_cnt == 0) {
+        loc_free(bps->perf_bps);
+        bps->perf_bps = NULL;
+        bps->perf_bps_max = 0;
+    }
+    perf_bp_release_slots(bp);
+    perf_bp_free((PerfBreakpoint *)bp->ext);
+    bp->ext = NULL;
+}
+
+static ContextBreakpoint * perf_bp_triggered(Context * ctx) {
+    unsigned i, j;
+    siginfo_t info;
+    ContextAddress addr = 0;
+    ContextExtensionX86 * bps = EXT(context_get_group(ctx, CONTEXT_GROUP_BREAKPOINT));
+
+    if (bps->perf_bps_cnt == 0) return NULL;
+    if (ctx->signal != SIGTRAP) return NULL;
+    memset(&info, 0, sizeof(info));
+    if (ptrace(PTRACE_GETSIGINFO, id2pid(ctx->id, NULL), 0, &info) < 0) return NULL;
+    if (info.si_code != TRAP_PERF) return NULL;
+    addr = (ContextAddress)(uintptr_t)info.si_addr;
+    for (i = 0; i < bps->perf_bps_cnt; i++) {
+        PerfBreakpoint * pb = (PerfBreakpoint *)bps->perf_bps[i]->ext;
+        for (j = 0; j < pb->chunk_cnt; j++) {
+            if (pb->chunk_addr[j] == addr) return bps->perf_bps[i];
+        }
+    }
+    return NULL;
+}
+
+#endif /* ENABLE_PerfBreakpoints */
+
 int cpu_bp_get_capabilities(Context * ctx) {
     if (get_DR_definition(0) == NULL) return 0;
     if (ctx != context_get_group(ctx, CONTEXT_GROUP_BREAKPOINT)) return 0;
@@ -1225,6 +1487,13 @@ int cpu_bp_get_capabilities(Context * ctx) {
 int cpu_bp_plant(ContextBreakpoint * bp) {
     Context * ctx = bp->ctx;
     assert(bp->access_types);
+#if ENABLE_PerfBreakpoints
+    if (!perf_bps_disabled && (bp->access_types & CTX_BP_ACCESS_INSTRUCTION) == 0) {
+        if (perf_bp_plant(bp) == 0) return 0;
+        /* Ranges that don't fit debug registers cannot be handled by the fallback */
+        if (bp->length > 8) return -1;
+    }
+#endif
     if (bp->access_types & CTX_BP_ACCESS_VIRTUAL) {
         ContextExtensionX86 * bps = EXT(ctx);
         if (bp->length <= 8 && ((1u << bp->length) & 0x116u)) {
@@ -1299,6 +1568,12 @@ int cpu_bp_remove(ContextBreakpoint * bp) {
     LINK * l = NULL;
     Context * ctx = bp->ctx;
     ContextExtensionX86 * bps = EXT(ctx);
+#if ENABLE_PerfBreakpoints
+    if (bp->ext != NULL) {
+        perf_bp_remove(bp);
+        return 0;
+    }
+#endif
     for (i = 0; i < MAX_HW_BPS; i++) {
         if (bps->hw_bps[i] == bp) {
             bps->hw_bps[i] = NULL;
@@ -1329,8 +1604,20 @@ int cpu_bp_on_resume(Context * ctx, int * single_step) {
 int cpu_bp_on_suspend(Context * ctx, int * triggered) {
     unsigned cb_cnt = 0;
     uint8_t dr6 = 0;
+#if ENABLE_PerfBreakpoints
+    ContextBreakpoint * perf_bp = NULL;
+#endif
 
     if (ctx->exiting) return 0;
+#if ENABLE_PerfBreakpoints
+    perf_bp = perf_bp_triggered(ctx);
+    if (perf_bp != NULL) {
+        ContextExtensionX86 * ext = EXT(ctx);
+        ext->triggered_hw_bps[cb_cnt++] = perf_bp;
+        ctx->stopped_by_cb = ext->triggered_hw_bps;
+        ctx->stopped_by_cb[cb_cnt] = NULL;
+    }
+#endif
     if (context_read_reg(ctx, get_DR_definition(6), 0, sizeof(dr6), &dr6) < 0) return -1;
 
     if (dr6 & 0xfu) {
@@ -1340,7 +1627,7 @@ int cpu_bp_on_suspend(Context * ctx, int * triggered) {
         for (i = 0; i < MAX_HW_BPS; i++) {
             if (dr6 & ((uint32_t)1 << i)) {
                 ContextBreakpoint * bp = bps->hw_bps[i];
-                if (bp == NULL) continue;
+                if (bp == NULL || bp->ext != NULL) continue;
                 if (bp->access_types == (CTX_BP_ACCESS_DATA_READ | CTX_BP_ACCESS_VIRTUAL)) {
                     if (skip_read_only_breakpoint(ctx, dr6, bp)) continue;
                 }
@@ -33,6 +33,7 @@
 #include <ctype.h>
 #include <asm/unistd.h>
 #include <sys/ptrace.h>
+#include <sys/uio.h>
 #include <sys/utsname.h>
 #include <linux/kdev_t.h>
 #include <tcf/framework/mdep-fs.h>
@@ -87,6 +88,13 @@
 
 #define USE_PTRACE_SYSCALL      0
 
+/* PTRACE_SEIZE, PTRACE_INTERRUPT and PTRACE_LISTEN are available since Linux 3.4 */
+#if defined(PTRACE_SEIZE) && defined(PTRACE_INTERRUPT) && defined(PTRACE_LISTEN)
+#define USE_PTRACE_SEIZE        1
+#else
+#define USE_PTRACE_SEIZE        0
+#endif
+
 #if defined(__arm__) || defined(__aarch64__)
 #if !defined(PTRACE_GETVFPREGS)
 #define PTRACE_GETVFPREGS       (enum __ptrace_request)27
@@ -123,16 +131,25 @@ typedef struct ContextExtensionLinux {
     REG_SET *               regs;               /* copy of context registers, updated on request */
     uint8_t *               regs_valid;
     uint8_t *               regs_dirty;
+    unsigned                regs_banks_valid;   /* bit mask of register banks that are cached */
     int                     pending_step;
     int                     stop_cnt;
     int                     sigstop_posted;
     int                     sigkill_posted;
+#if USE_PTRACE_SEIZE
+    int                     group_stop;         /* seized thread is in job control group-stop */
+#endif
     int                     detach_req;
     int                     crt0_done;
 #if ENABLE_ProfilerSST
     int                     prof_armed;
     int                     prof_fired;
 #endif
+#if ENABLE_MemoryPageCache
+    struct MemPage **       mem_pages;          /* page cache hash table, valid while all threads are stopped */
+    unsigned                mem_pages_cnt;
+    ContextAddress          mem_last_miss;
+#endif
 } ContextExtensionLinux;
 
 static size_t context_extension_offset = 0;
@@ -146,6 +163,170 @@ static LINK detach_list = TCF_LIST_INIT(detach_list);
 
 static MemoryErrorInfo mem_err_info;
 
+#if ENABLE_MemoryPageCache
+
+#define MEM_PAGE_SIZE           0x1000
+#define MEM_PAGE_HASH_SIZE      251
+#define MEM_PAGE_CACHE_MAX      256
+#define MEM_PAGE_READ_AHEAD     8
+
+typedef struct MemPage {
+    struct MemPage * next;
+    ContextAddress addr;
+    uint8_t data[MEM_PAGE_SIZE];
+} MemPage;
+
+static int mem_cache_disabled = 0;
+
+static void flush_mem_cache(Context * ctx) {
+    ContextExtensionLinux * ext = EXT(ctx);
+    unsigned i;
+    if (ext->mem_pages == NULL) return;
+    for (i = 0; i < MEM_PAGE_HASH_SIZE; i++) {
+        while (ext->mem_pages[i] != NULL) {
+            MemPage * p = ext->mem_pages[i];
+            ext->mem_pages[i] = p->next;
+            loc_free(p);
+        }
+    }
+    loc_free(ext->mem_pages);
+    ext->mem_pages = NULL;
+    ext->mem_pages_cnt = 0;
+    ext->mem_last_miss = 0;
+}
+
+static void invalidate_mem_cache(Context * ctx, ContextAddress address, size_t size) {
+    ContextExtensionLinux * ext = EXT(ctx);
+    ContextAddress addr = address & ~(ContextAddress)(MEM_PAGE_SIZE - 1);
+    if (ext->mem_pages == NULL) return;
+    while (addr < address + size) {
+        MemPage ** h = ext->mem_pages + (unsigned)(addr / MEM_PAGE_SIZE % MEM_PAGE_HASH_SIZE);
+        while (*h != NULL) {
+            MemPage * p = *h;
+            if (p->addr == addr) {
+                *h = p->next;
+                loc_free(p);
+                ext->mem_pages_cnt--;
+                break;
+            }
+            h = &p->next;
+        }
+        if (addr + MEM_PAGE_SIZE < addr) break;
+        addr += MEM_PAGE_SIZE;
+    }
+}
+
+static int is_mem_cache_valid(Context * prs) {
+    /* Memory contents can be cached only while every thread of the process is stopped */
+    LINK * l = prs->children.next;
+    if (prs->exited || prs->exiting) return 0;
+    while (l != &prs->children) {
+        Context * c = cldl2ctxp(l);
+        if (!c->exited && (!c->stopped || c->exiting)) return 0;
+        l = l->next;
+    }
+    return 1;
+}
+
+static MemPage * load_mem_page(Context * prs, ContextAddress addr) {
+    ContextExtensionLinux * ext = EXT(prs);
+    unsigned n = 1;
+    unsigned i;
+    ssize_t rd = 0;
+    MemPage * pages[MEM_PAGE_READ_AHEAD];
+    struct iovec local[MEM_PAGE_READ_AHEAD];
+    struct iovec remote;
+
+    /* Read ahead when pages are accessed sequentially */
+    if (ext->mem_last_miss + MEM_PAGE_SIZE == addr) n = MEM_PAGE_READ_AHEAD;
+    ext->mem_last_miss = addr;
+    if (ext->mem_pages_cnt + n > MEM_PAGE_CACHE_MAX) flush_mem_cache(prs);
+    for (i = 0; i < n; i++) {
+        if (addr + (ContextAddress)(i + 1) * MEM_PAGE_SIZE < addr) break;
+        pages[i] = (MemPage *)loc_alloc(sizeof(MemPage));
+        pages[i]->addr = addr + (ContextAddress)i * MEM_PAGE_SIZE;
+        local[i].iov_base = pages[i]->data;
+        local[i].iov_len = MEM_PAGE_SIZE;
+    }
+    n = i;
+    if (n == 0) return NULL;
+    remote.iov_base = (void *)addr;
+    remote.iov_len = (size_t)n * MEM_PAGE_SIZE;
+#if defined(__NR_process_vm_readv)
+    rd = syscall(__NR_process_vm_readv, ext->pid, local, n, &remote, 1, 0);
+#else
+    rd = -1;
+    errno = ENOSYS;
+#endif
+    if (rd < 0 && (errno == ENOSYS || errno == EPERM)) {
+        trace(LOG_CONTEXT, "context: memory page cache disabled: %s", errno_to_str(errno));
+        mem_cache_disabled = 1;
+    }
+    if (ext->mem_pages == NULL) ext->mem_pages = (MemPage **)loc_alloc_zero(sizeof(MemPage *) * MEM_PAGE_HASH_SIZE);
+    for (i = 0; i < n; i++) {
+        MemPage * p = pages[i];
+        MemPage ** h = ext->mem_pages + (unsigned)(p->addr / MEM_PAGE_SIZE % MEM_PAGE_HASH_SIZE);
+        MemPage * q = *h;
+        /* Don't replace read-ahead pages that are already cached */
+        while (q != NULL && q->addr != p->addr) q = q->next;
+        if (q != NULL || rd < (ssize_t)(i + 1) * MEM_PAGE_SIZE) {
+            loc_free(p);
+            pages[i] = NULL;
+        }
+        else {
+            p->next = *h;
+            *h = p;
+            ext->mem_pages_cnt++;
+        }
+    }
+    return pages[0];
+}
+
+static int read_mem_cache(Context * ctx, ContextAddress address, void * buf, size_t size) {
+    /* Returns 0 if the data was copied from the page cache, otherwise -1 */
+    Context * prs = ctx->mem;
+    ContextExtensionLinux * ext = NULL;
+    ContextAddress addr = address;
+
+    if (mem_cache_disabled || prs == NULL || EXT(prs)->pid == 0) return -1;
+    if (!is_mem_cache_valid(prs)) {
+        flush_mem_cache(prs);
+        return -1;
+    }
+    ext = EXT(prs);
+    while (addr < address + size) {
+        ContextAddress page_addr = addr & ~(ContextAddress)(MEM_PAGE_SIZE - 1);
+        size_t offs = (size_t)(addr - page_addr);
+        size_t n = MEM_PAGE_SIZE - offs;
+        MemPage * p = NULL;
+        if (ext->mem_pages != NULL) {
+            p = ext->mem_pages[(unsigned)(page_addr / MEM_PAGE_SIZE % MEM_PAGE_HASH_SIZE)];
+            while (p != NULL && p->addr != page_addr) p = p->next;
+        }
+        if (p == NULL) p = load_mem_page(prs, page_addr);
+        if (p == NULL) return -1;
+        if (n > address + size - addr) n = (size_t)(address + size - addr);
+        memcpy((char *)buf + (addr - address), p->data + offs, n);
+        addr += n;
+    }
+    return 0;
+}
+
+static void mem_cache_context_changed(Context * ctx, void * args) {
+    if (ctx->mem != NULL && EXT(ctx->mem)->mem_pages != NULL) flush_mem_cache(ctx->mem);
+}
+
+static ContextEventListener mem_cache_listener = {
+    NULL,
+    mem_cache_context_changed,
+    NULL,
+    mem_cache_context_changed,
+    mem_cache_context_changed,
+    mem_cache_context_changed
+};
+
+#endif /* ENABLE_MemoryPageCache */
+
 static const char * event_name(int event) {
     switch (event) {
     case 0: return "none";
@@ -155,6 +336,9 @@ static const char * event_name(int event) {
     case PTRACE_EVENT_EXEC: return "exec";
     case PTRACE_EVENT_VFORK_DONE: return "vfork-done";
     case PTRACE_EVENT_EXIT: return "exit";
+#if USE_PTRACE_SEIZE
+    case PTRACE_EVENT_STOP: return "stop";
+#endif
     }
     trace(LOG_ALWAYS, "event_name(): unexpected event code %d", event);
     return "unknown";
@@ -216,12 +400,112 @@ static void get_thread_ids(pid_t pid, int * cnt, pid_t ** pids) {
     *pids = thread_pid;
 }
 
+#if USE_PTRACE_SEIZE
+
+typedef struct SeizeDoneArgs {
+    Context * ctx;
+    ContextAttachCallBack * done;
+    void * data;
+} SeizeDoneArgs;
+
+static void seize_done(void * x) {
+    SeizeDoneArgs * args = (SeizeDoneArgs *)x;
+    args->done(args->ctx->exited ? ERR_ALREADY_EXITED : 0, args->ctx, args->data);
+    context_unlock(args->ctx);
+    loc_free(args);
+}
+
+static Context * add_thread(Context * parent, Context * creator, pid_t pid);
+
+static void add_seized_thread(Context * prs, pid_t pid) {
+    Context * ctx = NULL;
+    add_waitpid_process(pid);
+    ctx = add_thread(prs, NULL, pid);
+    /* Seized thread keeps running, no initial stop is expected */
+    EXT(ctx)->sigstop_posted = 0;
+    EXT(ctx)->ptrace_flags = PTRACE_FLAGS;
+}
+
+static int seize_threads(Context * prs) {
+    int n;
+    int cnt = 0;
+    int seized = 0;
+    pid_t * pids = NULL;
+
+    get_thread_ids(EXT(prs)->pid, &cnt, &pids);
+    for (n = 0; n < cnt; n++) {
+        if (context_find_from_pid(pids[n], 1) != NULL) continue;
+        if (ptrace(PTRACE_SEIZE, pids[n], 0, PTRACE_FLAGS) < 0) {
+            /* The thread has exited or is already traced by us as a clone child */
+            if (errno != ESRCH && errno != EPERM) {
+                trace(LOG_ALWAYS, "error: ptrace(PTRACE_SEIZE) failed: pid %d, error %d %s",
+                    pids[n], errno, errno_to_str(errno));
+            }
+            continue;
+        }
+        add_seized_thread(prs, pids[n]);
+        seized++;
+    }
+    return seized;
+}
+
+/*
+ * Attach to a process without stopping it.
+ * Threads are seized one after another - PTRACE_SEIZE does not wait for the thread to stop,
+ * so attaching to a process with thousands of threads does not disturb them.
+ * Threads are reported to clients as running, and are stopped individually,
+ * with PTRACE_INTERRUPT, only when a client or the agent needs them stopped.
+ */
+static int context_seize(pid_t pid, ContextAttachCallBack * done, void * data, int mode) {
+    Context * prs = NULL;
+    ContextExtensionLinux * ext = NULL;
+    SeizeDoneArgs * args = NULL;
+
+    if (ptrace(PTRACE_SEIZE, pid, 0, PTRACE_FLAGS) < 0) {
+        int err = errno;
+        trace(LOG_ALWAYS, "error: ptrace(PTRACE_SEIZE) failed: pid %d, error %d %s",
+            pid, err, errno_to_str(err));
+        errno = err;
+        return -1;
+    }
+    prs = create_context(pid2id(pid, 0));
+    prs->mem = prs;
+    prs->mem_access |= MEM_ACCESS_INSTRUCTION;
+    prs->mem_access |= MEM_ACCESS_DATA;
+    prs->mem_access |= MEM_ACCESS_USER;
+    prs->big_endian = big_endian_host();
+    ext = EXT(prs);
+    ext->pid = pid;
+    ext->attach_mode = mode;
+    link_context(prs);
+    send_context_created_event(prs);
+
+    add_seized_thread(prs, pid);
+    /* Threads created while seizing are either auto-attached by PTRACE_O_TRACECLONE, or found by next scan */
+    while (seize_threads(prs) > 0) {}
+
+    args = (SeizeDoneArgs *)loc_alloc_zero(sizeof(SeizeDoneArgs));
+    args->ctx = prs;
+    args->done = done;
+    args->data = data;
+    context_lock(prs);
+    post_event(seize_done, args);
+    return 0;
+}
+
+#endif /* USE_PTRACE_SEIZE */
+
 int context_attach(pid_t pid, ContextAttachCallBack * done, void * data, int mode) {
     Context * ctx = NULL;
     ContextExtensionLinux * ext = NULL;
 
     assert(done != NULL);
     trace(LOG_CONTEXT, "context: attaching pid %d", pid);
+#if USE_PTRACE_SEIZE
+    if ((mode & CONTEXT_ATTACH_NON_STOP) != 0 && (mode & CONTEXT_ATTACH_SELF) == 0) {
+        return context_seize(pid, done, data, mode);
+    }
+#endif
     if ((mode & CONTEXT_ATTACH_SELF) == 0 && ptrace(PTRACE_ATTACH, pid, 0, 0) < 0) {
         int err = errno;
         trace(LOG_ALWAYS, "error: ptrace(PTRACE_ATTACH) failed: pid %d, error %d %s",
@@ -292,6 +576,15 @@ static int get_process_state(pid_t pid) {
     return ch;
 }
 
+static int post_stop_request(Context * ctx) {
+    ContextExtensionLinux * ext = EXT(ctx);
+#if USE_PTRACE_SEIZE
+    /* Seized threads are stopped without a signal, other threads of the process are not disturbed */
+    if (ext->attach_mode & CONTEXT_ATTACH_NON_STOP) return ptrace(PTRACE_INTERRUPT, ext->pid, 0, 0) < 0 ? -1 : 0;
+#endif
+    return tkill(ext->pid, SIGSTOP) < 0 ? -1 : 0;
+}
+
 int context_stop(Context * ctx) {
     ContextExtensionLinux * ext = EXT(ctx);
     trace(LOG_CONTEXT, "context:%s suspending ctx %#lx id %s",
@@ -319,7 +612,7 @@ int context_stop(Context * ctx) {
         trace(LOG_ALWAYS, "error: waiting too long to stop %s, stat %c", ctx->id, ch);
     }
     if (!ext->sigstop_posted) {
-        if (tkill(ext->pid, SIGSTOP) < 0) {
+        if (post_stop_request(ctx) < 0) {
             int err = errno;
             if (err == ESRCH) {
                 set_context_state_name(ctx, "Exited");
@@ -327,7 +620,7 @@ int context_stop(Context * ctx) {
                 return 0;
             }
             trace(LOG_ALWAYS,
-                "error: tkill(SIGSTOP) failed: ctx %#lx, id %s, error %d %s",
+                "error: cannot stop: ctx %#lx, id %s, error %d %s",
                 ctx, ctx->id, err, errno_to_str(err));
             errno = err;
             return -1;
@@ -356,67 +649,178 @@ static void alloc_regs(Context * ctx) {
     ext->regs = (REG_SET *)loc_alloc_zero(sizeof(REG_SET));
     ext->regs_valid = (uint8_t *)loc_alloc_zero(sizeof(REG_SET));
     ext->regs_dirty = (uint8_t *)loc_alloc_zero(sizeof(REG_SET));
+    ext->regs_banks_valid = 0;
 }
 
-static int flush_regs(Context * ctx) {
-    ContextExtensionLinux * ext = EXT(ctx);
-    size_t i = 0;
-    int err = 0;
+/*
+ * Register banks: parts of REG_SET that are transferred with a single ptrace request.
+ * A bank is read as a whole when any of its bytes is accessed first time after a stop,
+ * and written back as a whole, once, before the context is resumed.
+ * Bytes of REG_SET that are not covered by a bank are accessed one word at a time.
+ */
+typedef struct RegisterBank {
+    size_t offs;
+    size_t size;
+    int (*read)(pid_t pid, REG_SET * regs);
+    int (*write)(pid_t pid, REG_SET * regs, uint8_t * dirty);
+} RegisterBank;
 
-    for (i = 0; i < sizeof(REG_SET); i++) {
-        if (!ext->regs_dirty[i]) continue;
-#ifdef MDEP_OtherRegisters
-        if (i >= offsetof(REG_SET, other) && i < offsetof(REG_SET, other) + sizeof(ext->regs->other)) {
-            size_t offs = 0;
-            size_t size = 0;
-            size_t j = i + 1;
-            while (j < offsetof(REG_SET, other) + sizeof(ext->regs->other) && ext->regs_dirty[j]) j++;
-            if (mdep_set_other_regs(ext->pid, ext->regs, i, j - i, &offs, &size) < 0) {
-                err = errno;
-                break;
-            }
-            assert(i >= offs);
-            assert(i < offs + size);
-            memset(ext->regs_dirty + offs, 0, size);
-            continue;
-        }
-#endif
 #ifdef MDEP_UseREGSET
-        if (i >= offsetof(REG_SET, gp) && i < offsetof(REG_SET, gp) + sizeof(ext->regs->gp)) {
-            struct iovec buf;
-            buf.iov_base = &ext->regs->gp;
-            buf.iov_len = sizeof(ext->regs->gp);
-            if (ptrace(PTRACE_SETREGSET, ext->pid, REGSET_GP, &buf) < 0) {
-                err = errno;
-                break;
-            }
-            memset(ext->regs_dirty + offsetof(REG_SET, gp), 0, sizeof(ext->regs->gp));
-            continue;
-        }
-        if (i >= offsetof(REG_SET, fp) && i < offsetof(REG_SET, fp) + sizeof(ext->regs->fp)) {
-            struct iovec buf;
-            buf.iov_base = &ext->regs->fp;
-            buf.iov_len = sizeof(ext->regs->fp);
-            if (ptrace(PTRACE_SETREGSET, ext->pid, REGSET_FP, &buf) < 0) {
-                err = errno;
-                break;
-            }
-            memset(ext->regs_dirty + offsetof(REG_SET, fp), 0, sizeof(ext->regs->fp));
-            continue;
-        }
+static int read_gp_regs(pid_t pid, REG_SET * regs) {
+    struct iovec buf;
+    buf.iov_base = &regs->gp;
+    buf.iov_len = sizeof(regs->gp);
+    return ptrace(PTRACE_GETREGSET, pid, REGSET_GP, &buf) < 0 ? -1 : 0;
+}
+
+static int write_gp_regs(pid_t pid, REG_SET * regs, uint8_t * dirty) {
+    struct iovec buf;
+    buf.iov_base = &regs->gp;
+    buf.iov_len = sizeof(regs->gp);
+    return ptrace(PTRACE_SETREGSET, pid, REGSET_GP, &buf) < 0 ? -1 : 0;
+}
+
+static int read_fp_regs(pid_t pid, REG_SET * regs) {
+    struct iovec buf;
+    buf.iov_base = &regs->fp;
+    buf.iov_len = sizeof(regs->fp);
+    return ptrace(PTRACE_GETREGSET, pid, REGSET_FP, &buf) < 0 ? -1 : 0;
+}
+
+static int write_fp_regs(pid_t pid, REG_SET * regs, uint8_t * dirty) {
+    struct iovec buf;
+    buf.iov_base = &regs->fp;
+    buf.iov_len = sizeof(regs->fp);
+    return ptrace(PTRACE_SETREGSET, pid, REGSET_FP, &buf) < 0 ? -1 : 0;
+}
 #else
-        if (i >= offsetof(REG_SET, fp) && i < offsetof(REG_SET, fp) + sizeof(ext->regs->fp)) {
+static int read_gp_regs(pid_t pid, REG_SET * regs) {
+    return ptrace(PTRACE_GETREGS, pid, 0, &regs->user.regs) < 0 ? -1 : 0;
+}
+
+static int write_gp_regs(pid_t pid, REG_SET * regs, uint8_t * dirty) {
+    return ptrace(PTRACE_SETREGS, pid, 0, &regs->user.regs) < 0 ? -1 : 0;
+}
+
+static int read_fp_regs(pid_t pid, REG_SET * regs) {
 #if defined(__arm__) || defined(__aarch64__)
-            if (ptrace(PTRACE_SETVFPREGS, ext->pid, 0, &ext->regs->fp) < 0) {
+    return ptrace(PTRACE_GETVFPREGS, pid, 0, &regs->fp) < 0 ? -1 : 0;
 #else
-            if (ptrace(PTRACE_SETFPREGS, ext->pid, 0, &ext->regs->fp) < 0) {
+    return ptrace(PTRACE_GETFPREGS, pid, 0, &regs->fp) < 0 ? -1 : 0;
 #endif
-                err = errno;
-                break;
-            }
-            memset(ext->regs_dirty + offsetof(REG_SET, fp), 0, sizeof(ext->regs->fp));
-            continue;
+}
+
+static int write_fp_regs(pid_t pid, REG_SET * regs, uint8_t * dirty) {
+#if defined(__arm__) || defined(__aarch64__)
+    return ptrace(PTRACE_SETVFPREGS, pid, 0, &regs->fp) < 0 ? -1 : 0;
+#else
+    return ptrace(PTRACE_SETFPREGS, pid, 0, &regs->fp) < 0 ? -1 : 0;
+#endif
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+#define DEBUG_REGS_CNT (sizeof(((REG_SET *)0)->user.u_debugreg) / sizeof(ContextAddress))
+
+static int read_debug_regs(pid_t pid, REG_SET * regs) {
+    unsigned i;
+    for (i = 0; i < DEBUG_REGS_CNT; i++) {
+        size_t offs = offsetof(struct user, u_debugreg) + i * sizeof(ContextAddress);
+        errno = 0;
+        regs->user.u_debugreg[i] = ptrace(PTRACE_PEEKUSER, pid, (void *)offs, 0);
+        if (errno != 0) return -1;
+    }
+    return 0;
+}
+
+static int write_debug_regs(pid_t pid, REG_SET * regs, uint8_t * dirty) {
+    unsigned i;
+    /* Only modified registers are written, in ascending order, so DR7 is written after DR0-DR3 */
+    for (i = 0; i < DEBUG_REGS_CNT; i++) {
+        size_t offs = offsetof(struct user, u_debugreg) + i * sizeof(ContextAddress);
+        if (*(ContextAddress *)(dirty + i * sizeof(ContextAddress)) == 0) continue;
+        if (ptrace(PTRACE_POKEUSER, pid, (void *)offs, (void *)regs->user.u_debugreg[i]) < 0) return -1;
+    }
+    return 0;
+}
+#endif
+#endif
+
+#ifdef MDEP_OtherRegisters
+static int read_other_regs(pid_t pid, REG_SET * regs) {
+    size_t offs = 0;
+    size_t size = 0;
+    return mdep_get_other_regs(pid, regs, offsetof(REG_SET, other), sizeof(regs->other), &offs, &size);
+}
+
+static int write_other_regs(pid_t pid, REG_SET * regs, uint8_t * dirty) {
+    size_t offs = 0;
+    size_t size = 0;
+    return mdep_set_other_regs(pid, regs, offsetof(REG_SET, other), sizeof(regs->other), &offs, &size);
+}
+#endif
+
+static RegisterBank reg_banks[] = {
+#ifdef MDEP_UseREGSET
+    { offsetof(REG_SET, gp), sizeof(((REG_SET *)0)->gp), read_gp_regs, write_gp_regs },
+#else
+    { offsetof(REG_SET, user.regs), sizeof(((REG_SET *)0)->user.regs), read_gp_regs, write_gp_regs },
+#if defined(__i386__) || defined(__x86_64__)
+    { offsetof(REG_SET, user.u_debugreg), sizeof(((REG_SET *)0)->user.u_debugreg), read_debug_regs, write_debug_regs },
+#endif
+#endif
+    { offsetof(REG_SET, fp), sizeof(((REG_SET *)0)->fp), read_fp_regs, write_fp_regs },
+#ifdef MDEP_OtherRegisters
+    { offsetof(REG_SET, other), sizeof(((REG_SET *)0)->other), read_other_regs, write_other_regs },
+#endif
+};
+
+#define REG_BANKS_CNT (sizeof(reg_banks) / sizeof(RegisterBank))
+
+static RegisterBank * find_reg_bank(size_t offs) {
+    unsigned i;
+    for (i = 0; i < REG_BANKS_CNT; i++) {
+        RegisterBank * bank = reg_banks + i;
+        if (offs >= bank->offs && offs < bank->offs + bank->size) return bank;
+    }
+    return NULL;
+}
+
+static void invalidate_regs(Context * ctx) {
+    ContextExtensionLinux * ext = EXT(ctx);
+    memset(ext->regs_valid, 0, sizeof(REG_SET));
+    ext->regs_banks_valid = 0;
+}
+
+static int is_bank_dirty(uint8_t * dirty, RegisterBank * bank) {
+    size_t i;
+    for (i = 0; i < bank->size; i++) {
+        if (dirty[bank->offs + i]) return 1;
+    }
+    return 0;
+}
+
+static int flush_regs(Context * ctx) {
+    ContextExtensionLinux * ext = EXT(ctx);
+    size_t i = 0;
+    unsigned b;
+    int err = 0;
+
+    for (b = 0; b < REG_BANKS_CNT; b++) {
+        RegisterBank * bank = reg_banks + b;
+        if (!is_bank_dirty(ext->regs_dirty, bank)) continue;
+        assert(ext->regs_banks_valid & (1u << b));
+        if (bank->write(ext->pid, ext->regs, ext->regs_dirty + bank->offs) < 0) {
+            err = errno;
+            i = bank->offs;
+            while (!ext->regs_dirty[i]) i++;
+            break;
         }
+        memset(ext->regs_dirty + bank->offs, 0, bank->size);
+    }
+
+#if !defined(MDEP_UseREGSET)
+    for (i = 0; !err && i < sizeof(REG_SET); i++) {
+        if (!ext->regs_dirty[i]) continue;
         if (i >= offsetof(REG_SET, user) && i < offsetof(REG_SET, user) + sizeof(ext->regs->user)) {
             size_t j = i - (i - offsetof(REG_SET, user)) % sizeof(ContextAddress);
             assert(*(ContextAddress *)(ext->regs_valid + j) == ~(ContextAddress)0);
@@ -426,8 +830,8 @@ static int flush_regs(Context * ctx) {
             }
             *(ContextAddress *)(ext->regs_dirty + j) = 0;
         }
-#endif
     }
+#endif
 
     if (!err) return 0;
 
@@ -455,6 +859,7 @@ static void free_regs(Context * ctx) {
     ext->regs = NULL;
     ext->regs_valid = NULL;
     ext->regs_dirty = NULL;
+    ext->regs_banks_valid = 0;
 }
 
 static void send_process_exited_event(Context * prs) {
@@ -479,6 +884,9 @@ static const char * get_ptrace_cmd_name(int cmd) {
     case PTRACE_DETACH: return "PTRACE_DETACH";
     case PTRACE_SYSCALL: return "PTRACE_SYSCALL";
     case PTRACE_SINGLESTEP: return "PTRACE_SINGLESTEP";
+#if USE_PTRACE_SEIZE
+    case PTRACE_LISTEN: return "PTRACE_LISTEN";
+#endif
     }
     return "?";
 }
@@ -577,7 +985,7 @@ int context_continue(Context * ctx) {
 
     trace(LOG_CONTEXT, "context: resuming ctx %#lx, id %s, with signal %d", ctx, ctx->id, signal);
 #if defined(__i386__) || defined(__x86_64__)
-    if (ext->regs->user.regs.eflags & 0x100) {
+    if (ext->regs_valid[offsetof(REG_SET, user.regs.eflags)] && (ext->regs->user.regs.eflags & 0x100)) {
         ext->regs->user.regs.eflags &= ~0x100;
         memset(ext->regs_dirty + offsetof(REG_SET, user.regs.eflags), 0xff, 4);
     }
@@ -585,6 +993,13 @@ int context_continue(Context * ctx) {
     if (flush_regs(ctx) < 0) return -1;
     if (ext->detach_req && !ext->sigstop_posted &&
             sigset_is_empty(&ctx->pending_signals)) cmd = PTRACE_DETACH;
+#if USE_PTRACE_SEIZE
+    else if (ext->group_stop) {
+        /* Keep the thread stopped by job control, signals are delivered after SIGCONT */
+        cmd = PTRACE_LISTEN;
+        signal = 0;
+    }
+#endif
     if (ptrace(cmd, ext->pid, 0, signal) < 0) {
         int err = errno;
         trace(LOG_ALWAYS, "error: ptrace(%s, ...) failed: ctx %#lx, id %s, error %d %s",
@@ -623,7 +1038,7 @@ int context_continue(Context * ctx) {
         add_waitpid_process(ext->pid);
         if (ext->detach_req && !ext->sigstop_posted) {
             assert(ctx->exiting);
-            if (tkill(ext->pid, SIGSTOP) >= 0) ext->sigstop_posted = 1;
+            if (post_stop_request(ctx) >= 0) ext->sigstop_posted = 1;
         }
 #if ENABLE_ProfilerSST
         else if (!ctx->exiting) {
@@ -702,6 +1117,9 @@ int context_write_mem(Context * ctx, ContextAddress address, void * buf, size_t
         return -1;
     }
     if (check_breakpoints_on_memory_write(ctx, address, buf, size) < 0) return -1;
+#if ENABLE_MemoryPageCache
+    if (ctx->mem != NULL) invalidate_mem_cache(ctx->mem, address, size);
+#endif
     for (word_addr = address & ~((ContextAddress)word_size - 1); word_addr < address + size; word_addr += word_size) {
         unsigned long word = 0;
         if (word_addr < address || word_addr + word_size > address + size) {
@@ -795,6 +1213,13 @@ int context_read_mem(Context * ctx, ContextAddress address, void * buf, size_t s
         errno = EFAULT;
         return -1;
     }
+#if ENABLE_MemoryPageCache
+    if (read_mem_cache(ctx, address, buf, size) == 0) {
+        /* Cached pages contain planted breakpoint instructions, mask them as usual */
+        if (check_breakpoints_on_memory_read(ctx, address, buf, size) < 0) return -1;
+        return 0;
+    }
+#endif
     for (word_addr = address & ~((ContextAddress)word_size - 1); word_addr < address + size; word_addr += word_size) {
         unsigned long word = 0;
         errno = 0;
@@ -868,8 +1293,6 @@ int context_get_mem_error_info(MemoryErrorInfo * info) {
 #endif
 
 int context_write_reg(Context * ctx, RegisterDefinition * def, unsigned offs, unsigned size, void * buf) {
-    int valid = 1;
-    size_t i = 0;
     ContextExtensionLinux * ext = EXT(ctx);
 
     assert(is_dispatch_thread());
@@ -878,10 +1301,8 @@ int context_write_reg(Context * ctx, RegisterDefinition * def, unsigned offs, un
     assert(!ctx->exited);
     assert(offs + size <= def->size);
 
-    for (i = def->offset + offs; i < def->offset + offs + size; i++) {
-        if (ext->regs_valid[i] == 0) valid = 0;
-    }
-    if (!valid && context_read_reg(ctx, def, offs, size, NULL) < 0) return -1;
+    /* Make sure whole register bank is cached, it is written back as a whole */
+    if (context_read_reg(ctx, def, offs, size, NULL) < 0) return -1;
     if (memcmp((uint8_t *)ext->regs + def->offset + offs, buf, size) == 0) return 0;
     memcpy((uint8_t *)ext->regs + def->offset + offs, buf, size);
     memset(ext->regs_dirty + def->offset + offs, 0xff, size);
@@ -890,6 +1311,8 @@ int context_write_reg(Context * ctx, RegisterDefinition * def, unsigned offs, un
 
 int context_read_reg(Context * ctx, RegisterDefinition * def, unsigned offs, unsigned size, void * buf) {
     ContextExtensionLinux * ext = EXT(ctx);
+    size_t pos = def->offset + offs;
+    RegisterBank * bank = find_reg_bank(pos);
     size_t i = 0;
     int err = 0;
 
@@ -899,68 +1322,26 @@ int context_read_reg(Context * ctx, RegisterDefinition * def, unsigned offs, uns
     assert(!ctx->exited);
     assert(offs + size <= def->size);
 
-    for (i = def->offset + offs; i < def->offset + offs + size; i++) {
+    if (bank != NULL && pos + size <= bank->offs + bank->size &&
+            (ext->regs_banks_valid & (1u << (bank - reg_banks)))) {
+        /* Fast path: the register is in a bank that is already cached */
+        if (buf != NULL) memcpy(buf, (uint8_t *)ext->regs + pos, size);
+        return 0;
+    }
+
+    for (i = pos; i < pos + size; i++) {
         if (ext->regs_valid[i]) continue;
-#ifdef MDEP_OtherRegisters
-        if (i >= offsetof(REG_SET, other) && i < offsetof(REG_SET, other) + sizeof(ext->regs->other)) {
-            size_t offs = 0;
-            size_t size = 0;
-            size_t j = i + 1;
-            while (j < def->offset + offs + size && !ext->regs_valid[j]) j++;
-            if (mdep_get_other_regs(ext->pid, ext->regs, i, j - i, &offs, &size) < 0) {
-                err = errno;
-                break;
-            }
-            assert(i >= offs);
-            assert(j <= offs + size);
-            memset(ext->regs_valid + offs, 0xff, size);
-            continue;
-        }
-#endif
-#ifdef MDEP_UseREGSET
-        if (i >= offsetof(REG_SET, gp) && i < offsetof(REG_SET, gp) + sizeof(ext->regs->gp)) {
-            struct iovec buf;
-            buf.iov_base = &ext->regs->gp;
-            buf.iov_len = sizeof(ext->regs->gp);
-            if (ptrace(PTRACE_GETREGSET, ext->pid, REGSET_GP, &buf) < 0 && errno != ESRCH) {
+        bank = find_reg_bank(i);
+        if (bank != NULL) {
+            if (bank->read(ext->pid, ext->regs) < 0 && errno != ESRCH) {
                 err = errno;
                 break;
             }
-            memset(ext->regs_valid + offsetof(REG_SET, gp), 0xff, sizeof(ext->regs->gp));
-            continue;
-        }
-        if (i >= offsetof(REG_SET, fp) && i < offsetof(REG_SET, fp) + sizeof(ext->regs->fp)) {
-            struct iovec buf;
-            buf.iov_base = &ext->regs->fp;
-            buf.iov_len = sizeof(ext->regs->fp);
-            if (ptrace(PTRACE_GETREGSET, ext->pid, REGSET_FP, &buf) < 0 && errno != ESRCH) {
-                err = errno;
-                break;
-            }
-            memset(ext->regs_valid + offsetof(REG_SET, fp), 0xff, sizeof(ext->regs->fp));
-            continue;
-        }
-#else
-        if (i >= offsetof(REG_SET, user.regs) && i < offsetof(REG_SET, user.regs) + sizeof(ext->regs->user.regs)) {
-            if (ptrace(PTRACE_GETREGS, ext->pid, 0, &ext->regs->user.regs) < 0 && errno != ESRCH) {
-                err = errno;
-                break;
-            }
-            memset(ext->regs_valid + offsetof(REG_SET, user.regs), 0xff, sizeof(ext->regs->user.regs));
-            continue;
-        }
-        if (i >= offsetof(REG_SET, fp) && i < offsetof(REG_SET, fp) + sizeof(ext->regs->fp)) {
-#if defined(__arm__) || defined(__aarch64__)
-            if (ptrace(PTRACE_GETVFPREGS, ext->pid, 0, &ext->regs->fp) < 0 && errno != ESRCH) {
-#else
-            if (ptrace(PTRACE_GETFPREGS, ext->pid, 0, &ext->regs->fp) < 0 && errno != ESRCH) {
-#endif
-                err = errno;
-                break;
-            }
-            memset(ext->regs_valid + offsetof(REG_SET, fp), 0xff, sizeof(ext->regs->fp));
+            memset(ext->regs_valid + bank->offs, 0xff, bank->size);
+            ext->regs_banks_valid |= 1u << (bank - reg_banks);
             continue;
         }
+#if !defined(MDEP_UseREGSET)
         if (i >= offsetof(REG_SET, user) && i < offsetof(REG_SET, user) + sizeof(ext->regs->user)) {
             size_t j = i - (i - offsetof(REG_SET, user)) % sizeof(ContextAddress);
             *(ContextAddress *)((uint8_t *)ext->regs + j) = (ContextAddress)ptrace(PTRACE_PEEKUSER,
@@ -977,7 +1358,7 @@ int context_read_reg(Context * ctx, RegisterDefinition * def, unsigned offs, uns
         return -1;
     }
 
-    if (buf != NULL) memcpy(buf, (uint8_t *)ext->regs + def->offset + offs, size);
+    if (buf != NULL) memcpy(buf, (uint8_t *)ext->regs + pos, size);
     return 0;
 }
 
@@ -1314,7 +1695,8 @@ static Context * add_thread(Context * parent, Context * creator, pid_t pid) {
         ctx->exiting = 1;
         EXT(ctx)->detach_req = 1;
     }
-    else if ((creator == NULL || parent != creator->parent) && (EXT(parent)->attach_mode & CONTEXT_ATTACH_NO_STOP) == 0) {
+    else if ((creator == NULL || parent != creator->parent) &&
+            (EXT(parent)->attach_mode & (CONTEXT_ATTACH_NO_STOP | CONTEXT_ATTACH_NON_STOP)) == 0) {
         ctx->pending_intercept = 1;
     }
     list_add_last(&ctx->cldl, &parent->children);
@@ -1398,6 +1780,49 @@ static void event_pid_stopped(pid_t pid, int signal, int event, int syscall) {
     ext = EXT(ctx);
     assert(!ctx->exited);
     assert(!ext->attach_callback);
+#if USE_PTRACE_SEIZE
+    ext->group_stop = 0;
+    if (event == PTRACE_EVENT_STOP) {
+        /* Seized thread stopped by PTRACE_INTERRUPT, after clone or by a group-stop.
+         * Group-stop reports the stop signal in siginfo, other stops report SIGTRAP. */
+        siginfo_t info;
+        memset(&info, 0, sizeof(info));
+        if (ptrace(PTRACE_GETSIGINFO, pid, 0, &info) == 0) signal = info.si_signo;
+        switch (signal) {
+        case SIGSTOP:
+        case SIGTSTP:
+        case SIGTTIN:
+        case SIGTTOU:
+            ext->group_stop = 1;
+            break;
+        }
+        if (!ext->sigstop_posted) {
+            /* Not requested by the agent: job control stop, or resumption by SIGCONT after PTRACE_LISTEN */
+            int cmd = ext->group_stop ? PTRACE_LISTEN : PTRACE_CONT;
+            trace(LOG_EVENTS, "event: pid %d %s", pid, ext->group_stop ? "group-stop" : "continued");
+            if (ptrace((enum __ptrace_request)cmd, pid, 0, 0) < 0) {
+                trace(LOG_ALWAYS, "error: ptrace(%s, ...) failed: pid %d, error %d %s",
+                    get_ptrace_cmd_name(cmd), pid, errno, errno_to_str(errno));
+            }
+            add_waitpid_process(pid);
+            return;
+        }
+        /* Handle the stop same way as a stop by SIGSTOP, the signal is not delivered again */
+        signal = SIGSTOP;
+        event = 0;
+    }
+    else if (signal == SIGSTOP && event == 0 && !ext->sigstop_posted &&
+            (ext->attach_mode & (CONTEXT_ATTACH_NON_STOP | CONTEXT_ATTACH_SELF)) == CONTEXT_ATTACH_NON_STOP) {
+        /* The agent stops seized threads with PTRACE_INTERRUPT, SIGSTOP is sent by the user:
+         * deliver it, the thread enters group-stop */
+        if (ptrace(PTRACE_CONT, pid, 0, SIGSTOP) < 0) {
+            trace(LOG_ALWAYS, "error: ptrace(PTRACE_CONT, ...) failed: pid %d, error %d %s",
+                pid, errno, errno_to_str(errno));
+        }
+        add_waitpid_process(pid);
+        return;
+    }
+#endif
     if (signal == SIGSTOP) ext->sigstop_posted = 0;
     ext->stop_cnt = 0;
 
@@ -1545,7 +1970,7 @@ static void event_pid_stopped(pid_t pid, int signal, int event, int syscall) {
         causes kernel critical messages */
     if (event != PTRACE_EVENT_EXIT)
 #endif
-    memset(ext->regs_valid, 0, sizeof(REG_SET));
+    invalidate_regs(ctx);
     pc1 = get_regs_PC(ctx);
 
     if (syscall) {
@@ -1745,6 +2170,9 @@ void init_contexts_sys_dep(void) {
     add_context_query_comparator("tid", cmp_linux_tid);
     add_context_query_comparator("KernelName", cmp_linux_kernel_name);
     create_eventpoint("main", NULL, eventpoint_at_main, NULL);
+#if ENABLE_MemoryPageCache
+    add_context_event_listener(&mem_cache_listener, NULL);
+#endif
 }
 
 #endif  /* if ENABLE_DebugContext */
@@ -261,6 +261,26 @@
 #  endif
 #endif
 
+#if !defined(ENABLE_IOUring)
+#  if defined(__linux__) && defined(__GNUC__) && defined(__has_include)
+#    if __has_include(<linux/io_uring.h>)
+#      define ENABLE_IOUring      1
+#    else
+#      define ENABLE_IOUring      0
+#    endif
+#  else
+#    define ENABLE_IOUring      0
+#  endif
+#endif
+
+#if !defined(ENABLE_SysMonSampler)
+#  if SERVICE_SysMonitor && defined(__linux__)
+#    define ENABLE_SysMonSampler 1
+#  else
+#    define ENABLE_SysMonSampler 0
+#  endif
+#endif
+
 #if !defined(ENABLE_STREAM_MACROS)
 /* Enabling stream macros increases code size about 5%, and increases speed about 7% */
 #  define ENABLE_STREAM_MACROS  0
@@ -303,6 +323,10 @@
 #  define ENABLE_ExtendedMemoryErrorReports 1
 #endif
 
+#if !defined(ENABLE_MemoryPageCache)
+#  define ENABLE_MemoryPageCache (TARGET_UNIX && ENABLE_DebugContext && !ENABLE_ContextProxy)
+#endif
+
 #if !defined(ENABLE_MemoryAccessModes)
 #  define ENABLE_MemoryAccessModes 0
 #endif
@@ -30,6 +30,12 @@
 #else
 #  include <sys/wait.h>
 #endif
+#if ENABLE_IOUring
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <sys/sysmacros.h>
+#  include <linux/io_uring.h>
+#endif
 #include <tcf/framework/mdep-threads.h>
 #include <tcf/framework/mdep-inet.h>
 #include <tcf/framework/mdep-fs.h>
@@ -567,12 +573,366 @@ static void aio_done(union sigval arg) {
 }
 #endif
 
+#if ENABLE_IOUring
+
+/*
+ * File I/O requests are executed by io_uring when the kernel supports it.
+ * Requests posted during a dispatch cycle are submitted with a single io_uring_enter() call,
+ * completions are collected by a dedicated thread and reported with post_event(), same as worker threads do.
+ */
+
+#define URING_ENTRIES 256
+
+typedef struct UringRequest {
+    LINK link;
+    AsyncReqInfo * req;
+    struct statx stx;
+} UringRequest;
+
+#define link2uring(A)  ((UringRequest *)((char *)(A) - offsetof(UringRequest, link)))
+
+static int uring_fd = -1;
+static int uring_state = 0;     /* 0 - not initialized, 1 - active, -1 - not supported */
+static int uring_cur_pos = 0;   /* Kernel supports read/write at the current file position */
+static unsigned char uring_ops[IORING_OP_LAST];
+static unsigned * uring_sq_head;
+static unsigned * uring_sq_tail;
+static unsigned * uring_sq_mask;
+static unsigned * uring_sq_array;
+static unsigned * uring_cq_head;
+static unsigned * uring_cq_tail;
+static unsigned * uring_cq_mask;
+static struct io_uring_sqe * uring_sqes;
+static struct io_uring_cqe * uring_cqes;
+static unsigned uring_sq_entries;
+static unsigned uring_to_submit = 0;
+static unsigned uring_inflight = 0;
+static pthread_t uring_thread;
+static pthread_mutex_t uring_lock;
+static LINK uring_reqs = TCF_LIST_INIT(uring_reqs);    /* Requests owned by io_uring */
+static int uring_error = 0;                             /* Fatal error of the completion thread */
+static char * uring_sq_ptr = NULL;
+static char * uring_cq_ptr = NULL;
+static size_t uring_sq_size = 0;
+static size_t uring_cq_size = 0;
+static size_t uring_sqes_size = 0;
+
+static int uring_enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, uring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static void uring_stat(UringRequest * ur) {
+    struct statx * x = &ur->stx;
+    struct stat * st = &ur->req->u.fio.statbuf;
+    memset(st, 0, sizeof(struct stat));
+    st->st_dev = makedev(x->stx_dev_major, x->stx_dev_minor);
+    st->st_ino = x->stx_ino;
+    st->st_mode = x->stx_mode;
+    st->st_nlink = x->stx_nlink;
+    st->st_uid = x->stx_uid;
+    st->st_gid = x->stx_gid;
+    st->st_rdev = makedev(x->stx_rdev_major, x->stx_rdev_minor);
+    st->st_size = x->stx_size;
+    st->st_blksize = x->stx_blksize;
+    st->st_blocks = x->stx_blocks;
+    st->st_atim.tv_sec = x->stx_atime.tv_sec;
+    st->st_atim.tv_nsec = x->stx_atime.tv_nsec;
+    st->st_mtim.tv_sec = x->stx_mtime.tv_sec;
+    st->st_mtim.tv_nsec = x->stx_mtime.tv_nsec;
+    st->st_ctim.tv_sec = x->stx_ctime.tv_sec;
+    st->st_ctim.tv_nsec = x->stx_ctime.tv_nsec;
+}
+
+static void uring_fail(int error, int lost) {
+    /* Dispatch thread: io_uring cannot be used anymore, switch back to worker threads.
+     * Requests not yet consumed by the kernel are re-posted, other requests are failed if 'lost' */
+    unsigned head = __atomic_load_n(uring_sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *uring_sq_tail;
+    LINK * l;
+
+    assert(is_dispatch_thread());
+    trace(LOG_ALWAYS, "io_uring_enter error: %s", errno_to_str(error));
+    uring_state = -1;
+    uring_to_submit = 0;
+    check_error(pthread_mutex_lock(&uring_lock));
+    while (head != tail) {
+        UringRequest * ur = (UringRequest *)(uintptr_t)uring_sqes[head & *uring_sq_mask].user_data;
+        list_remove(&ur->link);
+        async_req_post(ur->req);
+        loc_free(ur);
+        head++;
+    }
+    __atomic_store_n(uring_sq_tail, head, __ATOMIC_RELEASE);
+    for (l = uring_reqs.next; lost && l != &uring_reqs;) {
+        UringRequest * ur = link2uring(l);
+        AsyncReqInfo * req = ur->req;
+        l = l->next;
+        list_remove(&ur->link);
+        req->error = error;
+        req->u.fio.rval = -1;
+        if (req->type == AsyncReqStat || req->type == AsyncReqLstat || req->type == AsyncReqFstat) {
+            memset(&req->u.fio.statbuf, 0, sizeof(req->u.fio.statbuf));
+        }
+        post_event(req->done, req);
+        loc_free(ur);
+    }
+    check_error(pthread_mutex_unlock(&uring_lock));
+}
+
+static void uring_fail_event(void * args) {
+    uring_fail(uring_error, 1);
+}
+
+static void * uring_completion_handler(void * x) {
+    for (;;) {
+        unsigned head = *uring_cq_head;
+        unsigned tail = __atomic_load_n(uring_cq_tail, __ATOMIC_ACQUIRE);
+        unsigned cnt = tail - head;
+        if (cnt == 0) {
+            if (uring_enter(0, 1, IORING_ENTER_GETEVENTS) < 0) {
+                /* Transient errors: wait and try again */
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EBUSY) {
+                    usleep(1000);
+                    continue;
+                }
+                /* The ring is broken, completions of the outstanding requests are lost */
+                uring_error = errno;
+                post_event(uring_fail_event, NULL);
+                break;
+            }
+            continue;
+        }
+        check_error(pthread_mutex_lock(&uring_lock));
+        while (head != tail) {
+            struct io_uring_cqe * cqe = uring_cqes + (head & *uring_cq_mask);
+            UringRequest * ur = (UringRequest *)(uintptr_t)cqe->user_data;
+            AsyncReqInfo * req = ur->req;
+            int res = cqe->res;
+            req->error = res < 0 ? -res : 0;
+            if (req->type == AsyncReqStat || req->type == AsyncReqLstat || req->type == AsyncReqFstat) {
+                if (res == 0) uring_stat(ur);
+                else memset(&req->u.fio.statbuf, 0, sizeof(req->u.fio.statbuf));
+            }
+            req->u.fio.rval = res < 0 ? -1 : res;
+            trace(LOG_ASYNCREQ, "async_req_complete: req %p, type %d, error %d", req, req->type, req->error);
+            list_remove(&ur->link);
+            post_event(req->done, req);
+            loc_free(ur);
+            head++;
+        }
+        check_error(pthread_mutex_unlock(&uring_lock));
+        __atomic_store_n(uring_cq_head, head, __ATOMIC_RELEASE);
+        __atomic_sub_fetch(&uring_inflight, cnt, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static void uring_dispose(void) {
+    /* Release resources of partially initialized io_uring */
+    if (uring_sqes != NULL) munmap(uring_sqes, uring_sqes_size);
+    if (uring_cq_ptr != NULL && uring_cq_ptr != uring_sq_ptr) munmap(uring_cq_ptr, uring_cq_size);
+    if (uring_sq_ptr != NULL) munmap(uring_sq_ptr, uring_sq_size);
+    if (uring_fd >= 0) close(uring_fd);
+    uring_sqes = NULL;
+    uring_cq_ptr = NULL;
+    uring_sq_ptr = NULL;
+    uring_fd = -1;
+}
+
+static int uring_map(struct io_uring_params * p) {
+    struct io_uring_probe * probe = NULL;
+    char * ptr = NULL;
+    unsigned i;
+
+    probe = (struct io_uring_probe *)loc_alloc_zero(sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op));
+    if (syscall(__NR_io_uring_register, uring_fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+        loc_free(probe);
+        return -1;
+    }
+    for (i = 0; i < probe->ops_len && i < IORING_OP_LAST; i++) {
+        uring_ops[i] = (probe->ops[i].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+    loc_free(probe);
+
+    uring_sq_size = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    uring_cq_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        if (uring_cq_size > uring_sq_size) uring_sq_size = uring_cq_size;
+        uring_cq_size = uring_sq_size;
+    }
+    ptr = (char *)mmap(NULL, uring_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring_fd, IORING_OFF_SQ_RING);
+    if (ptr == MAP_FAILED) return -1;
+    uring_sq_ptr = ptr;
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        uring_cq_ptr = uring_sq_ptr;
+    }
+    else {
+        ptr = (char *)mmap(NULL, uring_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring_fd, IORING_OFF_CQ_RING);
+        if (ptr == MAP_FAILED) return -1;
+        uring_cq_ptr = ptr;
+    }
+    uring_sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+    ptr = (char *)mmap(NULL, uring_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring_fd, IORING_OFF_SQES);
+    if (ptr == MAP_FAILED) return -1;
+    uring_sqes = (struct io_uring_sqe *)ptr;
+    return 0;
+}
+
+static int uring_init(void) {
+    struct io_uring_params p;
+
+    memset(&p, 0, sizeof(p));
+    uring_fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    if (uring_fd < 0) return -1;
+    uring_cur_pos = (p.features & IORING_FEAT_RW_CUR_POS) != 0;
+    if (uring_map(&p) < 0) {
+        int error = errno;
+        uring_dispose();
+        errno = error;
+        return -1;
+    }
+
+    uring_sq_head = (unsigned *)(uring_sq_ptr + p.sq_off.head);
+    uring_sq_tail = (unsigned *)(uring_sq_ptr + p.sq_off.tail);
+    uring_sq_mask = (unsigned *)(uring_sq_ptr + p.sq_off.ring_mask);
+    uring_sq_array = (unsigned *)(uring_sq_ptr + p.sq_off.array);
+    uring_cq_head = (unsigned *)(uring_cq_ptr + p.cq_off.head);
+    uring_cq_tail = (unsigned *)(uring_cq_ptr + p.cq_off.tail);
+    uring_cq_mask = (unsigned *)(uring_cq_ptr + p.cq_off.ring_mask);
+    uring_cqes = (struct io_uring_cqe *)(uring_cq_ptr + p.cq_off.cqes);
+    uring_sq_entries = p.sq_entries;
+
+    check_error(pthread_mutex_init(&uring_lock, NULL));
+    check_error(pthread_create(&uring_thread, &pthread_create_attr, uring_completion_handler, NULL));
+    return 0;
+}
+
+static void uring_submit_event(void * args) {
+    int n = 0;
+    if (uring_state < 0) return;
+    assert(uring_to_submit > 0);
+    n = uring_enter(uring_to_submit, 0, 0);
+    if (n < 0) {
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            uring_fail(errno, 0);
+            return;
+        }
+        n = 0;
+    }
+    uring_to_submit -= n;
+    if (uring_to_submit > 0) post_event(uring_submit_event, NULL);
+}
+
+static int uring_post(AsyncReqInfo * req) {
+    /* Returns 0 if the request is submitted to io_uring, -1 if it should be executed by a worker thread */
+    struct io_uring_sqe * sqe = NULL;
+    UringRequest * ur = NULL;
+    unsigned tail = 0;
+    int op = -1;
+
+    switch (req->type) {
+    case AsyncReqRead:
+    case AsyncReqSeekRead:
+        if (req->type == AsyncReqRead && !uring_cur_pos) return -1;
+        op = IORING_OP_READ;
+        break;
+    case AsyncReqWrite:
+    case AsyncReqSeekWrite:
+        if (req->type == AsyncReqWrite && !uring_cur_pos) return -1;
+        op = IORING_OP_WRITE;
+        break;
+    case AsyncReqOpen:
+        op = IORING_OP_OPENAT;
+        break;
+    case AsyncReqClose:
+        op = IORING_OP_CLOSE;
+        break;
+    case AsyncReqStat:
+    case AsyncReqLstat:
+    case AsyncReqFstat:
+        op = IORING_OP_STATX;
+        break;
+    default:
+        return -1;
+    }
+    if (!is_dispatch_thread()) return -1;
+    if (uring_state == 0) {
+        uring_state = uring_init() < 0 ? -1 : 1;
+        trace(LOG_ASYNCREQ, "io_uring %s", uring_state > 0 ? "enabled" : "not supported");
+    }
+    if (uring_state < 0 || !uring_ops[op]) return -1;
+    /* Limit number of requests in flight, so completion queue never overflows */
+    if (__atomic_load_n(&uring_inflight, __ATOMIC_RELAXED) >= uring_sq_entries) return -1;
+
+    ur = (UringRequest *)loc_alloc(sizeof(UringRequest));
+    ur->req = req;
+    check_error(pthread_mutex_lock(&uring_lock));
+    list_add_last(&ur->link, &uring_reqs);
+    check_error(pthread_mutex_unlock(&uring_lock));
+    tail = *uring_sq_tail;
+    sqe = uring_sqes + (tail & *uring_sq_mask);
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = (uint8_t)op;
+    sqe->user_data = (uintptr_t)ur;
+    switch (req->type) {
+    case AsyncReqRead:
+    case AsyncReqWrite:
+    case AsyncReqSeekRead:
+    case AsyncReqSeekWrite:
+        sqe->fd = req->u.fio.fd;
+        sqe->addr = (uintptr_t)req->u.fio.bufp;
+        sqe->len = (uint32_t)req->u.fio.bufsz;
+        sqe->off = req->type == AsyncReqSeekRead || req->type == AsyncReqSeekWrite ?
+            (uint64_t)req->u.fio.offset : (uint64_t)-1;
+        break;
+    case AsyncReqOpen:
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (uintptr_t)req->u.fio.file_name;
+        sqe->len = (uint32_t)req->u.fio.permission;
+        sqe->open_flags = (uint32_t)req->u.fio.flags;
+        break;
+    case AsyncReqClose:
+        sqe->fd = req->u.fio.fd;
+        break;
+    case AsyncReqStat:
+    case AsyncReqLstat:
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (uintptr_t)req->u.fio.file_name;
+        sqe->len = STATX_BASIC_STATS;
+        sqe->off = (uintptr_t)&ur->stx;
+        sqe->statx_flags = req->type == AsyncReqLstat ? AT_SYMLINK_NOFOLLOW : 0;
+        break;
+    case AsyncReqFstat:
+        sqe->fd = req->u.fio.fd;
+        sqe->addr = (uintptr_t)"";
+        sqe->len = STATX_BASIC_STATS;
+        sqe->off = (uintptr_t)&ur->stx;
+        sqe->statx_flags = AT_EMPTY_PATH;
+        break;
+    }
+    uring_sq_array[tail & *uring_sq_mask] = tail & *uring_sq_mask;
+    __atomic_store_n(uring_sq_tail, tail + 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&uring_inflight, 1, __ATOMIC_RELAXED);
+    if (uring_to_submit++ == 0) post_event(uring_submit_event, NULL);
+    return 0;
+}
+
+#endif /* ENABLE_IOUring */
+
 void async_req_post(AsyncReqInfo * req) {
     WorkerThread * wt;
 
     trace(LOG_ASYNCREQ, "async_req_post: req %p, type %d", req, req->type);
     assert(req->done != NULL || req->type == AsyncReqTimer);
 
+#if ENABLE_IOUring
+    if (uring_state >= 0) {
+        req->error = 0;
+        if (uring_post(req) == 0) return;
+    }
+#endif
+
 #if ENABLE_AIO
     {
         int res = 0;
@@ -34,6 +34,9 @@
 #if ENABLE_Unix_Domain
 #include <sys/un.h>
 #endif
+#if ENABLE_Splice
+#include <linux/sockios.h>
+#endif
 #if ENABLE_SSL
 #  include <openssl/ssl.h>
 #  include <openssl/rand.h>
@@ -503,14 +506,72 @@ static void tcp_write_block_stream(OutputStream * out, const char * bytes, size_
     }
 }
 
+#if ENABLE_Splice
+static int tcp_splice_ready(ChannelTCP * c, size_t size) {
+    /* Check that the socket can take 'size' bytes and the pending output without blocking */
+    int sndbuf = 0;
+    int outq = 0;
+    socklen_t optlen = sizeof(sndbuf);
+    if (c->ssl || c->chan.state == ChannelStateDisconnected || c->out_errno) return 0;
+#if ENABLE_OutputQueue
+    if (!output_queue_is_empty(&c->out_queue)) return 0;
+#endif
+    if (getsockopt(c->socket, SOL_SOCKET, SO_SNDBUF, (char *)&sndbuf, &optlen) < 0) return 0;
+    if (ioctl(c->socket, SIOCOUTQ, &outq) < 0 || outq < 0) return 0;
+    /* SO_SNDBUF includes kernel bookkeeping overhead, use only half of it */
+    size += c->chan.out.cur - c->obuf->buf;
+    return (size_t)outq + size <= (size_t)sndbuf / 2;
+}
+
+static int tcp_send_nonblocking(ChannelTCP * c) {
+    /* Send the output buffer without blocking, returns 0 if all data is sent */
+    unsigned char * p = c->obuf->buf;
+    while (p < c->chan.out.cur) {
+        ssize_t wr = send(c->socket, p, c->chan.out.cur - p, MSG_DONTWAIT | MSG_MORE);
+        if (wr <= 0) break;
+        p += wr;
+    }
+    if (p > c->obuf->buf) {
+        size_t n = c->chan.out.cur - p;
+        memmove(c->obuf->buf, p, n);
+        c->chan.out.cur = c->obuf->buf + n;
+        if (n == 0) c->out_eom_cnt = 0;
+    }
+    return c->chan.out.cur == c->obuf->buf ? 0 : -1;
+}
+
+static void tcp_copy_from_pipe(ChannelTCP * c, size_t size) {
+    /* The socket is busy: pass the data that is already in the pipe through the output buffer */
+    while (size > 0) {
+        ssize_t rd;
+        size_t n = c->chan.out.end - c->chan.out.cur;
+        if (n == 0) {
+            tcp_flush_with_flags(c, MSG_MORE);
+            continue;
+        }
+        if (n > size) n = size;
+        rd = read(c->pipefd[0], c->chan.out.cur, n);
+        if (rd <= 0) {
+            c->out_errno = rd < 0 ? errno : ERR_EOF;
+            trace(LOG_PROTOCOL, "Error reading splice pipe: %s", errno_to_str(c->out_errno));
+            break;
+        }
+        c->chan.out.cur += rd;
+        size -= rd;
+    }
+}
+#endif /* ENABLE_Splice */
+
 static ssize_t tcp_splice_block_stream(OutputStream * out, int fd, size_t size, int64_t * offset) {
     assert(is_dispatch_thread());
     if (size == 0) return 0;
 #if ENABLE_Splice
     {
         ChannelTCP * c = channel2tcp(out2channel(out));
-        if (!c->ssl && out->supports_zero_copy) {
-            ssize_t rd = splice(fd, offset, c->pipefd[1], NULL, size, SPLICE_F_MOVE);
+        /* Splice only if it does not block the dispatch thread, one buffer at a time */
+        if (size > BUF_SIZE) size = BUF_SIZE;
+        if (out->supports_zero_copy && tcp_splice_ready(c, size + 16)) {
+            ssize_t rd = splice(fd, offset, c->pipefd[1], NULL, size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
             if (rd > 0) {
                 /* Send the binary data escape seq */
                 size_t n = rd;
@@ -526,23 +587,25 @@ static ssize_t tcp_splice_block_stream(OutputStream * out, int fd, size_t size,
                     *c->chan.out.cur++ = (n & 0x7fu) | 0x80u;
                     n = n >> 7;
                 }
-                /* We need to flush the buffer then send our data */
-                tcp_flush_with_flags(c, MSG_MORE);
-
 #if ENABLE_OutputQueue
-                while (!output_queue_is_empty(&c->out_queue)) {
-                    cancel_event(done_write_request, &c->wr_req, 1);
-                    done_write_request(&c->wr_req);
+                /* The output queue is empty, send the buffer directly */
+                if (tcp_send_nonblocking(c) < 0) {
+                    tcp_copy_from_pipe(c, rd);
+                    return rd;
                 }
-#endif
-
-                if (c->chan.state == ChannelStateDisconnected) return rd;
+#else
+                tcp_flush_with_flags(c, MSG_MORE);
                 if (c->out_errno) return rd;
+#endif
 
                 n = rd;
                 while (n > 0) {
-                    ssize_t wr = splice(c->pipefd[0], NULL, c->socket, NULL, n, SPLICE_F_MORE);
+                    ssize_t wr = splice(c->pipefd[0], NULL, c->socket, NULL, n, SPLICE_F_MORE | SPLICE_F_NONBLOCK);
 
+                    if (wr < 0 && errno == EAGAIN) {
+                        tcp_copy_from_pipe(c, n);
+                        break;
+                    }
                     if (wr < 0) {
                         c->out_errno = errno;
                         trace(LOG_PROTOCOL, "Error in socket splice: %s", errno_to_str(errno));
@@ -550,8 +613,10 @@ static ssize_t tcp_splice_block_stream(OutputStream * out, int fd, size_t size,
                     }
                     n -= wr;
                 }
+                return rd;
             }
-            return rd;
+            if (rd == 0 || errno != EAGAIN) return rd;
+            /* The file cannot be spliced without blocking, read it into the buffer */
         }
     }
 #endif /* ENABLE_Splice */
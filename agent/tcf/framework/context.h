@@ -203,6 +203,7 @@ struct MemoryRegionAttribute {
 #define CONTEXT_ATTACH_CHILDREN  0x02 /* Enable auto-attaching of children of the process */
 #define CONTEXT_ATTACH_NO_STOP   0x04 /* Don't stop after attach */
 #define CONTEXT_ATTACH_NO_MAIN   0x08 /* Don't stop at main() */
+#define CONTEXT_ATTACH_NON_STOP  0x10 /* Attach without stopping threads, stop them individually when needed */
 
 /*
  * Convert PID to TCF Context ID.
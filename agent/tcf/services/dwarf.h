@@ -499,6 +499,9 @@
 #define LANG_ADA95                  0x0000000d  /* v3 */
 #define LANG_FORTRAN95              0x0000000e  /* v3 */
 #define LANG_PLI                    0x0000000f
+#define LANG_C_PLUS_PLUS_03         0x00000019  /* v5 */
+#define LANG_C_PLUS_PLUS_11         0x0000001a  /* v5 */
+#define LANG_C_PLUS_PLUS_14         0x00000021  /* v5 */
 #define LANG_lo_user                0x00008000
 #define LANG_hi_user                0x0000ffff
 
@@ -95,6 +95,7 @@ static ObjectInfo * add_object_info(ContextAddress ID) {
     }
     if (sCache->mObjectArrayPos >= OBJECT_ARRAY_SIZE) {
         ObjectArray * Buf = (ObjectArray *)loc_alloc_zero(sizeof(ObjectArray));
+        sCache->mCacheSize += sizeof(ObjectArray);
         Buf->mNext = sCache->mObjectList;
         sCache->mObjectList = Buf;
         sCache->mObjectArrayPos = 0;
@@ -106,10 +107,77 @@ static ObjectInfo * add_object_info(ContextAddress ID) {
     return Info;
 }
 
+static unsigned calc_object_definition_hash(ObjectDefinitionTable * tbl, ObjectInfo * obj) {
+    return (unsigned)(((uintptr_t)obj / sizeof(ObjectInfo)) % tbl->mHashSize);
+}
+
+ObjectInfo * get_object_definition(ObjectInfo * obj) {
+    ObjectDefinitionTable * tbl = NULL;
+    unsigned n = 0;
+    if ((obj->mFlags & DOIF_definition) == 0) return NULL;
+    tbl = &((DWARFCache *)obj->mCompUnit->mFile->dwarf_dt_cache)->mDefinitions;
+    n = tbl->mHash[calc_object_definition_hash(tbl, obj)];
+    while (n != 0) {
+        ObjectDefinition * link = tbl->mLinks + n;
+        if (link->mObject == obj) return link->mDefinition;
+        n = link->mNext;
+    }
+    assert(0);
+    return NULL;
+}
+
+void set_object_definition(ObjectInfo * obj, ObjectInfo * def) {
+    DWARFCache * cache = (DWARFCache *)obj->mCompUnit->mFile->dwarf_dt_cache;
+    ObjectDefinitionTable * tbl = &cache->mDefinitions;
+    ObjectDefinition * link = NULL;
+    unsigned h = 0;
+    if (obj->mFlags & DOIF_definition) {
+        unsigned n = tbl->mHash[calc_object_definition_hash(tbl, obj)];
+        while (n != 0) {
+            link = tbl->mLinks + n;
+            if (link->mObject == obj) {
+                link->mDefinition = def;
+                return;
+            }
+            n = link->mNext;
+        }
+        assert(0);
+    }
+    if (tbl->mCnt == 0) tbl->mCnt = 1; /* Index 0 is reserved for end of chain */
+    if (tbl->mCnt >= tbl->mMax) {
+        cache->mCacheSize -= sizeof(ObjectDefinition) * tbl->mMax;
+        tbl->mMax = tbl->mMax == 0 ? 64 : tbl->mMax * 2;
+        tbl->mLinks = (ObjectDefinition *)loc_realloc(tbl->mLinks, sizeof(ObjectDefinition) * tbl->mMax);
+        cache->mCacheSize += sizeof(ObjectDefinition) * tbl->mMax;
+    }
+    if (tbl->mCnt >= tbl->mHashSize) {
+        unsigned i;
+        loc_free(tbl->mHash);
+        cache->mCacheSize -= sizeof(unsigned) * tbl->mHashSize;
+        tbl->mHashSize = tbl->mMax * 2 + 1;
+        cache->mCacheSize += sizeof(unsigned) * tbl->mHashSize;
+        tbl->mHash = (unsigned *)loc_alloc_zero(sizeof(unsigned) * tbl->mHashSize);
+        for (i = 1; i < tbl->mCnt; i++) {
+            link = tbl->mLinks + i;
+            h = calc_object_definition_hash(tbl, link->mObject);
+            link->mNext = tbl->mHash[h];
+            tbl->mHash[h] = i;
+        }
+    }
+    h = calc_object_definition_hash(tbl, obj);
+    link = tbl->mLinks + tbl->mCnt;
+    link->mObject = obj;
+    link->mDefinition = def;
+    link->mNext = tbl->mHash[h];
+    tbl->mHash[h] = tbl->mCnt++;
+    obj->mFlags |= DOIF_definition;
+}
+
 static CompUnit * add_comp_unit(ContextAddress ID) {
     ObjectInfo * Info = add_object_info(ID);
     if (Info->mCompUnit == NULL) {
         CompUnit * Unit = (CompUnit *)loc_alloc_zero(sizeof(CompUnit));
+        sCache->mCacheSize += sizeof(CompUnit);
         Unit->mFile = sCache->mFile;
         Unit->mFundTypeID = sCache->mFundTypeID;
         Unit->mRegIdScope.big_endian = sCache->mFile->big_endian;
@@ -456,8 +524,8 @@ static void read_subscr_data(U2_T Form, ObjectInfo * Array) {
             case FMT_UT_X_C:
             case FMT_UT_X_X:
                 dio_ReadAttribute(0, FORM_BLOCK2);
-                Range->u.mRange.mLow.mExpr.mAddr = (U1_T *)dio_gFormDataAddr;
-                Range->u.mRange.mLow.mExpr.mSize = dio_gFormDataSize;
+                Range->u.mRange.mLow.mExpr = (U1_T *)dio_gFormDataAddr;
+                Range->u.mRange.mLowSize = (U2_T)dio_gFormDataSize;
                 break;
             }
             switch (Fmt) {
@@ -472,8 +540,8 @@ static void read_subscr_data(U2_T Form, ObjectInfo * Array) {
             case FMT_UT_C_X:
             case FMT_UT_X_X:
                 dio_ReadAttribute(0, FORM_BLOCK2);
-                Range->u.mRange.mHigh.mExpr.mAddr = (U1_T *)dio_gFormDataAddr;
-                Range->u.mRange.mHigh.mExpr.mSize = dio_gFormDataSize;
+                Range->u.mRange.mHigh.mExpr = (U1_T *)dio_gFormDataAddr;
+                Range->u.mRange.mHighSize = (U2_T)dio_gFormDataSize;
                 break;
             }
             *Children = Range;
@@ -947,9 +1015,9 @@ static void read_object_refs(ELF_Section * Section) {
                 else {
                     if (ref.obj->mName == NULL) ref.obj->mName = ref.org->mName;
                     if (ref.obj->mType == NULL || ref.obj->mType->mID == OBJECT_ID_VOID(ref.obj->mCompUnit)) ref.obj->mType = ref.org->mType;
-                    ref.obj->mFlags |= ref.org->mFlags & ~(DOIF_children_loaded | DOIF_declaration | DOIF_specification);
+                    ref.obj->mFlags |= ref.org->mFlags & ~(DOIF_children_loaded | DOIF_declaration | DOIF_specification | DOIF_definition);
                     if (ref.obj->mFlags & DOIF_specification) {
-                        ref.org->mDefinition = ref.obj;
+                        set_object_definition(ref.org, ref.obj);
                         if ((ref.obj->mFlags & (DOIF_low_pc | DOIF_ranges)) == 0) {
                             ref.obj->mFlags |= ref.org->mFlags & DOIF_declaration;
                         }
@@ -958,7 +1026,7 @@ static void read_object_refs(ELF_Section * Section) {
                         if ((ref.obj->mTag == TAG_variable && (ref.obj->mFlags & DOIF_external)) ||
                                 ref.obj->mTag == TAG_subprogram ||
                                 (ref.obj->mTag == TAG_formal_parameter && ref.obj->mParent != NULL && ref.obj->mParent->mTag == TAG_subprogram))
-                            ref.org->mDefinition = ref.obj;
+                            set_object_definition(ref.org, ref.obj);
                     }
                     if (ref.obj->mFlags & DOIF_external) {
                         ObjectInfo * cls = ref.org;
@@ -1000,8 +1068,10 @@ static void add_addr_range(ELF_Section * sec, CompUnit * unit, ContextAddress ad
     }
     if (size > sCache->mAddrRangesMaxSize) sCache->mAddrRangesMaxSize = size;
     if (sCache->mAddrRangesCnt >= sCache->mAddrRangesMax) {
+        sCache->mCacheSize -= sizeof(UnitAddressRange) * sCache->mAddrRangesMax;
         sCache->mAddrRangesMax = sCache->mAddrRangesMax == 0 ? 64 : sCache->mAddrRangesMax * 2;
         sCache->mAddrRanges = (UnitAddressRange *)loc_realloc(sCache->mAddrRanges, sizeof(UnitAddressRange) * sCache->mAddrRangesMax);
+        sCache->mCacheSize += sizeof(UnitAddressRange) * sCache->mAddrRangesMax;
     }
     range = sCache->mAddrRanges + sCache->mAddrRangesCnt++;
     memset(range, 0, sizeof(UnitAddressRange));
@@ -1209,6 +1279,64 @@ static int cmp_pub_objects(ObjectInfo * x, ObjectInfo * y) {
     return 1;
 }
 
+#if ENABLE_DWARF_ODR_TYPES
+static int is_odr_language(ObjectInfo * obj) {
+    switch (obj->mCompUnit->mLanguage) {
+    case LANG_C_PLUS_PLUS:
+    case LANG_C_PLUS_PLUS_03:
+    case LANG_C_PLUS_PLUS_11:
+    case LANG_C_PLUS_PLUS_14:
+        return 1;
+    }
+    return 0;
+}
+
+static int is_odr_type(ObjectInfo * obj) {
+    switch (obj->mTag) {
+    case TAG_class_type:
+    case TAG_structure_type:
+    case TAG_union_type:
+    case TAG_interface_type:
+    case TAG_enumeration_type:
+        break;
+    default:
+        return 0;
+    }
+    if (obj->mFlags & (DOIF_declaration | DOIF_definition)) return 0;
+    return is_odr_language(obj);
+}
+
+static int same_odr_scope(ObjectInfo * x, ObjectInfo * y) {
+    /* Types in anonymous namespaces are local to a compilation unit */
+    for (;;) {
+        x = x->mParent;
+        y = y->mParent;
+        if (x == NULL || y == NULL) return 0;
+        if (x->mTag == TAG_compile_unit || x->mTag == TAG_partial_unit) {
+            return y->mTag == TAG_compile_unit || y->mTag == TAG_partial_unit;
+        }
+        if (x->mTag != TAG_namespace || y->mTag != TAG_namespace) return 0;
+        if (x->mName == NULL || y->mName == NULL) return 0;
+        if (strcmp(x->mName, y->mName) != 0) return 0;
+    }
+}
+
+static void merge_odr_type(PubNamesTable * tbl, unsigned n, ObjectInfo * obj) {
+    /* By the One Definition Rule, C++ types with same qualified name are same type in all compilation units.
+     * Link the copy to first loaded instance, find_definition() will then return the canonical object. */
+    if (!is_odr_type(obj)) return;
+    while (n != 0) {
+        ObjectInfo * pub = tbl->mNext[n].mObject;
+        if (pub->mTag == obj->mTag && pub->mCompUnit != obj->mCompUnit && is_odr_type(pub) &&
+                strcmp(pub->mName, obj->mName) == 0 && same_odr_scope(pub, obj)) {
+            set_object_definition(obj, pub);
+            return;
+        }
+        n = tbl->mNext[n].mNext;
+    }
+}
+#endif
+
 static void add_pub_name(PubNamesTable * tbl, ObjectInfo * obj) {
     PubNamesInfo * info = NULL;
     unsigned h = calc_symbol_name_hash(obj->mName) % tbl->mHashSize;
@@ -1228,14 +1356,21 @@ static void add_pub_name(PubNamesTable * tbl, ObjectInfo * obj) {
             unsigned n = tbl->mHash[h];
             while (n != 0) {
                 ObjectInfo * pub = tbl->mNext[n].mObject;
-                if (pub->mTag == obj->mTag && cmp_pub_objects(pub, obj)) return;
+                if (pub->mTag == obj->mTag && cmp_pub_objects(pub, obj)) {
+#if ENABLE_DWARF_ODR_TYPES
+                    merge_odr_type(tbl, n, obj);
+#endif
+                    return;
+                }
                 n = tbl->mNext[n].mNext;
             }
         }
     }
     if (tbl->mCnt >= tbl->mMax) {
+        sCache->mCacheSize -= sizeof(PubNamesInfo) * tbl->mMax;
         tbl->mMax = tbl->mMax * 3 / 2;
         tbl->mNext = (PubNamesInfo *)loc_realloc(tbl->mNext, sizeof(PubNamesInfo) * tbl->mMax);
+        sCache->mCacheSize += sizeof(PubNamesInfo) * tbl->mMax;
     }
     info = tbl->mNext + tbl->mCnt;
     info->mObject = obj;
@@ -1288,7 +1423,7 @@ static void load_pub_names(ELF_Section * debug_info, ELF_Section * pub_names) {
 static void add_namespace(PubNamesTable * tbl, ObjectInfo * ns) {
     ObjectInfo * obj = get_dwarf_children(ns);
     while (obj != NULL) {
-        if ((obj->mFlags & DOIF_pub_mark) == 0 && obj->mDefinition == NULL && obj->mName != NULL) {
+        if ((obj->mFlags & (DOIF_pub_mark | DOIF_definition)) == 0 && obj->mName != NULL) {
             if (ns->mTag == TAG_namespace ||
                     ns->mCompUnit->mLanguage == LANG_ADA95 ||
                     (obj->mTag != TAG_variable && obj->mTag != TAG_subprogram) ||
@@ -1330,6 +1465,7 @@ static void allocate_obj_hash(ELF_Section * sec) {
     HashTable->mObjectHashSize = (unsigned)(sec->size / 53);
     if (HashTable->mObjectHashSize < 251) HashTable->mObjectHashSize = 251;
     HashTable->mObjectHash = (ObjectInfo **)loc_alloc_zero(sizeof(ObjectInfo *) * HashTable->mObjectHashSize);
+    sCache->mCacheSize += sizeof(ObjectInfo *) * HashTable->mObjectHashSize;
 }
 
 static int unit_id_comparator(const void * x1, const void * x2) {
@@ -1374,6 +1510,7 @@ static void load_debug_info_section(ELF_Section * sec) {
         unsigned i = 0;
         ObjectInfo * unit = sCache->mObjectHashTable[sec->index].mCompUnits;
         HashTable->mCompUnitsIndex = (CompUnit **)loc_alloc(sizeof(CompUnit *) * HashTable->mCompUnitsIndexSize);
+        sCache->mCacheSize += sizeof(CompUnit *) * HashTable->mCompUnitsIndexSize;
         while (unit != NULL) {
             assert(unit->mTag == TAG_compile_unit || unit->mTag == TAG_partial_unit || unit->mTag == TAG_type_unit);
             HashTable->mCompUnitsIndex[i++] = unit->mCompUnit;
@@ -1408,6 +1545,7 @@ static void load_debug_sections(void) {
         sCache->mTypeUnitHashSize = (unsigned)(debug_types_size / 101);
         if (sCache->mTypeUnitHashSize < 239) sCache->mTypeUnitHashSize = 239;
         sCache->mTypeUnitHash = (CompUnit **)loc_alloc_zero(sizeof(CompUnit *) * sCache->mTypeUnitHashSize);
+        sCache->mCacheSize += sizeof(CompUnit *) * sCache->mTypeUnitHashSize;
     }
 
     for (idx = 1; idx < file->section_cnt; idx++) {
@@ -1478,12 +1616,14 @@ static void load_debug_sections(void) {
         frame_info_e = idx->mNext;
         idx->mNext = sCache->mFrameInfo;
         sCache->mFrameInfo = idx;
+        sCache->mCacheSize += sizeof(FrameInfoIndex);
     }
     while (frame_info_d != NULL) {
         FrameInfoIndex * idx = frame_info_d;
         frame_info_d = idx->mNext;
         idx->mNext = sCache->mFrameInfo;
         sCache->mFrameInfo = idx;
+        sCache->mCacheSize += sizeof(FrameInfoIndex);
     }
 
     if (debug_info != NULL) {
@@ -1491,6 +1631,7 @@ static void load_debug_sections(void) {
         tbl->mHashSize = tbl->mMax = (unsigned)(debug_info->size / 151) + 16;
         tbl->mHash = (unsigned *)loc_alloc_zero(sizeof(unsigned) * tbl->mHashSize);
         tbl->mNext = (PubNamesInfo *)loc_alloc(sizeof(PubNamesInfo) * tbl->mMax);
+        sCache->mCacheSize += (sizeof(unsigned) + sizeof(PubNamesInfo)) * tbl->mHashSize;
         memset(tbl->mNext + tbl->mCnt++, 0, sizeof(PubNamesInfo));
         for (idx = 1; idx < file->section_cnt; idx++) {
             ELF_Section * sec = file->sections + idx;
@@ -1648,8 +1789,8 @@ void read_dwarf_object_property(Context * Ctx, int Frame, ObjectInfo * Obj, U2_T
                 case FMT_UT_X_C:
                 case FMT_UT_X_X:
                     Value->mForm = FORM_BLOCK2;
-                    Value->mAddr = Obj->u.mRange.mLow.mExpr.mAddr;
-                    Value->mSize = Obj->u.mRange.mLow.mExpr.mSize;
+                    Value->mAddr = Obj->u.mRange.mLow.mExpr;
+                    Value->mSize = Obj->u.mRange.mLowSize;
                     return;
                 }
             }
@@ -1666,8 +1807,8 @@ void read_dwarf_object_property(Context * Ctx, int Frame, ObjectInfo * Obj, U2_T
                 case FMT_UT_C_X:
                 case FMT_UT_X_X:
                     Value->mForm = FORM_BLOCK2;
-                    Value->mAddr = Obj->u.mRange.mHigh.mExpr.mAddr;
-                    Value->mSize = Obj->u.mRange.mHigh.mExpr.mSize;
+                    Value->mAddr = Obj->u.mRange.mHigh.mExpr;
+                    Value->mSize = Obj->u.mRange.mHighSize;
                     return;
                 }
             }
@@ -1962,10 +2103,24 @@ static void free_dwarf_cache(ELF_File * file) {
             loc_free(idx->mFrameInfoRanges);
             loc_free(idx);
         }
+        for (i = 0; i < Cache->mAddrRangesCnt; i++) {
+            loc_free(Cache->mAddrRanges[i].mRows);
+        }
+        for (i = 0; i < Cache->mLocListHashSize; i++) {
+            while (Cache->mLocListHash[i] != NULL) {
+                LocationList * List = Cache->mLocListHash[i];
+                Cache->mLocListHash[i] = List->mNext;
+                loc_free(List->mEntries);
+                loc_free(List);
+            }
+        }
+        loc_free(Cache->mLocListHash);
         loc_free(Cache->mObjectHashTable);
         loc_free(Cache->mAddrRanges);
         loc_free(Cache->mPubNames.mHash);
         loc_free(Cache->mPubNames.mNext);
+        loc_free(Cache->mDefinitions.mHash);
+        loc_free(Cache->mDefinitions.mLinks);
         loc_free(Cache->mFileInfoHash);
         loc_free(Cache->mTypeUnitHash);
         loc_free(Cache);
@@ -1973,12 +2128,19 @@ static void free_dwarf_cache(ELF_File * file) {
     }
 }
 
+static size_t get_dwarf_cache_size(ELF_File * file) {
+    DWARFCache * Cache = (DWARFCache *)file->dwarf_dt_cache;
+    if (Cache == NULL) return 0;
+    return Cache->mCacheSize;
+}
+
 DWARFCache * get_dwarf_cache(ELF_File * file) {
     DWARFCache * Cache = (DWARFCache *)file->dwarf_dt_cache;
     if (Cache == NULL) {
         Trap trap;
         if (!sCloseListenerOK) {
             elf_add_close_listener(free_dwarf_cache);
+            elf_add_size_listener(get_dwarf_cache_size);
             sCloseListenerOK = 1;
         }
         if (file->dwz_file_name != NULL) {
@@ -1994,6 +2156,7 @@ DWARFCache * get_dwarf_cache(ELF_File * file) {
         sCache->mFile = file;
         sCache->mObjectArrayPos = OBJECT_ARRAY_SIZE;
         sCache->mObjectHashTable = (ObjectHashTable *)loc_alloc_zero(sizeof(ObjectHashTable) * file->section_cnt);
+        sCache->mCacheSize = sizeof(DWARFCache) + sizeof(ObjectHashTable) * file->section_cnt;
         if (set_trap(&trap)) {
             dio_LoadAbbrevTable(file);
             load_debug_sections();
@@ -2090,6 +2253,7 @@ static void compute_reverse_lookup_indices(DWARFCache * Cache, CompUnit * Unit)
     U4_T i;
     qsort(Unit->mStates, Unit->mStatesCnt, sizeof(LineNumbersState), state_address_comparator);
     Unit->mStatesIndex = (LineNumbersState **)loc_alloc(sizeof(LineNumbersState *) * Unit->mStatesCnt);
+    Cache->mCacheSize += sizeof(LineNumbersState *) * Unit->mStatesCnt;
     for (i = 0; i < Unit->mStatesCnt; i++) {
         LineNumbersState * s1 = Unit->mStates + i;
         while (i + 1 < Unit->mStatesCnt) {
@@ -2108,7 +2272,10 @@ static void compute_reverse_lookup_indices(DWARFCache * Cache, CompUnit * Unit)
     if (Cache->mFileInfoHash == NULL) {
         Cache->mFileInfoHashSize = 251;
         Cache->mFileInfoHash = (FileInfo **)loc_alloc_zero(sizeof(FileInfo *) * Cache->mFileInfoHashSize);
+        Cache->mCacheSize += sizeof(FileInfo *) * Cache->mFileInfoHashSize;
     }
+    Cache->mCacheSize += sizeof(FileInfo) * Unit->mFilesMax + sizeof(char *) * Unit->mDirsMax;
+    Cache->mCacheSize += sizeof(LineNumbersState) * Unit->mStatesMax;
     for (i = 0; i < Unit->mFilesCnt; i++) {
         FileInfo * File = Unit->mFiles + i;
         unsigned h = File->mNameHash % Cache->mFileInfoHashSize;
@@ -2300,6 +2467,134 @@ static void load_line_numbers_v2(CompUnit * Unit, U8_T unit_size, int dwarf64) {
     }
 }
 
+static LocationList * read_location_list(CompUnit * Unit, U8_T Offset) {
+    Trap trap;
+    DWARFCache * Cache = (DWARFCache *)Unit->mFile->dwarf_dt_cache;
+    LocationList * List = (LocationList *)loc_alloc_zero(sizeof(LocationList));
+    unsigned Max = 0;
+
+    List->mUnit = Unit;
+    List->mOffset = Offset;
+    List->mSorted = 1;
+    dio_EnterSection(&Unit->mDesc, Cache->mDebugLoc, Offset);
+    if (set_trap(&trap)) {
+        U8_T Base = Unit->mObject->u.mCode.mLowPC;
+        U8_T AddrMax = ~(U8_T)0;
+        if (Unit->mDesc.mAddressSize < 8) AddrMax = ((U8_T)1 << Unit->mDesc.mAddressSize * 8) - 1;
+        for (;;) {
+            ELF_Section * S0 = NULL;
+            ELF_Section * S1 = NULL;
+            U8_T Addr0 = dio_ReadAddress(&S0);
+            U8_T Addr1 = dio_ReadAddress(&S1);
+            if (Addr0 == AddrMax) {
+                Base = Addr1;
+            }
+            else if (Addr0 == 0 && Addr1 == 0) {
+                break;
+            }
+            else if (Addr0 > Addr1) {
+                str_exception(ERR_INV_DWARF, "Invalid .debug_loc section");
+            }
+            else {
+                LocationListEntry * Entry = NULL;
+                if (List->mCnt >= Max) {
+                    Max = Max == 0 ? 8 : Max * 2;
+                    List->mEntries = (LocationListEntry *)loc_realloc(List->mEntries, sizeof(LocationListEntry) * Max);
+                }
+                Entry = List->mEntries + List->mCnt++;
+                Entry->mSection0 = S0 != NULL ? S0 : Unit->mTextSection;
+                Entry->mSection1 = S1 != NULL ? S1 : Unit->mTextSection;
+                Entry->mAddr0 = Base + Addr0;
+                Entry->mAddr1 = Base + Addr1;
+                Entry->mExprSize = dio_ReadU2();
+                Entry->mExpr = dio_GetDataPtr();
+                if (Entry->mAddr0 == Entry->mAddr1) {
+                    List->mSorted = 0;
+                }
+                else if (Entry->mSection0 != Entry->mSection1 || Entry->mSection0 != List->mEntries->mSection0) {
+                    List->mSorted = 0;
+                }
+                else if (List->mCnt > 1 && Entry[-1].mAddr1 > Entry->mAddr0) {
+                    List->mSorted = 0;
+                }
+                dio_Skip(Entry->mExprSize);
+            }
+        }
+        dio_ExitSection();
+        clear_trap(&trap);
+    }
+    else {
+        dio_ExitSection();
+        loc_free(List->mEntries);
+        loc_free(List);
+        exception(trap.error);
+    }
+    Cache->mCacheSize += sizeof(LocationList) + sizeof(LocationListEntry) * Max;
+    return List;
+}
+
+LocationList * get_location_list(CompUnit * Unit, U8_T Offset) {
+    DWARFCache * Cache = (DWARFCache *)Unit->mFile->dwarf_dt_cache;
+    LocationList * List = NULL;
+    unsigned h;
+
+    assert(Cache->magic == DWARF_CACHE_MAGIC);
+    if (Cache->mDebugLoc == NULL) str_exception(ERR_INV_DWARF, "Missing .debug_loc section");
+    if (Cache->mLocListHash != NULL) {
+        List = Cache->mLocListHash[Offset % Cache->mLocListHashSize];
+        while (List != NULL) {
+            if (List->mOffset == Offset && List->mUnit == Unit) return List;
+            List = List->mNext;
+        }
+    }
+    if (Cache->mLocListCnt >= Cache->mLocListHashSize) {
+        unsigned i;
+        unsigned Size = Cache->mLocListHashSize == 0 ? 251 : Cache->mLocListHashSize * 2 + 1;
+        LocationList ** Hash = (LocationList **)loc_alloc_zero(sizeof(LocationList *) * Size);
+        for (i = 0; i < Cache->mLocListHashSize; i++) {
+            while (Cache->mLocListHash[i] != NULL) {
+                LocationList * Next = Cache->mLocListHash[i];
+                Cache->mLocListHash[i] = Next->mNext;
+                h = (unsigned)(Next->mOffset % Size);
+                Next->mNext = Hash[h];
+                Hash[h] = Next;
+            }
+        }
+        loc_free(Cache->mLocListHash);
+        Cache->mCacheSize -= sizeof(LocationList *) * Cache->mLocListHashSize;
+        Cache->mCacheSize += sizeof(LocationList *) * Size;
+        Cache->mLocListHash = Hash;
+        Cache->mLocListHashSize = Size;
+    }
+    List = read_location_list(Unit, Offset);
+    h = (unsigned)(Offset % Cache->mLocListHashSize);
+    List->mNext = Cache->mLocListHash[h];
+    Cache->mLocListHash[h] = List;
+    Cache->mLocListCnt++;
+    return List;
+}
+
+LocationListEntry * find_location_list_entry(LocationList * List, U8_T Addr) {
+    unsigned i;
+    if (List->mSorted) {
+        unsigned l = 0;
+        unsigned h = List->mCnt;
+        while (l < h) {
+            unsigned k = (h + l) / 2;
+            LocationListEntry * Entry = List->mEntries + k;
+            if (Entry->mAddr1 <= Addr) l = k + 1;
+            else if (Entry->mAddr0 > Addr) h = k;
+            else return Entry;
+        }
+        return NULL;
+    }
+    for (i = 0; i < List->mCnt; i++) {
+        LocationListEntry * Entry = List->mEntries + i;
+        if (Entry->mAddr0 <= Addr && Entry->mAddr1 > Addr) return Entry;
+    }
+    return NULL;
+}
+
 void load_line_numbers(CompUnit * Unit) {
     Trap trap;
     DWARFCache * Cache = (DWARFCache *)Unit->mFile->dwarf_dt_cache;
@@ -36,8 +36,14 @@
 #  define ENABLE_DWARF_LAZY_LOAD 1
 #endif
 
+#ifndef ENABLE_DWARF_ODR_TYPES
+#  define ENABLE_DWARF_ODR_TYPES 1
+#endif
+
 typedef struct FileInfo FileInfo;
 typedef struct ObjectInfo ObjectInfo;
+typedef struct ObjectDefinition ObjectDefinition;
+typedef struct ObjectDefinitionTable ObjectDefinitionTable;
 typedef struct PubNamesInfo PubNamesInfo;
 typedef struct PubNamesTable PubNamesTable;
 typedef struct SymbolInfo SymbolInfo;
@@ -46,6 +52,9 @@ typedef struct LineNumbersState LineNumbersState;
 typedef struct CompUnit CompUnit;
 typedef struct SymbolSection SymbolSection;
 typedef struct UnitAddressRange UnitAddressRange;
+typedef struct LineNumbersRow LineNumbersRow;
+typedef struct LocationListEntry LocationListEntry;
+typedef struct LocationList LocationList;
 typedef struct FrameInfoRange FrameInfoRange;
 typedef struct FrameInfoIndex FrameInfoIndex;
 typedef struct ObjectHashTable ObjectHashTable;
@@ -91,6 +100,7 @@ struct FileInfo {
 #define DOIF_location           0x200000
 #define DOIF_data_location      0x400000
 #define DOIF_const_value        0x800000
+#define DOIF_definition         0x1000000
 
 struct ObjectInfo {
 
@@ -103,7 +113,6 @@ struct ObjectInfo {
     ObjectInfo * mSibling;
     ObjectInfo * mChildren;
     ObjectInfo * mParent;
-    ObjectInfo * mDefinition;
 
     U2_T mTag;
     U4_T mFlags;
@@ -122,25 +131,37 @@ struct ObjectInfo {
             } mHighPC;
         } mCode;
         struct {
+            /* DWARF 1 subscript data: bounds are either constants or location expressions */
             U2_T mFmt;
+            U2_T mLowSize;
+            U2_T mHighSize;
             union {
                 I8_T mValue;
-                struct {
-                    U1_T * mAddr;
-                    size_t mSize;
-                } mExpr;
+                U1_T * mExpr;
             } mLow;
             union {
                 I8_T mValue;
-                struct {
-                    U1_T * mAddr;
-                    size_t mSize;
-                } mExpr;
+                U1_T * mExpr;
             } mHigh;
         } mRange;
     } u;
 };
 
+/* Declaration to definition links are rare, they are kept out of ObjectInfo in a per-cache hash table */
+struct ObjectDefinition {
+    ObjectInfo * mObject;
+    ObjectInfo * mDefinition;
+    unsigned mNext;
+};
+
+struct ObjectDefinitionTable {
+    unsigned mHashSize;
+    unsigned * mHash;
+    ObjectDefinition * mLinks;
+    unsigned mCnt;
+    unsigned mMax;
+};
+
 struct PubNamesInfo {
     unsigned mNext;
     ObjectInfo * mObject;
@@ -229,6 +250,44 @@ struct UnitAddressRange {
     U4_T mSection;          /* Index of ELF file section that contains the range */
     ContextAddress mAddr;   /* Link-time start address of the range */
     ContextAddress mSize;   /* Size of the range */
+    LineNumbersRow * mRows; /* Line number rows that overlap the range, sorted by address */
+    U4_T mRowsCnt;
+    U1_T mRowsLoaded;
+};
+
+/* Line number table row: code addresses mAddr..mEnd map to the source position of mUnit->mStates[mState] */
+struct LineNumbersRow {
+    ContextAddress mAddr;
+    ContextAddress mEnd;
+    U4_T mState;
+    U4_T mNext;             /* Index of next state in code order */
+};
+
+/* Decoded .debug_loc entry, addresses are link-time */
+struct LocationListEntry {
+    ELF_Section * mSection0;
+    ELF_Section * mSection1;
+    U8_T mAddr0;
+    U8_T mAddr1;
+    U1_T * mExpr;
+    U2_T mExprSize;
+};
+
+/* Decoded .debug_loc location list, entries are kept in the section order */
+struct LocationList {
+    CompUnit * mUnit;
+    U8_T mOffset;
+    LocationListEntry * mEntries;
+    unsigned mCnt;
+    int mSorted;            /* Entries are in one section, sorted by address and don't overlap */
+    LocationList * mNext;
+};
+
+struct FrameInfoRange {
+    U4_T mSection;
+    ContextAddress mAddr;
+    ContextAddress mSize;
+    U8_T mOffset;
 };
 
 struct FrameInfoIndex {
@@ -237,6 +296,11 @@ struct FrameInfoIndex {
     FrameInfoRange * mFrameInfoRanges;
     unsigned mFrameInfoRangesCnt;
     unsigned mFrameInfoRangesMax;
+    int mHdrChecked;
+    ELF_Section * mHdrSection;  /* .eh_frame_hdr, if it has usable binary search table */
+    U8_T mHdrTablePos;
+    unsigned mHdrTableCnt;
+    U1_T mHdrTableEnc;
     FrameInfoIndex * mNext;
 };
 
@@ -268,12 +332,17 @@ struct DWARFCache {
     unsigned mAddrRangesMax;
     int mAddrRangesRelocatable;
     PubNamesTable mPubNames;
+    ObjectDefinitionTable mDefinitions;
     FrameInfoIndex * mFrameInfo;
+    LocationList ** mLocListHash;
+    unsigned mLocListHashSize;
+    unsigned mLocListCnt;
     unsigned mFileInfoHashSize;
     FileInfo ** mFileInfoHash;
     int mLineInfoLoaded;
     CompUnit ** mTypeUnitHash;
     unsigned mTypeUnitHashSize;
+    size_t mCacheSize;  /* Memory allocated for the cache, bytes */
     int lazy_loaded;
 };
 
@@ -296,9 +365,21 @@ extern unsigned calc_file_name_hash(const char * s);
 /* Load line number information for given compilation unit, throw an exception if error */
 extern void load_line_numbers(CompUnit * unit);
 
+/* Return decoded location list at 'offset' in .debug_loc, throw an exception if error */
+extern LocationList * get_location_list(CompUnit * unit, U8_T offset);
+
+/* Search location list entry that contains link-time address 'addr', return NULL if not found */
+extern LocationListEntry * find_location_list_entry(LocationList * list, U8_T addr);
+
 /* Find ObjectInfo by ID */
 extern ObjectInfo * find_object(ELF_Section * sec, ContextAddress ID);
 
+/* Return definition of a declaration object, as recorded by set_object_definition(), or NULL */
+extern ObjectInfo * get_object_definition(ObjectInfo * obj);
+
+/* Record 'def' as definition of declaration object 'obj' */
+extern void set_object_definition(ObjectInfo * obj, ObjectInfo * def);
+
 /* Search and return first compilation unit address range in given link-time address range 'addr_min'..'addr_max' (inclusive). */
 extern UnitAddressRange * find_comp_unit_addr_range(DWARFCache * cache, ELF_Section * section,
     ContextAddress addr_min, ContextAddress addr_max);
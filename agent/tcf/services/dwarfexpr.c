@@ -32,66 +32,58 @@
 #include <tcf/services/elf-symbols.h>
 #include <tcf/services/vm.h>
 
+static U8_T get_location_list_offset(PropertyValue * Value) {
+    CompUnit * Unit = Value->mObject->mCompUnit;
+    U8_T Offset = 0;
+    dio_EnterSection(&Unit->mDesc, Unit->mDesc.mSection, Value->mAddr - (U1_T *)Unit->mDesc.mSection->data);
+    Offset = dio_ReadAddressX(NULL, Value->mSize);
+    dio_ExitSection();
+    return Offset;
+}
+
+static DWARFExpressionInfo * get_location_list_entry_info(PropertyValue * Value, LocationListEntry * Entry) {
+    CompUnit * Unit = Value->mObject->mCompUnit;
+    DWARFCache * Cache = (DWARFCache *)Unit->mFile->dwarf_dt_cache;
+    U8_T RT_Addr0 = 0;
+    U8_T RT_Addr1 = 0;
+    DWARFExpressionInfo * Info = NULL;
+
+    RT_Addr0 = elf_map_to_run_time_address(Value->mContext, Unit->mFile, Entry->mSection0, Entry->mAddr0);
+    if (!errno) RT_Addr1 = elf_map_to_run_time_address(Value->mContext, Unit->mFile, Entry->mSection1, Entry->mAddr1);
+    if (errno) return NULL;
+    Info = (DWARFExpressionInfo *)tmp_alloc_zero(sizeof(DWARFExpressionInfo));
+    Info->object = Value->mObject;
+    Info->code_addr = RT_Addr0;
+    Info->code_size = RT_Addr1 - RT_Addr0;
+    Info->section = Cache->mDebugLoc;
+    Info->expr_addr = Entry->mExpr;
+    Info->expr_size = Entry->mExprSize;
+    Info->attr = Value->mAttr;
+    Info->form = Value->mForm;
+    return Info;
+}
+
+static int is_location_list(PropertyValue * Value) {
+    return Value->mForm == FORM_DATA4 || Value->mForm == FORM_DATA8 || Value->mForm == FORM_SEC_OFFSET;
+}
+
 void dwarf_get_expression_list(PropertyValue * Value, DWARFExpressionInfo ** List) {
     CompUnit * Unit = Value->mObject->mCompUnit;
 
     if (Value->mAddr == NULL || Value->mSize == 0) str_exception(ERR_INV_DWARF, "Invalid format of location expression");
 
-    if (Value->mForm == FORM_DATA4 || Value->mForm == FORM_DATA8 || Value->mForm == FORM_SEC_OFFSET) {
-        U8_T Base = 0;
-        U8_T Offset = 0;
-        U8_T AddrMax = ~(U8_T)0;
-        DWARFCache * Cache = (DWARFCache *)Unit->mFile->dwarf_dt_cache;
+    if (is_location_list(Value)) {
+        LocationList * Loc = get_location_list(Unit, get_location_list_offset(Value));
         DWARFExpressionInfo * Last = NULL;
-
-        assert(Cache->magic == DWARF_CACHE_MAGIC);
-        if (Cache->mDebugLoc == NULL) str_exception(ERR_INV_DWARF, "Missing .debug_loc section");
-        dio_EnterSection(&Unit->mDesc, Unit->mDesc.mSection, Value->mAddr - (U1_T *)Unit->mDesc.mSection->data);
-        Offset = dio_ReadAddressX(NULL, Value->mSize);
-        dio_ExitSection();
-        Base = Unit->mObject->u.mCode.mLowPC;
-        if (Unit->mDesc.mAddressSize < 8) AddrMax = ((U8_T)1 << Unit->mDesc.mAddressSize * 8) - 1;
-        dio_EnterSection(&Unit->mDesc, Cache->mDebugLoc, Offset);
-        for (;;) {
-            ELF_Section * S0 = NULL;
-            ELF_Section * S1 = NULL;
-            U8_T Addr0 = dio_ReadAddress(&S0);
-            U8_T Addr1 = dio_ReadAddress(&S1);
-            if (Addr0 == AddrMax) {
-                Base = Addr1;
-            }
-            else if (Addr0 == 0 && Addr1 == 0) {
-                break;
-            }
-            else if (Addr0 > Addr1) {
-                str_exception(ERR_INV_DWARF, "Invalid .debug_loc section");
-            }
-            else {
-                U2_T Size = dio_ReadU2();
-                U8_T RT_Addr0 = 0;
-                U8_T RT_Addr1 = 0;
-                if (S0 == NULL) S0 = Unit->mTextSection;
-                if (S1 == NULL) S1 = Unit->mTextSection;
-                RT_Addr0 = elf_map_to_run_time_address(Value->mContext, Unit->mFile, S0, Base + Addr0);
-                if (!errno) RT_Addr1 = elf_map_to_run_time_address(Value->mContext, Unit->mFile, S1, Base + Addr1);
-                if (!errno) {
-                    DWARFExpressionInfo * Info = (DWARFExpressionInfo *)tmp_alloc_zero(sizeof(DWARFExpressionInfo));
-                    Info->object = Value->mObject;
-                    Info->code_addr = RT_Addr0;
-                    Info->code_size = RT_Addr1 - RT_Addr0;
-                    Info->section = Cache->mDebugLoc;
-                    Info->expr_addr = dio_GetDataPtr();
-                    Info->expr_size = Size;
-                    Info->attr = Value->mAttr;
-                    Info->form = Value->mForm;
-                    if (Last == NULL) *List = Info;
-                    else Last->next = Info;
-                    Last = Info;
-                }
-                dio_Skip(Size);
-            }
+        unsigned i;
+
+        for (i = 0; i < Loc->mCnt; i++) {
+            DWARFExpressionInfo * Info = get_location_list_entry_info(Value, Loc->mEntries + i);
+            if (Info == NULL) continue;
+            if (Last == NULL) *List = Info;
+            else Last->next = Info;
+            Last = Info;
         }
-        dio_ExitSection();
         if (Last == NULL) str_exception(ERR_OTHER, "Object is not available at this location in the code");
     }
     else {
@@ -106,6 +98,28 @@ void dwarf_get_expression_list(PropertyValue * Value, DWARFExpressionInfo ** Lis
     }
 }
 
+static DWARFExpressionInfo * get_frame_expression(PropertyValue * Value, StackFrame * Frame) {
+    /* Use location list index to select the entry for the frame PC,
+     * instead of transforming and evaluating every entry of the list */
+    CompUnit * Unit = Value->mObject->mCompUnit;
+    RegisterDefinition * Def = get_PC_definition(Value->mContext);
+    ELF_File * File = NULL;
+    LocationList * Loc = NULL;
+    LocationListEntry * Entry = NULL;
+    ContextAddress Addr = 0;
+    uint64_t PC = 0;
+
+    if (Frame == NULL || Def == NULL || Unit->mFile->type == ET_REL) return NULL;
+    if (read_reg_value(Frame, Def, &PC) < 0) return NULL;
+    Loc = get_location_list(Unit, get_location_list_offset(Value));
+    if (!Loc->mSorted) return NULL;
+    Addr = elf_map_to_link_time_address(Value->mContext, (ContextAddress)PC, 1, &File, NULL);
+    if (errno || File != Unit->mFile) return NULL;
+    Entry = find_location_list_entry(Loc, Addr);
+    if (Entry == NULL) str_exception(ERR_OTHER, "Object is not available at this location in the code");
+    return get_location_list_entry_info(Value, Entry);
+}
+
 typedef struct ExpressionArgs {
     PropertyValue * value;
     uint64_t * args;
@@ -145,7 +159,8 @@ static void evaluate_expression(void * x) {
     if (Value->mPieces != NULL || Value->mAddr == NULL || Value->mSize == 0) {
         str_exception(ERR_INV_DWARF, "Invalid DWARF expression reference");
     }
-    dwarf_get_expression_list(Value, &Info);
+    if (is_location_list(Value)) Info = get_frame_expression(Value, State->stack_frame);
+    if (Info == NULL) dwarf_get_expression_list(Value, &Info);
     dwarf_transform_expression(Value->mContext, Value->mFrame, Info);
     State->code = Info->expr_addr;
     State->code_len = Info->expr_size;
@@ -52,6 +52,10 @@
 
 #define EH_PE_indirect          0x80
 
+#ifndef PT_GNU_EH_FRAME
+#define PT_GNU_EH_FRAME         0x6474e550
+#endif
+
 #define RULE_OFFSET             1
 #define RULE_SAME_VALUE         2
 #define RULE_REGISTER           3
@@ -59,13 +63,6 @@
 #define RULE_VAL_OFFSET         5
 #define RULE_VAL_EXPRESSION     6
 
-struct FrameInfoRange {
-    U4_T mSection;
-    ContextAddress mAddr;
-    ContextAddress mSize;
-    U8_T mOffset;
-};
-
 typedef struct RegisterRules {
     int rule;
     I4_T offset;
@@ -1135,7 +1132,6 @@ static void read_frame_fde(U8_T IP, U8_T fde_pos) {
         if (cie_ref != rules.cie_pos) read_frame_cie(fde_pos, cie_ref);
         Addr = read_frame_data_pointer(rules.addr_encoding, &rules.loc_section, 0);
         Range = read_frame_data_pointer(rules.addr_encoding, NULL, 0);
-        assert(Addr <= IP && Addr + Range > IP);
         if (Addr <= IP && Addr + Range > IP) {
             U8_T location0 = Addr;
             if (rules.cie_aug != NULL && rules.cie_aug[0] == 'z') {
@@ -1233,10 +1229,12 @@ static void create_search_index(DWARFCache * cache, FrameInfoIndex * index) {
             if (rules.eh_frame) cie_ref = ref_pos - cie_ref;
             if (cie_ref != rules.cie_pos) read_frame_cie(fde_pos, cie_ref);
             if (index->mFrameInfoRangesCnt >= index->mFrameInfoRangesMax) {
+                cache->mCacheSize -= index->mFrameInfoRangesMax * sizeof(FrameInfoRange);
                 index->mFrameInfoRangesMax += 512;
                 if (index->mFrameInfoRanges == NULL) index->mFrameInfoRangesMax += (unsigned)(section->size / 32);
                 index->mFrameInfoRanges = (FrameInfoRange *)loc_realloc(index->mFrameInfoRanges,
                     index->mFrameInfoRangesMax * sizeof(FrameInfoRange));
+                cache->mCacheSize += index->mFrameInfoRangesMax * sizeof(FrameInfoRange);
             }
             range = index->mFrameInfoRanges + index->mFrameInfoRangesCnt++;
             memset(range, 0, sizeof(FrameInfoRange));
@@ -1254,6 +1252,103 @@ static void create_search_index(DWARFCache * cache, FrameInfoIndex * index) {
     qsort(index->mFrameInfoRanges, index->mFrameInfoRangesCnt, sizeof(FrameInfoRange), cmp_frame_info_ranges);
 }
 
+static unsigned get_frame_data_pointer_size(U1_T encoding, ELF_File * file) {
+    if (encoding & EH_PE_indirect) return 0;
+    if (((encoding >> 4) & 0x7) == EH_PB_aligned) return 0;
+    switch (encoding & 0xf) {
+    case EH_PE_absptr: return file->elf64 ? 8 : 4;
+    case EH_PE_udata2:
+    case EH_PE_sdata2: return 2;
+    case EH_PE_udata4:
+    case EH_PE_sdata4: return 4;
+    case EH_PE_udata8:
+    case EH_PE_sdata8: return 8;
+    }
+    return 0;
+}
+
+static ELF_Section * find_eh_frame_hdr(ELF_File * file) {
+    unsigned i;
+    for (i = 1; i < file->section_cnt; i++) {
+        ELF_Section * sec = file->sections + i;
+        if (sec->name == NULL || sec->type == SHT_NOBITS) continue;
+        if (strcmp(sec->name, ".eh_frame_hdr") == 0) return sec;
+    }
+    for (i = 0; i < file->pheader_cnt; i++) {
+        ELF_PHeader * p = file->pheaders + i;
+        unsigned j;
+        if (p->type != PT_GNU_EH_FRAME) continue;
+        for (j = 1; j < file->section_cnt; j++) {
+            ELF_Section * sec = file->sections + j;
+            if (sec->type == SHT_NOBITS || (sec->flags & SHF_ALLOC) == 0) continue;
+            if (sec->addr == p->address && sec->size >= p->file_size) return sec;
+        }
+    }
+    return NULL;
+}
+
+static void read_eh_frame_hdr(FrameInfoIndex * index) {
+    ELF_Section * section = index->mSection;
+    ELF_Section * hdr = find_eh_frame_hdr(section->file);
+    ELF_Section * sec = NULL;
+    U1_T version, ptr_enc, cnt_enc, tbl_enc;
+
+    if (hdr == NULL || hdr->size < 4) return;
+    /* Pointers in .eh_frame_hdr are relative to the start of the section */
+    rules.section = hdr;
+    dio_EnterSection(NULL, hdr, 0);
+    version = dio_ReadU1();
+    ptr_enc = dio_ReadU1();
+    cnt_enc = dio_ReadU1();
+    tbl_enc = dio_ReadU1();
+    if (version == 1 && get_frame_data_pointer_size(ptr_enc, hdr->file) > 0 &&
+            get_frame_data_pointer_size(cnt_enc, hdr->file) > 0) {
+        unsigned size = get_frame_data_pointer_size(tbl_enc, hdr->file);
+        U8_T eh_frame_addr = read_frame_data_pointer(ptr_enc, &sec, 0);
+        U8_T cnt = read_frame_data_pointer(cnt_enc, &sec, 0);
+        if (size > 0 && cnt > 0 && eh_frame_addr == section->addr &&
+                dio_GetPos() + cnt * size * 2 <= hdr->size) {
+            index->mHdrSection = hdr;
+            index->mHdrTablePos = dio_GetPos();
+            index->mHdrTableCnt = (unsigned)cnt;
+            index->mHdrTableEnc = tbl_enc;
+        }
+    }
+    dio_ExitSection();
+    rules.section = section;
+}
+
+static int search_eh_frame_hdr(FrameInfoIndex * index, U8_T IP, U8_T * fde_pos) {
+    ELF_Section * section = index->mSection;
+    ELF_Section * sec = NULL;
+    unsigned size = get_frame_data_pointer_size(index->mHdrTableEnc, section->file);
+    unsigned l = 0;
+    unsigned h = index->mHdrTableCnt;
+    U8_T fde_addr = 0;
+    int found = 0;
+
+    /* The table is sorted by initial location, find last entry with location <= IP */
+    rules.section = index->mHdrSection;
+    dio_EnterSection(NULL, index->mHdrSection, 0);
+    while (l < h) {
+        unsigned k = (l + h) / 2;
+        dio_SetPos(index->mHdrTablePos + (U8_T)k * size * 2);
+        if (read_frame_data_pointer(index->mHdrTableEnc, &sec, 0) > IP) {
+            h = k;
+        }
+        else {
+            fde_addr = read_frame_data_pointer(index->mHdrTableEnc, &sec, 0);
+            found = 1;
+            l = k + 1;
+        }
+    }
+    dio_ExitSection();
+    rules.section = section;
+    if (!found || fde_addr < section->addr || fde_addr >= section->addr + section->size) return 0;
+    *fde_pos = fde_addr - section->addr;
+    return 1;
+}
+
 static void read_frame_info_section(Context * ctx, ELF_Section * text_section,
                                     U8_T IP, DWARFCache * cache, FrameInfoIndex * index) {
     unsigned l, h;
@@ -1286,6 +1381,18 @@ static void read_frame_info_section(Context * ctx, ELF_Section * text_section,
     rules.reg_id_scope.id_type = rules.eh_frame ? REGNUM_EH_FRAME : REGNUM_DWARF;
     rules.cie_pos = ~(U8_T)0;
 
+    if (rules.eh_frame && index->mFrameInfoRanges == NULL) {
+        /* Use .eh_frame_hdr lookup table instead of scanning whole .eh_frame */
+        U8_T fde_pos = 0;
+        if (!index->mHdrChecked) {
+            index->mHdrChecked = 1;
+            read_eh_frame_hdr(index);
+        }
+        if (index->mHdrSection != NULL) {
+            if (search_eh_frame_hdr(index, IP, &fde_pos)) read_frame_fde(IP, fde_pos);
+            return;
+        }
+    }
     if (index->mFrameInfoRanges == NULL) create_search_index(cache, index);
     l = 0;
     h = index->mFrameInfoRangesCnt;
@@ -33,9 +33,28 @@
 
 #define ABBREV_TABLE_SIZE  (4 * MEM_USAGE_FACTOR - 1)
 
+/*
+ * Abbreviation program: per attribute, offset of the attribute value from the start
+ * of a run of fixed size attributes. A run ends after an attribute with variable size.
+ * The program allows to skip uninteresting attributes without decoding them.
+ * Sizes depend on the unit address size and DWARF format, so the program is compiled
+ * lazily for the layout of the unit being read.
+ */
+struct DIO_AbbrevStep {
+    U4_T mOffs;
+    U2_T mRun;
+    U2_T mVarSize;
+};
+
+typedef struct DIO_AbbrevStep DIO_AbbrevStep;
+
 struct DIO_Abbreviation {
     U2_T mTag;
     U1_T mChildren;
+    U1_T mProgAddressSize;
+    U1_T mProgRefAddressSize;
+    U1_T mProg64bit;
+    DIO_AbbrevStep * mProg;
     U4_T mAttrLen;
     U2_T mAttrs[2];
 };
@@ -86,6 +105,8 @@ static void dio_CloseELF(ELF_File * File) {
             while (Set != NULL) {
                 DIO_AbbrevSet * Next = Set->mNext;
                 for (m = 0; m < Set->mSize; m++) {
+                    if (Set->mTable[m] == NULL) continue;
+                    loc_free(Set->mTable[m]->mProg);
                     loc_free(Set->mTable[m]);
                 }
                 loc_free(Set->mTable);
@@ -229,6 +250,19 @@ U8_T dio_ReadU8(void) {
 U4_T dio_ReadULEB128(void) {
     U4_T Res = 0;
     int i = 0;
+    if (sDataPos + 2 <= sDataLen) {
+        /* Fast path for one and two byte encodings */
+        U1_T n0 = sData[sDataPos];
+        U1_T n1 = sData[sDataPos + 1];
+        if ((n0 & 0x80) == 0) {
+            sDataPos++;
+            return n0;
+        }
+        if ((n1 & 0x80) == 0) {
+            sDataPos += 2;
+            return (n0 & 0x7Fu) | ((U4_T)n1 << 7);
+        }
+    }
     for (;; i += 7) {
         U1_T n = dio_ReadU1();
         Res |= (U4_T)(n & 0x7Fu) << i;
@@ -240,6 +274,18 @@ U4_T dio_ReadULEB128(void) {
 I4_T dio_ReadSLEB128(void) {
     U4_T Res = 0;
     int i = 0;
+    if (sDataPos + 2 <= sDataLen) {
+        U1_T n0 = sData[sDataPos];
+        U1_T n1 = sData[sDataPos + 1];
+        if ((n0 & 0x80) == 0) {
+            sDataPos++;
+            return (I4_T)(n0 & 0x3F) - (I4_T)(n0 & 0x40);
+        }
+        if ((n1 & 0x80) == 0) {
+            sDataPos += 2;
+            return (I4_T)((n0 & 0x7Fu) | ((n1 & 0x3Fu) << 7)) - (I4_T)((n1 & 0x40u) << 7);
+        }
+    }
     for (;; i += 7) {
         U1_T n = dio_ReadU1();
         Res |= (U4_T)(n & 0x7Fu) << i;
@@ -254,6 +300,18 @@ I4_T dio_ReadSLEB128(void) {
 U8_T dio_ReadU8LEB128(void) {
     U8_T Res = 0;
     int i = 0;
+    if (sDataPos + 2 <= sDataLen) {
+        U1_T n0 = sData[sDataPos];
+        U1_T n1 = sData[sDataPos + 1];
+        if ((n0 & 0x80) == 0) {
+            sDataPos++;
+            return n0;
+        }
+        if ((n1 & 0x80) == 0) {
+            sDataPos += 2;
+            return (n0 & 0x7Fu) | ((U8_T)n1 << 7);
+        }
+    }
     for (;; i += 7) {
         U1_T n = dio_ReadU1();
         Res |= (U8_T)(n & 0x7Fu) << i;
@@ -265,6 +323,18 @@ U8_T dio_ReadU8LEB128(void) {
 I8_T dio_ReadS8LEB128(void) {
     U8_T Res = 0;
     int i = 0;
+    if (sDataPos + 2 <= sDataLen) {
+        U1_T n0 = sData[sDataPos];
+        U1_T n1 = sData[sDataPos + 1];
+        if ((n0 & 0x80) == 0) {
+            sDataPos++;
+            return (I8_T)(n0 & 0x3F) - (I8_T)(n0 & 0x40);
+        }
+        if ((n1 & 0x80) == 0) {
+            sDataPos += 2;
+            return (I8_T)((n0 & 0x7Fu) | ((n1 & 0x3Fu) << 7)) - (I8_T)((n1 & 0x40u) << 7);
+        }
+    }
     for (;; i += 7) {
         U1_T n = dio_ReadU1();
         Res |= (U8_T)(n & 0x7Fu) << i;
@@ -489,6 +559,133 @@ void dio_ReadAttribute(U2_T Attr, U2_T Form) {
     }
 }
 
+#define DIO_VAR_SIZE 0xffffffffu
+
+static U4_T dio_FixedFormSize(U2_T Form) {
+    switch (Form) {
+    case FORM_ADDR          : return sAddressSize;
+    case FORM_REF           : return 4;
+    case FORM_GNU_REF_ALT   : return sUnit->m64bit ? 8 : 4;
+    case FORM_DATA1         : return 1;
+    case FORM_DATA2         : return 2;
+    case FORM_DATA4         : return 4;
+    case FORM_DATA8         : return 8;
+    case FORM_FLAG          : return 1;
+    case FORM_FLAG_PRESENT  : return 0;
+    case FORM_STRP          : return sUnit->m64bit ? 8 : 4;
+    case FORM_GNU_STRP_ALT  : return sUnit->m64bit ? 8 : 4;
+    case FORM_REF_ADDR      : return sRefAddressSize;
+    case FORM_REF1          : return 1;
+    case FORM_REF2          : return 2;
+    case FORM_REF4          : return 4;
+    case FORM_REF8          : return 8;
+    case FORM_SEC_OFFSET    : return sUnit->m64bit ? 8 : 4;
+    case FORM_REF_SIG8      : return 8;
+    }
+    return DIO_VAR_SIZE;
+}
+
+static void dio_SkipForm(U2_T Form) {
+    U4_T Size = dio_FixedFormSize(Form);
+    if (Size != DIO_VAR_SIZE) {
+        sDataPos += Size;
+        return;
+    }
+    switch (Form) {
+    case FORM_BLOCK1        : sDataPos += dio_ReadU1F(); return;
+    case FORM_BLOCK2        : sDataPos += dio_ReadU2(); return;
+    case FORM_BLOCK4        : sDataPos += dio_ReadU4(); return;
+    case FORM_BLOCK         : sDataPos += dio_ReadULEB128(); return;
+    case FORM_SDATA         : dio_ReadS8LEB128(); return;
+    case FORM_UDATA         : dio_ReadU8LEB128(); return;
+    case FORM_STRING        : dio_ReadFormString(); return;
+    case FORM_REF_UDATA     : dio_ReadULEB128(); return;
+    case FORM_EXPRLOC       : sDataPos += dio_ReadULEB128(); return;
+    case FORM_INDIRECT      : dio_SkipForm((U2_T)dio_ReadULEB128()); return;
+    }
+    str_fmt_exception(ERR_INV_DWARF, "Invalid FORM code 0x%04x", Form);
+}
+
+static void dio_CompileAbbrev(DIO_Abbreviation * Abbr) {
+    U4_T Cnt = Abbr->mAttrLen / 2;
+    U4_T Offs = 0;
+    U2_T Run = 0;
+    U4_T i;
+
+    if (Abbr->mProg == NULL) Abbr->mProg = (DIO_AbbrevStep *)loc_alloc(sizeof(DIO_AbbrevStep) * (Cnt + 1));
+    for (i = 0; i <= Cnt; i++) {
+        DIO_AbbrevStep * Step = Abbr->mProg + i;
+        U4_T Size = i < Cnt ? dio_FixedFormSize(Abbr->mAttrs[i * 2 + 1]) : 0;
+        Step->mOffs = Offs;
+        Step->mRun = Run;
+        Step->mVarSize = Size == DIO_VAR_SIZE;
+        if (Step->mVarSize) {
+            Offs = 0;
+            Run++;
+        }
+        else {
+            Offs += Size;
+        }
+    }
+    Abbr->mProgAddressSize = (U1_T)sAddressSize;
+    Abbr->mProgRefAddressSize = (U1_T)sRefAddressSize;
+    Abbr->mProg64bit = (U1_T)sUnit->m64bit;
+}
+
+/* Read only the target attribute and references to other entries, skip the rest using abbreviation program */
+static void dio_ReadEntryAttrs(DIO_Abbreviation * Abbr, U2_T Tag, DIO_EntryCallBack CallBack, U2_T TargetAttr) {
+    U4_T Cnt = Abbr->mAttrLen / 2;
+    DIO_AbbrevStep * Prog = NULL;
+    U8_T RunBase = sDataPos;
+    U4_T Run = 0;
+    U4_T Var = 0;
+    U4_T i;
+
+    if (Abbr->mProg == NULL || Abbr->mProgAddressSize != sAddressSize ||
+            Abbr->mProgRefAddressSize != sRefAddressSize || Abbr->mProg64bit != sUnit->m64bit) {
+        dio_CompileAbbrev(Abbr);
+    }
+    Prog = Abbr->mProg;
+    for (i = 0; i <= Cnt; i++) {
+        U2_T Attr = 0;
+        U2_T Form = 0;
+        if (i < Cnt) {
+            Attr = Abbr->mAttrs[i * 2];
+            switch (Attr) {
+            case AT_specification_v1:
+            case AT_specification_v2:
+            case AT_abstract_origin:
+            case AT_extension:
+                break;
+            default:
+                if (Attr != TargetAttr) continue;
+                break;
+            }
+        }
+        /* Skip variable size attributes up to the run that contains attribute 'i' */
+        while (Run < Prog[i].mRun) {
+            while (!Prog[Var].mVarSize) Var++;
+            sDataPos = RunBase + Prog[Var].mOffs;
+            dio_SkipForm(Abbr->mAttrs[Var * 2 + 1]);
+            RunBase = sDataPos;
+            Run++;
+            Var++;
+        }
+        sDataPos = RunBase + Prog[i].mOffs;
+        if (i == Cnt) break;
+        Form = Abbr->mAttrs[i * 2 + 1];
+        if (Form == FORM_INDIRECT) Form = (U2_T)dio_ReadULEB128();
+        dio_ReadAttribute(Attr, Form);
+        if (CallBack != NULL) CallBack(Tag, Attr, Form);
+        if (Prog[i].mVarSize) {
+            RunBase = sDataPos;
+            Run++;
+            Var = i + 1;
+        }
+    }
+    if (sDataPos > sDataLen) exception(ERR_EOF);
+}
+
 int dio_ReadEntry(DIO_EntryCallBack CallBack, U2_T TargetAttr) {
     DIO_Abbreviation * Abbr = NULL;
     U2_T Tag = 0;
@@ -505,6 +702,10 @@ int dio_ReadEntry(DIO_EntryCallBack CallBack, U2_T TargetAttr) {
         }
         Abbr =  sUnit->mAbbrevTable[AbbrCode];
         Tag = Abbr->mTag;
+        if (TargetAttr) {
+            dio_ReadEntryAttrs(Abbr, Tag, CallBack, TargetAttr);
+            return 1;
+        }
     }
     else {
         EntrySize = dio_ReadU4();
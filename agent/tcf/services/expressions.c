@@ -52,6 +52,7 @@
 #include <tcf/services/breakpoints.h>
 #include <tcf/services/registers.h>
 #include <tcf/services/expressions.h>
+#include <tcf/services/memorymap.h>
 #include <tcf/main/test.h>
 
 #define SY_LEQ   256
@@ -169,6 +170,36 @@ static ExpressionIdentifierCallBack ** id_callbacks = NULL;
 static int id_callback_max = 0;
 static int id_callback_cnt = 0;
 
+#if ENABLE_Symbols
+/*
+ * Results of symbol lookups done while evaluating an expression object.
+ * Watch windows re-evaluate same expressions after every stop, and the lookup
+ * by name is usually the most expensive part of an evaluation.
+ * Lookup results are remembered as symbol IDs, keyed by the context, the stack frame
+ * and the instruction address of the frame, since the address defines the lexical scope.
+ * The cache is discarded when memory map or module list changes.
+ */
+typedef struct SymbolLookup {
+    struct SymbolLookup * next;
+    Context * ctx;
+    int frame;
+    ContextAddress ip;
+    SYM_FLAGS flags;
+    char * scope;
+    char * name;
+    unsigned cnt;
+    char ** ids;
+} SymbolLookup;
+
+typedef struct SymbolLookupCache {
+    SymbolLookup * list;
+    unsigned generation;
+} SymbolLookupCache;
+
+static SymbolLookupCache * sym_lookup_cache = NULL;
+static unsigned sym_lookup_generation = 0;
+#endif
+
 static void ini_value(Value * v) {
     memset(v, 0, sizeof(Value));
     v->ctx = expression_context;
@@ -1147,6 +1178,121 @@ static unsigned flag_count(SYM_FLAGS flags) {
 }
 #endif /* ENABLE_Symbols */
 
+#if ENABLE_Symbols
+static void free_symbol_lookup(SymbolLookup * lookup) {
+    unsigned i;
+    for (i = 0; i < lookup->cnt; i++) loc_free(lookup->ids[i]);
+    loc_free(lookup->ids);
+    loc_free(lookup->scope);
+    loc_free(lookup->name);
+    loc_free(lookup);
+}
+
+static void free_symbol_lookup_cache(SymbolLookupCache * cache) {
+    while (cache->list != NULL) {
+        SymbolLookup * lookup = cache->list;
+        cache->list = lookup->next;
+        free_symbol_lookup(lookup);
+    }
+}
+
+static int is_same_symbol_lookup(SymbolLookup * x, SymbolLookup * y) {
+    if (x->ctx != y->ctx) return 0;
+    if (x->frame != y->frame) return 0;
+    if (x->ip != y->ip) return 0;
+    if (x->flags != y->flags) return 0;
+    if (strcmp(x->name, y->name) != 0) return 0;
+    if (x->scope == NULL || y->scope == NULL) return x->scope == y->scope;
+    return strcmp(x->scope, y->scope) == 0;
+}
+
+/* Fill the cache key of the lookup, return -1 if the lookup should not be cached.
+ * The key strings are not owned by the key, the scope ID is allocated with tmp_alloc() */
+static int get_symbol_lookup_key(Symbol * scope_sym, const char * name, SYM_FLAGS flags, SymbolLookup * key) {
+    SymbolLookupCache * cache = sym_lookup_cache;
+    int frame = expression_frame;
+    ContextAddress ip = expression_addr;
+
+    if (cache->generation != sym_lookup_generation) {
+        free_symbol_lookup_cache(cache);
+        cache->generation = sym_lookup_generation;
+    }
+    if (frame != STACK_NO_FRAME) {
+        uint64_t pc = 0;
+        StackFrame * info = NULL;
+        if (frame == STACK_TOP_FRAME) frame = get_top_frame(expression_context);
+        if (get_frame_info(expression_context, frame, &info) < 0) return -1;
+        if (read_reg_value(info, get_PC_definition(expression_context), &pc) < 0) return -1;
+        ip = (ContextAddress)pc;
+    }
+    memset(key, 0, sizeof(SymbolLookup));
+    key->ctx = expression_context;
+    key->frame = frame;
+    key->ip = ip;
+    key->flags = flags;
+    key->scope = scope_sym != NULL ? tmp_strdup(symbol2id(scope_sym)) : NULL;
+    key->name = (char *)name;
+    return 0;
+}
+
+static SymbolLookup * find_symbol_lookup(SymbolLookup * key) {
+    SymbolLookup * lookup = NULL;
+    for (lookup = sym_lookup_cache->list; lookup != NULL; lookup = lookup->next) {
+        if (is_same_symbol_lookup(lookup, key)) return lookup;
+    }
+    return NULL;
+}
+
+static void remove_symbol_lookups(SymbolLookup * key, int same_ip) {
+    /* Remove cached lookups that match the key, and lookups of the key frame at other addresses */
+    SymbolLookup ** p = &sym_lookup_cache->list;
+    while (*p != NULL) {
+        SymbolLookup * lookup = *p;
+        if (lookup->ctx == key->ctx && lookup->frame == key->frame &&
+                (lookup->ip != key->ip ? !same_ip : is_same_symbol_lookup(lookup, key))) {
+            *p = lookup->next;
+            free_symbol_lookup(lookup);
+            continue;
+        }
+        p = &lookup->next;
+    }
+}
+
+static void add_symbol_lookup(SymbolLookup * key, Symbol * sym, Symbol ** list, unsigned cnt) {
+    SymbolLookup * lookup = NULL;
+    unsigned i;
+
+    /* Only lookups at the latest address of a frame are kept, watch expressions are re-evaluated after every stop */
+    remove_symbol_lookups(key, 0);
+    lookup = (SymbolLookup *)loc_alloc_zero(sizeof(SymbolLookup));
+    lookup->ctx = key->ctx;
+    lookup->frame = key->frame;
+    lookup->ip = key->ip;
+    lookup->flags = key->flags;
+    lookup->scope = key->scope ? loc_strdup(key->scope) : NULL;
+    lookup->name = loc_strdup(key->name);
+    lookup->ids = (char **)loc_alloc(sizeof(char *) * cnt);
+    lookup->ids[0] = loc_strdup(symbol2id(sym));
+    lookup->cnt = 1;
+    for (i = 0; i < cnt; i++) {
+        if (list[i] == sym) continue;
+        lookup->ids[lookup->cnt++] = loc_strdup(symbol2id(list[i]));
+    }
+    lookup->next = sym_lookup_cache->list;
+    sym_lookup_cache->list = lookup;
+}
+
+static Symbol ** symbol_lookup_result(SymbolLookup * lookup) {
+    unsigned i;
+    Symbol ** list = (Symbol **)tmp_alloc(sizeof(Symbol *) * (lookup->cnt + 1));
+    for (i = 0; i < lookup->cnt; i++) {
+        if (id2symbol(lookup->ids[i], list + i) < 0) return NULL;
+    }
+    list[lookup->cnt] = NULL;
+    return list;
+}
+#endif
+
 static int identifier(int mode, Value * scope, char * name, SYM_FLAGS flags, Value * v) {
     ini_value(v);
     if (scope == NULL) {
@@ -1187,9 +1333,13 @@ static int identifier(int mode, Value * scope, char * name, SYM_FLAGS flags, Val
         Symbol * sym = NULL;
         int n = 0;
 
+        Symbol * scope_sym = NULL;
+        SymbolLookup key;
+        int cached = 0;
+
         if (scope != NULL) {
             int scope_class = 0;
-            Symbol * scope_sym = scope->sym;
+            scope_sym = scope->sym;
             if (scope->type != NULL) {
                 if (scope_sym != NULL && get_symbol_class(scope_sym, &scope_class) < 0) {
                     error(errno, "Cannot retrieve symbol class");
@@ -1198,6 +1348,24 @@ static int identifier(int mode, Value * scope, char * name, SYM_FLAGS flags, Val
                     scope_sym = scope->type;
                 }
             }
+        }
+
+        if (sym_lookup_cache != NULL && get_symbol_lookup_key(scope_sym, name, flags, &key) == 0) {
+            SymbolLookup * lookup = find_symbol_lookup(&key);
+            cached = 1;
+            if (lookup != NULL) {
+                Symbol ** list = symbol_lookup_result(lookup);
+                if (list != NULL) {
+                    int sym_class = sym2value(mode, list[0], v);
+                    if (lookup->cnt > 1) v->sym_list = list;
+                    return sym_class;
+                }
+                /* Stale symbol IDs, do the lookup again */
+                remove_symbol_lookups(&key, 1);
+            }
+        }
+
+        if (scope_sym != NULL) {
             n = find_symbol_in_scope(expression_context, expression_frame, expression_addr, scope_sym, name, &sym);
         }
         else {
@@ -1240,6 +1408,7 @@ static int identifier(int mode, Value * scope, char * name, SYM_FLAGS flags, Val
                 sym_flags = nxt_flags;
                 sym = list[i];
             }
+            if (cached) add_symbol_lookup(&key, sym, list, cnt);
             sym_class = sym2value(mode, sym, v);
             if (cnt > 1) v->sym_list = list;
             return sym_class;
@@ -3905,6 +4074,9 @@ typedef struct Expression {
     ContextAddress size;
     int type_class;
     char type[256];
+#if ENABLE_Symbols
+    SymbolLookupCache lookups;
+#endif
 } Expression;
 
 #define link_all2exp(A)  ((Expression *)((char *)(A) - offsetof(Expression, link_all)))
@@ -4396,8 +4568,15 @@ static void command_evaluate_cache_client(void * x) {
         expression_context = ctx;
         expression_frame = frame;
         expression_addr = e->addr;
+#if ENABLE_Symbols
+        /* Expressions created from symbol IDs are temporary, don't cache their lookups */
+        if (args->id[0] != 'S') sym_lookup_cache = &e->lookups;
+#endif
         if (evaluate_script(MODE_NORMAL, e->script, 0, &value) < 0) err = errno;
         else value_ok = 1;
+#if ENABLE_Symbols
+        sym_lookup_cache = NULL;
+#endif
     }
     if (!err && value.remote && value.size <= 0x10000) {
         buf = tmp_alloc_zero((size_t)value.size);
@@ -4616,7 +4795,14 @@ static void command_assign_cache_client(void * x) {
         expression_context = ctx;
         expression_frame = frame;
         expression_addr = e->addr;
+#if ENABLE_Symbols
+        /* Expressions created from symbol IDs are temporary, don't cache their lookups */
+        if (args->id[0] != 'S') sym_lookup_cache = &e->lookups;
+#endif
         if (evaluate_script(MODE_NORMAL, e->script, 0, &value) < 0) err = errno;
+#if ENABLE_Symbols
+        sym_lookup_cache = NULL;
+#endif
     }
     if (!err) {
         if (value.remote) {
@@ -4699,6 +4885,9 @@ static void command_dispose_cache_client(void * x) {
     if (e != NULL) {
         list_remove(&e->link_all);
         list_remove(&e->link_id);
+#if ENABLE_Symbols
+        free_symbol_lookup_cache(&e->lookups);
+#endif
         loc_free(e->script);
         loc_free(e);
     }
@@ -4732,6 +4921,9 @@ static void on_channel_close(Channel * c) {
         if (e->channel == c) {
             list_remove(&e->link_all);
             list_remove(&e->link_id);
+#if ENABLE_Symbols
+            free_symbol_lookup_cache(&e->lookups);
+#endif
             loc_free(e->script);
             loc_free(e);
         }
@@ -4751,6 +4943,12 @@ void add_identifier_callback(ExpressionIdentifierCallBack * callback) {
 
 #if SERVICE_Expressions
 
+#if ENABLE_Symbols
+static void flush_symbol_lookups(Context * ctx, void * args) {
+    sym_lookup_generation++;
+}
+#endif
+
 #if ENABLE_FuncCallInjection
 static void context_intercepted(Context * ctx, void * args) {
     LINK * l = func_call_state.next;
@@ -4775,10 +4973,36 @@ void ini_expressions_service(Protocol * proto) {
         unsigned i;
 #if ENABLE_FuncCallInjection
         static RunControlEventListener rc_listener = { context_intercepted, NULL };
+#endif
+#if ENABLE_Symbols
+        static ContextEventListener ctx_listener = {
+            NULL,
+            flush_symbol_lookups,
+            NULL,
+            NULL,
+            flush_symbol_lookups,
+            flush_symbol_lookups
+        };
+#if SERVICE_MemoryMap
+        static MemoryMapEventListener map_listener = {
+            flush_symbol_lookups,
+            NULL,
+            flush_symbol_lookups,
+            flush_symbol_lookups,
+        };
+#endif
+#endif
+#if ENABLE_FuncCallInjection
         add_run_control_event_listener(&rc_listener, NULL);
 #endif
 #if ENABLE_ExpressionSerialization
         list_init(&cmd_queue);
+#endif
+#if ENABLE_Symbols
+        add_context_event_listener(&ctx_listener, NULL);
+#if SERVICE_MemoryMap
+        add_memory_map_event_listener(&map_listener, NULL);
+#endif
 #endif
         for (i = 0; i < ID2EXP_HASH_SIZE; i++) list_init(id2exp + i);
         add_channel_close_listener(on_channel_close);
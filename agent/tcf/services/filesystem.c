@@ -41,6 +41,11 @@
 #if defined(_WRS_KERNEL)
 #  include <ioLib.h>
 #endif
+#if defined(__linux__)
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+#  include <linux/fs.h>
+#endif
 #include <tcf/framework/mdep-fs.h>
 #include <tcf/framework/myalloc.h>
 #include <tcf/framework/asyncreq.h>
@@ -52,10 +57,26 @@
 #include <tcf/framework/exceptions.h>
 #include <tcf/framework/protocol.h>
 #include <tcf/services/filesystem.h>
+#if SERVICE_Streams
+#  include <tcf/services/streamsservice.h>
+#endif
 
 #define BUF_SIZE (128 * MEM_USAGE_FACTOR)
 #define DIR_BUF_SIZE 64
 
+#if SERVICE_Streams && !defined(_WIN32) && !defined(__CYGWIN__) && !defined(_WRS_KERNEL)
+#  define ENABLE_FileSystemTree 1
+#else
+#  define ENABLE_FileSystemTree 0
+#endif
+
+/* Minimal size of a data block that is transferred without copying */
+#define ZERO_COPY_MIN 0x10000
+/* Larger reads are done by the worker thread, not to stall the dispatch thread */
+#define ZERO_COPY_MAX 0x100000
+/* Max size of write buffer preallocation, the peer declared size is not trusted */
+#define WRITE_PREALLOC_MAX (64 * BUF_SIZE)
+
 static const char * FILE_SYSTEM = "FileSystem";
 
 static const int
@@ -67,6 +88,8 @@ static const int
 typedef struct OpenFileInfo OpenFileInfo;
 typedef struct IORequest IORequest;
 typedef struct FileAttrs FileAttrs;
+typedef struct TreeTransfer TreeTransfer;
+typedef struct DiffBlocks DiffBlocks;
 
 struct FileAttrs {
     int flags;
@@ -92,6 +115,7 @@ struct OpenFileInfo {
     LINK link_hash;
     LINK link_reqs;
     IORequest * posted_req;
+    TreeTransfer * tree;
 };
 
 struct IORequest {
@@ -111,6 +135,13 @@ static unsigned long handle_cnt = 0;
 static LINK handle_hash[HANDLE_HASH_SIZE];
 static LINK file_info_ring = TCF_LIST_INIT(file_info_ring);
 
+static void free_diff_blocks(DiffBlocks * d);
+static void reply_diff_blocks(char * token, OutputStream * out, int err, DiffBlocks * d);
+#if ENABLE_FileSystemTree
+static void abandon_tree(TreeTransfer * t);
+static void close_tree(char * token, OpenFileInfo * h);
+#endif
+
 static OpenFileInfo * create_open_file_info(Channel * ch, char * path, int file, DIR * dir) {
     LINK * list_head = NULL;
 
@@ -177,6 +208,9 @@ static void free_io_req(IORequest * req) {
         loc_free(req->info.u.fio.file_name);
         loc_free(req->info.u.fio.bufp);
         break;
+    case AsyncReqUser:
+        free_diff_blocks((DiffBlocks *)req->info.u.user.data);
+        break;
     case AsyncReqOpenDir:
     case AsyncReqReadDir:
     case AsyncReqCloseDir:
@@ -235,6 +269,9 @@ static void channel_close_listener(Channel * c) {
                 if (h->file >= 0) close(h->file);
                 if (h->dir != NULL) closedir(h->dir);
             }
+#if ENABLE_FileSystemTree
+            if (h->tree != NULL) abandon_tree(h->tree);
+#endif
             list_add_last(&h->link_hash, &list);
         }
     }
@@ -1009,6 +1046,11 @@ static void done_io_request(void * arg) {
         delete_open_file_info(handle);
         free_io_req(req);
         return;
+    case AsyncReqUser:
+        reply_diff_blocks(req->token, handle->out, err, (DiffBlocks *)req->info.u.user.data);
+        delete_open_file_info(handle);
+        free_io_req(req);
+        return;
     default:
         assert(0);
     }
@@ -1049,6 +1091,11 @@ static void command_close(char * token, Channel * c) {
     if (h == NULL) {
         reply_close(token, &c->out, EBADF);
     }
+#if ENABLE_FileSystemTree
+    else if (h->tree != NULL) {
+        close_tree(token, h);
+    }
+#endif
     else {
         if (h->dir != NULL){
             IORequest * req = create_io_request(token, h, AsyncReqCloseDir);
@@ -1062,6 +1109,68 @@ static void command_close(char * token, Channel * c) {
     }
 }
 
+#if ENABLE_Splice
+static int reply_read_splice(char * token, OutputStream * out, OpenFileInfo * h, int64_t offset, unsigned long len) {
+    /* Send file data directly from the file descriptor into the channel, returns -1 if not possible */
+    struct stat st;
+    int64_t pos = offset;
+    size_t size = len;
+    int err = 0;
+
+    if (!out->supports_zero_copy || len < ZERO_COPY_MIN || len > ZERO_COPY_MAX) return -1;
+    /* Keep replies in order: only when there are no pending requests for the file */
+    if (h->dir != NULL || h->posted_req != NULL || !list_is_empty(&h->link_reqs)) return -1;
+    if ((fcntl(h->file, F_GETFL) & O_ACCMODE) == O_WRONLY) return -1;
+    if (fstat(h->file, &st) < 0 || !S_ISREG(st.st_mode)) return -1;
+    /* Pseudo files (procfs, sysfs) don't report the real data size */
+    if (st.st_size <= 0 || st.st_blocks == 0) return -1;
+    if (pos < 0) {
+        off_t cur = lseek(h->file, 0, SEEK_CUR);
+        if (cur < 0) return -1;
+        pos = cur;
+    }
+    /* The size must be known in advance, it is sent before the data */
+    if (pos >= (int64_t)st.st_size) size = 0;
+    else if ((int64_t)size > (int64_t)st.st_size - pos) size = (size_t)(st.st_size - pos);
+
+    write_stringz(out, "R");
+    write_stringz(out, token);
+    if (size == 0) {
+        json_write_binary(out, NULL, 0);
+    }
+    else {
+        size_t done = 0;
+        write_stream(out, '(');
+        json_write_ulong(out, size);
+        write_stream(out, ')');
+        while (done < size) {
+            size_t n = size - done < BUF_SIZE ? size - done : BUF_SIZE;
+            ssize_t rd = splice_block_stream(out, h->file, n, offset >= 0 ? &pos : NULL);
+            if (rd <= 0) {
+                err = rd < 0 ? errno : ERR_EOF;
+                break;
+            }
+            done += rd;
+        }
+        if (done < size) {
+            /* The file was truncated: the size is already sent, pad the data with zeros */
+            static const char zeros[0x100];
+            while (done < size) {
+                size_t n = size - done < sizeof(zeros) ? size - done : sizeof(zeros);
+                write_block_stream(out, zeros, n);
+                done += n;
+            }
+        }
+    }
+    write_stream(out, 0);
+    write_fs_errno(out, err);
+    json_write_boolean(out, size < len);
+    write_stream(out, 0);
+    write_stream(out, MARKER_EOM);
+    return 0;
+}
+#endif
+
 static void command_read(char * token, Channel * c) {
     char id[256];
     OpenFileInfo * h;
@@ -1080,6 +1189,11 @@ static void command_read(char * token, Channel * c) {
     if (h == NULL) {
         reply_read(token, &c->out, EBADF, NULL, 0, 0);
     }
+#if ENABLE_Splice
+    else if (reply_read_splice(token, &c->out, h, offset, len) == 0) {
+        /* Data is already sent */
+    }
+#endif
     else {
         IORequest * req = create_io_request(token, h, AsyncReqRead);
         if (offset >= 0) {
@@ -1111,6 +1225,12 @@ static void command_write(char * token, Channel * c) {
     json_read_binary_start(&state, &c->inp);
 
     h = find_open_file_info(id);
+    if (buf_size < state.size_start + BUF_SIZE && buf_size < WRITE_PREALLOC_MAX) {
+        /* Binary data size is known in advance, read it without reallocation */
+        buf_size = state.size_start + BUF_SIZE;
+        if (buf_size > WRITE_PREALLOC_MAX) buf_size = WRITE_PREALLOC_MAX;
+        buf = (char *)loc_realloc(buf, buf_size);
+    }
     for (;;) {
         size_t rd;
         if (buf_size < len + BUF_SIZE) {
@@ -1135,9 +1255,17 @@ static void command_write(char * token, Channel * c) {
             req->info.u.fio.offset = offset;
         }
         req->info.u.fio.fd = h->file;
-        req->info.u.fio.bufp = loc_alloc(len);
+        if (len >= ZERO_COPY_MIN) {
+            /* Large block: pass the buffer to the request instead of copying */
+            req->info.u.fio.bufp = buf;
+            buf_size = 0;
+            buf = NULL;
+        }
+        else {
+            req->info.u.fio.bufp = loc_alloc(len);
+            memcpy(req->info.u.fio.bufp, buf, len);
+        }
         req->info.u.fio.bufsz = len;
-        memcpy(req->info.u.fio.bufp, buf, len);
         post_io_request(h);
     }
 }
@@ -1488,75 +1616,280 @@ static void command_symlink(char * token, Channel * c) {
     write_stream(&c->out, MARKER_EOM);
 }
 
-static void command_copy(char * token, Channel * c) {
+/*
+ * File copy is done by worker threads.
+ * Large files are split into chunks that are copied in parallel, and a progress event is sent for every chunk.
+ * On Linux, the copy is done by the kernel: FICLONE shares file blocks when the file system supports it,
+ * otherwise copy_file_range() copies data extents, and holes are skipped using SEEK_DATA/SEEK_HOLE.
+ */
+
+#define COPY_CHUNK_SIZE  0x4000000
+#define COPY_MAX_WORKERS 4
+
+typedef struct CopyJob CopyJob;
+
+typedef struct CopyChunk {
+    AsyncReqInfo req;
+    CopyJob * job;
+    int64_t pos;
+    int64_t size;
+} CopyChunk;
+
+struct CopyJob {
+    Channel * channel;
+    char token[256];
     char src[FILE_PATH_SIZE];
     char dst[FILE_PATH_SIZE];
     int copy_uidgid;
     int copy_perms;
     struct stat st;
-    int fi = -1;
-    int fo = -1;
-    int err = 0;
-    int64_t pos = 0;
+    int fi;
+    int fo;
+    int cloned;
+    int err;
+    AsyncReqInfo req;
+    CopyChunk chunks[COPY_MAX_WORKERS];
+    unsigned chunks_posted;
+    int64_t next_pos;
+    int64_t done_size;
+};
 
-    read_path(&c->inp, src, sizeof(src));
-    json_test_char(&c->inp, MARKER_EOA);
-    read_path(&c->inp, dst, sizeof(dst));
-    json_test_char(&c->inp, MARKER_EOA);
-    copy_uidgid = json_read_boolean(&c->inp);
-    json_test_char(&c->inp, MARKER_EOA);
-    copy_perms = json_read_boolean(&c->inp);
-    json_test_char(&c->inp, MARKER_EOA);
-    json_test_char(&c->inp, MARKER_EOM);
+static int copy_open(void * x) {
+    CopyJob * job = (CopyJob *)x;
+    int dst_reg = 1;
 
-    if (stat(src, &st) < 0) err = errno;
-    if (err == 0 && (fi = open(src, O_RDONLY | O_BINARY, 0)) < 0) err = errno;
-    if (err == 0 && (fo = open(dst, O_WRONLY | O_BINARY | O_CREAT, 0775)) < 0) err = errno;
+    if ((job->fi = open(job->src, O_RDONLY | O_BINARY, 0)) < 0) return -1;
+    if (fstat(job->fi, &job->st) < 0) return -1;
+#if !defined(_WIN32) && !defined(_WRS_KERNEL)
+    if ((job->fo = open(job->dst, O_WRONLY | O_BINARY | O_CREAT, 0775)) < 0) return -1;
+    {
+        /* Truncating the destination would destroy the source if both are the same file */
+        struct stat st;
+        if (fstat(job->fo, &st) < 0) return -1;
+        if (st.st_dev == job->st.st_dev && st.st_ino == job->st.st_ino) {
+            errno = EINVAL;
+            return -1;
+        }
+        dst_reg = S_ISREG(st.st_mode);
+        if (dst_reg && ftruncate(job->fo, 0) < 0) return -1;
+    }
+#else
+    if ((job->fo = open(job->dst, O_WRONLY | O_BINARY | O_CREAT | O_TRUNC, 0775)) < 0) return -1;
+#endif
+#if defined(FICLONE)
+    if (S_ISREG(job->st.st_mode) && ioctl(job->fo, FICLONE, job->fi) == 0) {
+        job->cloned = 1;
+        return 0;
+    }
+#endif
+#if !defined(_WIN32) && !defined(_WRS_KERNEL)
+    /* Set the file size first: chunks are written in parallel, and holes are not written at all */
+    if (S_ISREG(job->st.st_mode) && dst_reg && ftruncate(job->fo, job->st.st_size) < 0) return -1;
+#endif
+    return 0;
+}
 
-    while (err == 0 && pos < st.st_size) {
+static int copy_data(CopyJob * job, int64_t pos, int64_t size) {
+#if defined(__NR_copy_file_range)
+    while (size > 0) {
+        loff_t off_inp = pos;
+        loff_t off_out = pos;
+        ssize_t n = syscall(__NR_copy_file_range, job->fi, &off_inp, job->fo, &off_out, (size_t)size, 0);
+        if (n < 0) {
+            if (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP) break;
+            return -1;
+        }
+        if (n == 0) return 0;
+        pos += n;
+        size -= n;
+    }
+#endif
+    while (size > 0) {
         char buf[BUF_SIZE];
-        ssize_t wr;
-        ssize_t rd = read(fi, buf, sizeof(buf));
+        ssize_t rd = 0;
+        ssize_t wr = 0;
+        size_t n = size < (int64_t)sizeof(buf) ? (size_t)size : sizeof(buf);
+#if !defined(_WIN32) && !defined(_WRS_KERNEL)
+        rd = pread(job->fi, buf, n, (off_t)pos);
+        if (rd > 0) wr = pwrite(job->fo, buf, rd, (off_t)pos);
+#else
+        /* Only one chunk is used when pread() is not available */
+        rd = read(job->fi, buf, n);
+        if (rd > 0) wr = write(job->fo, buf, rd);
+#endif
         if (rd == 0) break;
-        if (rd < 0) {
-            err = errno;
-            break;
-        }
-        wr = write(fo, buf, rd);
-        if (wr < 0) {
-            err = errno;
-            break;
-        }
+        if (rd < 0 || wr < 0) return -1;
         if (wr < rd) {
-            err = ENOSPC;
-            break;
+            errno = ENOSPC;
+            return -1;
         }
         pos += rd;
+        size -= rd;
     }
+    return 0;
+}
+
+static int copy_chunk(void * x) {
+    CopyChunk * chunk = (CopyChunk *)x;
+    int64_t pos = chunk->pos;
+    int64_t end = chunk->pos + chunk->size;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    while (pos < end) {
+        off_t data = lseek(chunk->job->fi, (off_t)pos, SEEK_DATA);
+        off_t hole = 0;
+        if (data < 0) {
+            /* ENXIO: no more data, the rest of the file is a hole */
+            if (errno == ENXIO) return 0;
+            break;
+        }
+        if (data >= end) return 0;
+        hole = lseek(chunk->job->fi, data, SEEK_HOLE);
+        if (hole < 0 || hole > end) hole = (off_t)end;
+        if (copy_data(chunk->job, data, hole - data) < 0) return -1;
+        pos = hole;
+    }
+#endif
+    if (pos < end) return copy_data(chunk->job, pos, end - pos);
+    return 0;
+}
+
+static int copy_close(void * x) {
+    CopyJob * job = (CopyJob *)x;
+    int err = job->err;
 
-    if (fo >= 0 && close(fo) < 0 && err == 0) err = errno;
-    if (fi >= 0 && close(fi) < 0 && err == 0) err = errno;
+    if (job->fo >= 0 && close(job->fo) < 0 && err == 0) err = errno;
+    if (job->fi >= 0 && close(job->fi) < 0 && err == 0) err = errno;
+    job->fo = job->fi = -1;
 
     if (err == 0) {
         struct utimbuf buf;
-        buf.actime = st.st_atime;
-        buf.modtime = st.st_mtime;
-        if (utime(dst, &buf) < 0) err = errno;
+        buf.actime = job->st.st_atime;
+        buf.modtime = job->st.st_mtime;
+        if (utime(job->dst, &buf) < 0) err = errno;
     }
-    if (err == 0 && copy_perms && chmod(dst, st.st_mode) < 0) err = errno;
+    if (err == 0 && job->copy_perms && chmod(job->dst, job->st.st_mode) < 0) err = errno;
 #if !defined(_WIN32) && !defined(_WRS_KERNEL)
-    if (err == 0 && copy_uidgid && chown(dst, st.st_uid, st.st_gid) < 0) err = errno;
-#else
-    /* disable "set but not used" warning */
-    (void)copy_uidgid;
+    if (err == 0 && job->copy_uidgid && chown(job->dst, job->st.st_uid, job->st.st_gid) < 0) err = errno;
 #endif
+    job->err = err;
+    return 0;
+}
 
-    write_stringz(&c->out, "R");
-    write_stringz(&c->out, token);
-    write_fs_errno(&c->out, err);
+static void copy_close_done(void * x) {
+    CopyJob * job = (CopyJob *)((AsyncReqInfo *)x)->client_data;
+    Channel * c = job->channel;
+
+    if (!is_channel_closed(c)) {
+        write_stringz(&c->out, "R");
+        write_stringz(&c->out, job->token);
+        write_fs_errno(&c->out, job->err);
+        write_stream(&c->out, MARKER_EOM);
+    }
+    channel_unlock_with_msg(c, FILE_SYSTEM);
+    loc_free(job);
+}
+
+static void copy_finish(CopyJob * job) {
+    job->req.u.user.func = copy_close;
+    job->req.done = copy_close_done;
+    async_req_post(&job->req);
+}
+
+static void copy_progress_event(CopyJob * job) {
+    Channel * c = job->channel;
+    if (is_channel_closed(c)) return;
+    write_stringz(&c->out, "E");
+    write_stringz(&c->out, FILE_SYSTEM);
+    write_stringz(&c->out, "copyProgress");
+    json_write_string(&c->out, job->token);
+    write_stream(&c->out, 0);
+    json_write_int64(&c->out, job->done_size);
+    write_stream(&c->out, 0);
+    json_write_int64(&c->out, job->st.st_size);
+    write_stream(&c->out, 0);
     write_stream(&c->out, MARKER_EOM);
 }
 
+static int copy_next_chunk(CopyJob * job, CopyChunk * chunk) {
+    if (job->err != 0 || job->next_pos >= job->st.st_size) return 0;
+    chunk->pos = job->next_pos;
+    chunk->size = job->st.st_size - job->next_pos;
+    if (chunk->size > COPY_CHUNK_SIZE) chunk->size = COPY_CHUNK_SIZE;
+    job->next_pos += chunk->size;
+    job->chunks_posted++;
+    async_req_post(&chunk->req);
+    return 1;
+}
+
+static void copy_chunk_done(void * x) {
+    CopyChunk * chunk = (CopyChunk *)((AsyncReqInfo *)x)->client_data;
+    CopyJob * job = chunk->job;
+
+    assert(job->chunks_posted > 0);
+    job->chunks_posted--;
+    if (chunk->req.error != 0 && job->err == 0) job->err = chunk->req.error;
+    job->done_size += chunk->size;
+    if (job->st.st_size > COPY_CHUNK_SIZE) copy_progress_event(job);
+    if (!copy_next_chunk(job, chunk) && job->chunks_posted == 0) copy_finish(job);
+}
+
+static void copy_open_done(void * x) {
+    CopyJob * job = (CopyJob *)((AsyncReqInfo *)x)->client_data;
+    unsigned i;
+
+    job->err = job->req.error;
+    if (job->err == 0 && !job->cloned) {
+        for (i = 0; i < COPY_MAX_WORKERS; i++) {
+            CopyChunk * chunk = job->chunks + i;
+            chunk->job = job;
+            chunk->req.type = AsyncReqUser;
+            chunk->req.done = copy_chunk_done;
+            chunk->req.client_data = chunk;
+            chunk->req.u.user.func = copy_chunk;
+            chunk->req.u.user.data = chunk;
+#if defined(_WIN32) || defined(_WRS_KERNEL)
+            /* Sequential read()/write() cannot be done in parallel */
+            if (i > 0) break;
+            job->next_pos = 0;
+            chunk->pos = 0;
+            chunk->size = job->st.st_size;
+            job->chunks_posted++;
+            async_req_post(&chunk->req);
+            break;
+#else
+            if (!copy_next_chunk(job, chunk)) break;
+#endif
+        }
+    }
+    if (job->chunks_posted == 0) copy_finish(job);
+}
+
+static void command_copy(char * token, Channel * c) {
+    CopyJob * job = (CopyJob *)loc_alloc_zero(sizeof(CopyJob));
+
+    read_path(&c->inp, job->src, sizeof(job->src));
+    json_test_char(&c->inp, MARKER_EOA);
+    read_path(&c->inp, job->dst, sizeof(job->dst));
+    json_test_char(&c->inp, MARKER_EOA);
+    job->copy_uidgid = json_read_boolean(&c->inp);
+    json_test_char(&c->inp, MARKER_EOA);
+    job->copy_perms = json_read_boolean(&c->inp);
+    json_test_char(&c->inp, MARKER_EOA);
+    json_test_char(&c->inp, MARKER_EOM);
+
+    job->channel = c;
+    job->fi = -1;
+    job->fo = -1;
+    strlcpy(job->token, token, sizeof(job->token));
+    job->req.type = AsyncReqUser;
+    job->req.done = copy_open_done;
+    job->req.client_data = job;
+    job->req.u.user.func = copy_open;
+    job->req.u.user.data = job;
+    channel_lock_with_msg(c, FILE_SYSTEM);
+    async_req_post(&job->req);
+}
+
 static void command_user(char * token, Channel * c) {
     json_test_char(&c->inp, MARKER_EOM);
     write_stringz(&c->out, "R");
@@ -1584,6 +1917,837 @@ static void command_roots(char * token, Channel * c) {
     post_io_request(h);
 }
 
+#if ENABLE_FileSystemTree
+
+/*
+ * Recursive directory transfer.
+ * A directory tree is sent or received as a tar archive (ustar with GNU long names) over a virtual stream.
+ * The archive is produced or extracted by worker threads, TREE_BUF_SIZE bytes per request.
+ * The transfer is associated with a file handle, closing the handle returns the transfer status.
+ */
+
+#define TREE_BUF_SIZE   0x10000
+#define TAR_BLOCK       512
+
+/* Archive errors detected by a worker thread, the message is created in the dispatch thread */
+#define TREE_BAD_HEADER 1
+#define TREE_BAD_NAME   2
+#define TREE_BAD_LINK   3
+
+#ifndef O_NOFOLLOW
+#  define O_NOFOLLOW 0
+#endif
+
+typedef struct TreeDir {
+    struct TreeDir * up;
+    DIR * dir;
+    size_t path_len;
+} TreeDir;
+
+struct TreeTransfer {
+    OpenFileInfo * handle;          /* NULL if the channel is closed */
+    Channel * channel;
+    VirtualStream * vstream;
+    char stream_id[256];
+    int extract;                    /* 1 - writeTree, 0 - readTree */
+    char root[FILE_PATH_SIZE];
+    AsyncReqInfo req;
+    int req_posted;
+    char * buf;
+    size_t buf_pos;
+    size_t buf_len;
+    int eos;
+    int done;
+    int cancel;
+    int error;
+    char * close_token;
+
+    /* Archive creation state */
+    TreeDir * dirs;
+    char path[FILE_PATH_SIZE];
+    char full[FILE_PATH_SIZE * 2];
+    int file;
+    uint64_t file_size;
+    uint64_t file_pos;
+    char * pend;
+    size_t pend_pos;
+    size_t pend_len;
+    size_t zeros;
+
+    /* Archive extraction state */
+    char hdr[TAR_BLOCK];
+    size_t hdr_pos;
+    int data_type;
+    uint64_t data_rem;
+    size_t data_pad;
+    char long_name[FILE_PATH_SIZE];
+    char long_link[FILE_PATH_SIZE];
+    size_t long_pos;
+    time_t file_mtime;
+    int end_of_archive;
+    int bad_entry;
+    char bad_name[FILE_PATH_SIZE];
+};
+
+static void tar_octal(char * p, size_t size, uint64_t n) {
+    /* Numeric field: octal digits terminated with NUL, base-256 if the value does not fit */
+    if (size > 1 && n >= (uint64_t)1 << (3 * (size - 1))) {
+        size_t i = size;
+        while (i > 1) {
+            p[--i] = (char)(n & 0xff);
+            n >>= 8;
+        }
+        p[0] = (char)0x80;
+        return;
+    }
+    p[--size] = 0;
+    while (size > 0) {
+        p[--size] = (char)('0' + (n & 7));
+        n >>= 3;
+    }
+}
+
+static uint64_t tar_number(const char * p, size_t size) {
+    uint64_t n = 0;
+    size_t i = 0;
+    if ((unsigned char)p[0] & 0x80) {
+        for (i = 1; i < size; i++) n = (n << 8) | (unsigned char)p[i];
+        return n;
+    }
+    while (i < size && p[i] == ' ') i++;
+    while (i < size && p[i] >= '0' && p[i] <= '7') n = (n << 3) | (unsigned)(p[i++] - '0');
+    return n;
+}
+
+static void tar_checksum(char * hdr) {
+    unsigned sum = 0;
+    unsigned i;
+    memset(hdr + 148, ' ', 8);
+    for (i = 0; i < TAR_BLOCK; i++) sum += (unsigned char)hdr[i];
+    tar_octal(hdr + 148, 7, sum);
+}
+
+static char * tar_add_block(TreeTransfer * t) {
+    t->pend = (char *)loc_realloc(t->pend, t->pend_len + TAR_BLOCK);
+    memset(t->pend + t->pend_len, 0, TAR_BLOCK);
+    t->pend_len += TAR_BLOCK;
+    return t->pend + t->pend_len - TAR_BLOCK;
+}
+
+static void tar_long_name(TreeTransfer * t, const char * name, char type) {
+    /* GNU extension: the name is stored in data blocks of a preceding pseudo-entry */
+    size_t len = strlen(name) + 1;
+    size_t pos = 0;
+    char * hdr = tar_add_block(t);
+    strcpy(hdr, "././@LongLink");
+    tar_octal(hdr + 100, 8, 0644);
+    tar_octal(hdr + 108, 8, 0);
+    tar_octal(hdr + 116, 8, 0);
+    tar_octal(hdr + 124, 12, len);
+    tar_octal(hdr + 136, 12, 0);
+    hdr[156] = type;
+    memcpy(hdr + 257, "ustar  ", 8);
+    tar_checksum(hdr);
+    while (pos < len) {
+        size_t n = len - pos < TAR_BLOCK ? len - pos : TAR_BLOCK;
+        memcpy(tar_add_block(t), name + pos, n);
+        pos += n;
+    }
+}
+
+static void tar_add_header(TreeTransfer * t, const char * name, struct stat * st, char type, const char * link) {
+    char * hdr = NULL;
+    size_t name_len = strlen(name);
+    if (name_len > 100) tar_long_name(t, name, 'L');
+    if (link != NULL && strlen(link) > 100) tar_long_name(t, link, 'K');
+    hdr = tar_add_block(t);
+    memcpy(hdr, name, name_len > 100 ? 100 : name_len);
+    tar_octal(hdr + 100, 8, st->st_mode & 07777);
+    tar_octal(hdr + 108, 8, st->st_uid);
+    tar_octal(hdr + 116, 8, st->st_gid);
+    tar_octal(hdr + 124, 12, type == '0' ? (uint64_t)st->st_size : 0);
+    tar_octal(hdr + 136, 12, (uint64_t)st->st_mtime);
+    hdr[156] = type;
+    if (link != NULL) {
+        size_t link_len = strlen(link);
+        memcpy(hdr + 157, link, link_len > 100 ? 100 : link_len);
+    }
+    memcpy(hdr + 257, "ustar  ", 8);
+    tar_checksum(hdr);
+}
+
+static int tree_next_entry(TreeTransfer * t) {
+    /* Add headers of next archive entry to the pending data, returns 0 when the whole tree is done */
+    /* Note: worker threads have small stacks, path buffers are kept in TreeTransfer */
+    char * full = t->full;
+    for (;;) {
+        TreeDir * d = t->dirs;
+        struct dirent * e = NULL;
+        struct stat st;
+        size_t len = 0;
+
+        if (d == NULL) return 0;
+        e = readdir(d->dir);
+        if (e == NULL) {
+            t->dirs = d->up;
+            closedir(d->dir);
+            loc_free(d);
+            continue;
+        }
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+        len = d->path_len + strlen(e->d_name);
+        if (len + 2 >= sizeof(t->path)) {
+            trace(LOG_ALWAYS, "readTree: path is too long: %s%s", t->path, e->d_name);
+            continue;
+        }
+        strcpy(t->path + d->path_len, e->d_name);
+        snprintf(full, sizeof(t->full), "%s/%s", t->root, t->path);
+        if (lstat(full, &st) < 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            TreeDir * n = NULL;
+            DIR * dir = opendir(full);
+            if (dir == NULL) {
+                if (t->error == 0) t->error = errno;
+                continue;
+            }
+            strcpy(t->path + len, "/");
+            tar_add_header(t, t->path, &st, '5', NULL);
+            n = (TreeDir *)loc_alloc_zero(sizeof(TreeDir));
+            n->dir = dir;
+            n->path_len = len + 1;
+            n->up = t->dirs;
+            t->dirs = n;
+            return 1;
+        }
+        if (S_ISREG(st.st_mode)) {
+            int fd = open(full, O_RDONLY | O_BINARY, 0);
+            if (fd < 0) {
+                if (t->error == 0) t->error = errno;
+                continue;
+            }
+            tar_add_header(t, t->path, &st, '0', NULL);
+            t->file = fd;
+            t->file_size = st.st_size;
+            t->file_pos = 0;
+            return 1;
+        }
+        if (S_ISLNK(st.st_mode)) {
+            char * link = t->long_link;
+            ssize_t n = readlink(full, link, sizeof(t->long_link) - 1);
+            if (n < 0) continue;
+            link[n] = 0;
+            tar_add_header(t, t->path, &st, '2', link);
+            return 1;
+        }
+        /* Special files are not transferred */
+    }
+}
+
+static int tree_produce(void * x) {
+    /* Worker thread: fill the buffer with next portion of the archive */
+    TreeTransfer * t = (TreeTransfer *)x;
+    t->buf_pos = t->buf_len = 0;
+    while (t->buf_len < TREE_BUF_SIZE && !t->eos && !t->cancel) {
+        size_t n = TREE_BUF_SIZE - t->buf_len;
+        if (t->pend_pos < t->pend_len) {
+            if (n > t->pend_len - t->pend_pos) n = t->pend_len - t->pend_pos;
+            memcpy(t->buf + t->buf_len, t->pend + t->pend_pos, n);
+            t->pend_pos += n;
+        }
+        else if (t->file >= 0) {
+            ssize_t rd = 0;
+            if (n > t->file_size - t->file_pos) n = (size_t)(t->file_size - t->file_pos);
+            if (n > 0) rd = read(t->file, t->buf + t->buf_len, n);
+            if (rd <= 0 && n > 0) {
+                /* File was truncated or cannot be read: the size is already sent, pad with zeros */
+                if (t->error == 0) t->error = rd < 0 ? errno : ERR_EOF;
+                memset(t->buf + t->buf_len, 0, n);
+                rd = n;
+            }
+            n = rd;
+            t->file_pos += n;
+            if (t->file_pos >= t->file_size) {
+                close(t->file);
+                t->file = -1;
+                t->zeros = (size_t)((TAR_BLOCK - t->file_size % TAR_BLOCK) % TAR_BLOCK);
+            }
+        }
+        else if (t->zeros > 0) {
+            if (n > t->zeros) n = t->zeros;
+            memset(t->buf + t->buf_len, 0, n);
+            t->zeros -= n;
+        }
+        else {
+            n = 0;
+            t->pend_pos = t->pend_len = 0;
+            if (!tree_next_entry(t)) {
+                if (t->done) {
+                    t->eos = 1;
+                }
+                else {
+                    /* End of archive: two zero blocks */
+                    t->zeros = TAR_BLOCK * 2;
+                    t->done = 1;
+                }
+            }
+        }
+        t->buf_len += n;
+    }
+    return 0;
+}
+
+static int tree_check_path(const char * name) {
+    /* Don't allow archive entries to escape the destination directory */
+    const char * p = name;
+    if (*p == '/' || *p == 0) return -1;
+    while (*p) {
+        if (p[0] == '.' && p[1] == '.' && (p[2] == '/' || p[2] == 0)) return -1;
+        while (*p && *p != '/') p++;
+        while (*p == '/') p++;
+    }
+    return 0;
+}
+
+static void tree_bad_entry(TreeTransfer * t, int code, const char * name) {
+    /* Worker thread: errors.c is not thread safe, only record the error here */
+    if (t->error != 0) return;
+    t->error = ERR_OTHER;
+    t->bad_entry = code;
+    strlcpy(t->bad_name, name, sizeof(t->bad_name));
+}
+
+static void tree_extract_header(TreeTransfer * t) {
+    char * name = t->long_name;
+    char * link_name = t->long_link;
+    char * full = t->full;
+    char * hdr = t->hdr;
+    char type = hdr[156];
+    unsigned mode = (unsigned)tar_number(hdr + 100, 8) & 07777;
+    uint64_t size = tar_number(hdr + 124, 12);
+    size_t i;
+    unsigned sum = 0;
+
+    for (i = 0; i < TAR_BLOCK; i++) {
+        if (hdr[i] != 0) break;
+    }
+    if (i == TAR_BLOCK) {
+        t->end_of_archive = 1;
+        return;
+    }
+    for (i = 0; i < TAR_BLOCK; i++) sum += i >= 148 && i < 156 ? ' ' : (unsigned char)hdr[i];
+    if (sum != tar_number(hdr + 148, 8)) {
+        tree_bad_entry(t, TREE_BAD_HEADER, "");
+        t->end_of_archive = 1;
+        return;
+    }
+
+    t->data_type = 0;
+    t->data_rem = size;
+    t->data_pad = (size_t)((TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK);
+    if (type == 'L' || type == 'K') {
+        /* GNU long name: the name is in the entry data */
+        t->data_type = type;
+        t->long_pos = 0;
+        return;
+    }
+
+    if (name[0] == 0) {
+        size_t n = 0;
+        if (memcmp(hdr + 257, "ustar\0", 6) == 0 && hdr[345]) {
+            /* POSIX ustar name prefix */
+            while (n < 155 && hdr[345 + n]) n++;
+            memcpy(name, hdr + 345, n);
+            name[n++] = '/';
+        }
+        i = 0;
+        while (i < 100 && hdr[i]) i++;
+        memcpy(name + n, hdr, i);
+        name[n + i] = 0;
+    }
+    if (link_name[0] == 0) {
+        i = 0;
+        while (i < 100 && hdr[157 + i]) i++;
+        memcpy(link_name, hdr + 157, i);
+        link_name[i] = 0;
+    }
+
+    while (strncmp(name, "./", 2) == 0) memmove(name, name + 2, strlen(name + 2) + 1);
+    i = strlen(name);
+    while (i > 0 && name[i - 1] == '/') name[--i] = 0;
+    if (i == 0 || strcmp(name, ".") == 0) {
+        /* Nothing to do */
+    }
+    else if (tree_check_path(name) < 0) {
+        tree_bad_entry(t, TREE_BAD_NAME, name);
+    }
+    else {
+        snprintf(full, sizeof(t->full), "%s/%s", t->root, name);
+        switch (type) {
+        case '5':
+            if (mkdir(full, mode ? mode : 0775) < 0 && errno != EEXIST && t->error == 0) t->error = errno;
+            break;
+        case '0':
+        case '7':
+        case 0:
+            t->file = open(full, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY | O_NOFOLLOW, mode ? mode : 0664);
+            if (t->file < 0) {
+                if (t->error == 0) t->error = errno;
+            }
+            else {
+                t->data_type = '0';
+                t->file_mtime = (time_t)tar_number(hdr + 136, 12);
+                strlcpy(t->path, full, sizeof(t->path));
+            }
+            break;
+        case '2':
+            /* A link target outside of the destination would let next entries escape it */
+            if (tree_check_path(link_name) < 0) {
+                tree_bad_entry(t, TREE_BAD_LINK, link_name);
+                break;
+            }
+            unlink(full);
+            if (symlink(link_name, full) < 0 && t->error == 0) t->error = errno;
+            break;
+        case '1':
+            if (tree_check_path(link_name) < 0) {
+                tree_bad_entry(t, TREE_BAD_LINK, link_name);
+                break;
+            }
+            if (strlen(t->root) + strlen(link_name) + 2 > sizeof(t->path)) {
+                if (t->error == 0) t->error = ENAMETOOLONG;
+                break;
+            }
+            strcpy(t->path, t->root);
+            strcat(t->path, "/");
+            strcat(t->path, link_name);
+            unlink(full);
+            if (link(t->path, full) < 0 && t->error == 0) t->error = errno;
+            break;
+        default:
+            /* Special files and unknown entry types are skipped */
+            break;
+        }
+    }
+    name[0] = 0;
+    link_name[0] = 0;
+}
+
+static void tree_extract_file_done(TreeTransfer * t) {
+    struct utimbuf buf;
+    if (close(t->file) < 0 && t->error == 0) t->error = errno;
+    t->file = -1;
+    buf.actime = t->file_mtime;
+    buf.modtime = t->file_mtime;
+    if (utime(t->path, &buf) < 0 && t->error == 0) t->error = errno;
+}
+
+static int tree_extract(void * x) {
+    /* Worker thread: extract the buffer contents */
+    TreeTransfer * t = (TreeTransfer *)x;
+    while (t->buf_pos < t->buf_len && !t->end_of_archive) {
+        char * p = t->buf + t->buf_pos;
+        size_t n = t->buf_len - t->buf_pos;
+        if (t->data_rem > 0) {
+            if (n > t->data_rem) n = (size_t)t->data_rem;
+            if (t->data_type == '0') {
+                size_t pos = 0;
+                while (pos < n && t->file >= 0) {
+                    ssize_t wr = write(t->file, p + pos, n - pos);
+                    if (wr <= 0) {
+                        if (t->error == 0) t->error = wr < 0 ? errno : ENOSPC;
+                        close(t->file);
+                        t->file = -1;
+                        t->data_type = 0;
+                        break;
+                    }
+                    pos += wr;
+                }
+            }
+            else if (t->data_type == 'L' || t->data_type == 'K') {
+                char * s = t->data_type == 'L' ? t->long_name : t->long_link;
+                size_t m = n;
+                if (m > FILE_PATH_SIZE - 1 - t->long_pos) m = FILE_PATH_SIZE - 1 - t->long_pos;
+                memcpy(s + t->long_pos, p, m);
+                t->long_pos += m;
+                s[t->long_pos] = 0;
+            }
+            t->data_rem -= n;
+            if (t->data_rem == 0 && t->data_type == '0') tree_extract_file_done(t);
+        }
+        else if (t->data_pad > 0) {
+            if (n > t->data_pad) n = t->data_pad;
+            t->data_pad -= n;
+        }
+        else {
+            if (n > TAR_BLOCK - t->hdr_pos) n = TAR_BLOCK - t->hdr_pos;
+            memcpy(t->hdr + t->hdr_pos, p, n);
+            t->hdr_pos += n;
+            if (t->hdr_pos == TAR_BLOCK) {
+                t->hdr_pos = 0;
+                tree_extract_header(t);
+            }
+        }
+        t->buf_pos += n;
+    }
+    t->buf_pos = t->buf_len = 0;
+    if (t->eos && !t->end_of_archive && t->error == 0) t->error = ERR_EOF;
+    return 0;
+}
+
+static void tree_free(TreeTransfer * t) {
+    assert(!t->req_posted);
+    while (t->dirs != NULL) {
+        TreeDir * d = t->dirs;
+        t->dirs = d->up;
+        closedir(d->dir);
+        loc_free(d);
+    }
+    if (t->file >= 0) close(t->file);
+    if (t->vstream != NULL) virtual_stream_delete(t->vstream);
+    channel_unlock_with_msg(t->channel, FILE_SYSTEM);
+    loc_free(t->close_token);
+    loc_free(t->pend);
+    loc_free(t->buf);
+    loc_free(t);
+}
+
+static void abandon_tree(TreeTransfer * t) {
+    /* The channel is closed, the transfer is disposed when the worker request is done */
+    t->handle = NULL;
+    t->cancel = 1;
+    if (!t->req_posted) tree_free(t);
+}
+
+static void tree_finish(TreeTransfer * t) {
+    /* Called when the transfer is complete and the handle is being closed */
+    OpenFileInfo * h = t->handle;
+    if (t->req_posted || t->close_token == NULL) return;
+    if (t->extract && !t->done) return;
+    if (h != NULL) {
+        reply_close(t->close_token, h->out, t->error);
+        h->tree = NULL;
+        delete_open_file_info(h);
+    }
+    t->handle = NULL;
+    tree_free(t);
+}
+
+static void tree_stream_callback(VirtualStream * stream, int event_code, void * args) {
+    TreeTransfer * t = (TreeTransfer *)args;
+
+    assert(t->vstream == stream);
+    if (t->req_posted || t->handle == NULL) return;
+    if (t->extract) {
+        if (!t->done) {
+            virtual_stream_get_data(stream, t->buf, TREE_BUF_SIZE, &t->buf_len, &t->eos);
+            /* The handle is closed: extract data that is already received, then stop */
+            if (t->close_token != NULL && t->buf_len == 0) t->eos = 1;
+            if (t->buf_len > 0 || t->eos) {
+                t->buf_pos = 0;
+                t->req.u.user.func = tree_extract;
+                t->req_posted = 1;
+                async_req_post(&t->req);
+            }
+        }
+    }
+    else if (!t->cancel) {
+        if (t->buf_pos < t->buf_len || t->eos) {
+            size_t done = 0;
+            virtual_stream_add_data(stream, t->buf + t->buf_pos, t->buf_len - t->buf_pos, &done, t->eos);
+            t->buf_pos += done;
+        }
+        if (t->buf_pos >= t->buf_len && !t->eos) {
+            t->req.u.user.func = tree_produce;
+            t->req_posted = 1;
+            async_req_post(&t->req);
+        }
+    }
+}
+
+static void tree_req_done(void * x) {
+    AsyncReqInfo * req = (AsyncReqInfo *)x;
+    TreeTransfer * t = (TreeTransfer *)req->client_data;
+
+    t->req_posted = 0;
+    if (t->handle == NULL) {
+        /* Channel is closed */
+        tree_free(t);
+        return;
+    }
+    switch (t->bad_entry) {
+    case TREE_BAD_HEADER:
+        t->error = set_errno(ERR_OTHER, "Invalid tar archive header");
+        break;
+    case TREE_BAD_NAME:
+        t->error = set_fmt_errno(ERR_OTHER, "Invalid archive entry name: %s", t->bad_name);
+        break;
+    case TREE_BAD_LINK:
+        t->error = set_fmt_errno(ERR_OTHER, "Invalid archive link target: %s", t->bad_name);
+        break;
+    }
+    t->bad_entry = 0;
+    if (t->extract && t->eos) {
+        if (t->file >= 0) {
+            close(t->file);
+            t->file = -1;
+        }
+        t->done = 1;
+    }
+    if (t->close_token != NULL && (!t->extract || t->done)) {
+        tree_finish(t);
+        return;
+    }
+    tree_stream_callback(t->vstream, 0, t);
+}
+
+static void reply_tree(char * token, OutputStream * out, int err, OpenFileInfo * handle, TreeTransfer * t) {
+    write_stringz(out, "R");
+    write_stringz(out, token);
+    write_fs_errno(out, err);
+    write_file_handle(out, handle);
+    if (t == NULL) {
+        write_stringz(out, "null");
+    }
+    else {
+        json_write_string(out, t->stream_id);
+        write_stream(out, 0);
+    }
+    write_stream(out, MARKER_EOM);
+}
+
+static void command_tree(char * token, Channel * c, int extract) {
+    char path[FILE_PATH_SIZE];
+    OpenFileInfo * h = NULL;
+    TreeTransfer * t = NULL;
+    DIR * dir = NULL;
+    int err = 0;
+
+    read_path(&c->inp, path, sizeof(path));
+    json_test_char(&c->inp, MARKER_EOA);
+    json_test_char(&c->inp, MARKER_EOM);
+
+    /* Note: opendir() is fast, it does not need to be done in a worker thread */
+    dir = opendir(path);
+    if (dir == NULL) err = errno;
+    if (err != 0) {
+        reply_tree(token, &c->out, err, NULL, NULL);
+        return;
+    }
+
+    t = (TreeTransfer *)loc_alloc_zero(sizeof(TreeTransfer));
+    h = create_open_file_info(c, path, -1, NULL);
+    h->tree = t;
+    t->handle = h;
+    t->channel = c;
+    t->extract = extract;
+    t->file = -1;
+    t->buf = (char *)loc_alloc(TREE_BUF_SIZE);
+    strlcpy(t->root, path, sizeof(t->root));
+    if (extract) {
+        closedir(dir);
+    }
+    else {
+        t->dirs = (TreeDir *)loc_alloc_zero(sizeof(TreeDir));
+        t->dirs->dir = dir;
+    }
+    t->req.type = AsyncReqUser;
+    t->req.done = tree_req_done;
+    t->req.client_data = t;
+    t->req.u.user.data = t;
+    channel_lock_with_msg(c, FILE_SYSTEM);
+    virtual_stream_create(FILE_SYSTEM, NULL, TREE_BUF_SIZE,
+        extract ? VS_ENABLE_REMOTE_WRITE : VS_ENABLE_REMOTE_READ,
+        tree_stream_callback, t, &t->vstream);
+    virtual_stream_get_id(t->vstream, t->stream_id, sizeof(t->stream_id));
+    virtual_stream_connect(c, NULL, t->stream_id);
+
+    reply_tree(token, &c->out, 0, h, t);
+    if (!extract) {
+        t->req.u.user.func = tree_produce;
+        t->req_posted = 1;
+        async_req_post(&t->req);
+    }
+}
+
+static void command_read_tree(char * token, Channel * c) {
+    command_tree(token, c, 0);
+}
+
+static void command_write_tree(char * token, Channel * c) {
+    command_tree(token, c, 1);
+}
+
+static void close_tree(char * token, OpenFileInfo * h) {
+    TreeTransfer * t = h->tree;
+    if (t->close_token != NULL) {
+        reply_close(token, h->out, EBADF);
+        return;
+    }
+    t->close_token = loc_strdup(token);
+    if (!t->extract && !t->eos) {
+        /* Archive is not completely sent: cancel the transfer */
+        t->cancel = 1;
+        if (t->error == 0) t->error = ECANCELED;
+    }
+    if (t->extract && !t->done) {
+        /* Process data that is already received, tree_req_done() finishes the transfer */
+        tree_stream_callback(t->vstream, 0, t);
+        return;
+    }
+    tree_finish(t);
+}
+
+#endif /* ENABLE_FileSystemTree */
+
+static uint64_t calc_block_hash(const char * buf, size_t size) {
+    /* 64-bit FNV-1a */
+    uint64_t h = 0xcbf29ce484222325ull;
+    while (size-- > 0) {
+        h ^= (unsigned char)*buf++;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+#define DIFF_BLOCK_SIZE_MAX (16 * 1024 * 1024)
+
+struct DiffBlocks {
+    char * path;
+    size_t block_size;
+    uint64_t * hashes;
+    unsigned hashes_cnt;
+    unsigned hashes_max;
+    int64_t file_size;
+    unsigned * diffs;
+    unsigned diffs_cnt;
+};
+
+static int diff_blocks_func(void * x) {
+    /* Worker thread: compare file blocks with the given hashes */
+    DiffBlocks * d = (DiffBlocks *)x;
+    struct stat st;
+    unsigned diffs_max = 0;
+    unsigned cnt = 0;
+    unsigned i;
+    char * buf = NULL;
+    int fd = -1;
+
+    if (stat(d->path, &st) < 0) return -1;
+    d->file_size = st.st_size;
+    fd = open(d->path, O_RDONLY | O_BINARY, 0);
+    if (fd < 0) return -1;
+    cnt = (unsigned)((st.st_size + d->block_size - 1) / d->block_size);
+    if (cnt < d->hashes_cnt) cnt = d->hashes_cnt;
+    buf = (char *)loc_alloc(d->block_size);
+    for (i = 0; i < cnt; i++) {
+        int diff = 1;
+        if (i < d->hashes_cnt && (int64_t)i * d->block_size < st.st_size) {
+            size_t pos = 0;
+            while (pos < d->block_size) {
+                ssize_t rd = read(fd, buf + pos, d->block_size - pos);
+                if (rd < 0) {
+                    int err = errno;
+                    loc_free(buf);
+                    close(fd);
+                    errno = err;
+                    return -1;
+                }
+                if (rd == 0) break;
+                pos += rd;
+            }
+            diff = calc_block_hash(buf, pos) != d->hashes[i];
+        }
+        if (diff) {
+            if (d->diffs_cnt >= diffs_max) {
+                diffs_max = diffs_max == 0 ? 64 : diffs_max * 2;
+                d->diffs = (unsigned *)loc_realloc(d->diffs, sizeof(unsigned) * diffs_max);
+            }
+            d->diffs[d->diffs_cnt++] = i;
+            if (i < d->hashes_cnt && lseek(fd, (off_t)(i + 1) * d->block_size, SEEK_SET) < 0) {
+                int err = errno;
+                loc_free(buf);
+                close(fd);
+                errno = err;
+                return -1;
+            }
+        }
+    }
+    loc_free(buf);
+    close(fd);
+    return 0;
+}
+
+static void free_diff_blocks(DiffBlocks * d) {
+    loc_free(d->path);
+    loc_free(d->hashes);
+    loc_free(d->diffs);
+    loc_free(d);
+}
+
+static void reply_diff_blocks(char * token, OutputStream * out, int err, DiffBlocks * d) {
+    write_stringz(out, "R");
+    write_stringz(out, token);
+    write_fs_errno(out, err);
+    if (err != 0 || d == NULL) {
+        write_stringz(out, "null");
+        write_stringz(out, "null");
+    }
+    else {
+        unsigned i;
+        json_write_int64(out, d->file_size);
+        write_stream(out, 0);
+        write_stream(out, '[');
+        for (i = 0; i < d->diffs_cnt; i++) {
+            if (i > 0) write_stream(out, ',');
+            json_write_ulong(out, d->diffs[i]);
+        }
+        write_stream(out, ']');
+        write_stream(out, 0);
+    }
+    write_stream(out, MARKER_EOM);
+}
+
+static void read_block_hash(InputStream * inp, void * args) {
+    DiffBlocks * d = (DiffBlocks *)args;
+    char str[64];
+    if (d->hashes_cnt >= d->hashes_max) {
+        d->hashes_max = d->hashes_max == 0 ? 64 : d->hashes_max * 2;
+        d->hashes = (uint64_t *)loc_realloc(d->hashes, sizeof(uint64_t) * d->hashes_max);
+    }
+    json_read_string(inp, str, sizeof(str));
+    d->hashes[d->hashes_cnt++] = strtoull(str, NULL, 16);
+}
+
+static void command_diff_blocks(char * token, Channel * c) {
+    char path[FILE_PATH_SIZE];
+    DiffBlocks * d = (DiffBlocks *)loc_alloc_zero(sizeof(DiffBlocks));
+    OpenFileInfo * handle = NULL;
+    IORequest * req = NULL;
+    unsigned long block_size = 0;
+
+    read_path(&c->inp, path, sizeof(path));
+    json_test_char(&c->inp, MARKER_EOA);
+    block_size = json_read_ulong(&c->inp);
+    json_test_char(&c->inp, MARKER_EOA);
+    json_read_array(&c->inp, read_block_hash, d);
+    json_test_char(&c->inp, MARKER_EOA);
+    json_test_char(&c->inp, MARKER_EOM);
+
+    /* The block buffer is allocated by the worker thread, don't let clients request huge blocks */
+    if (block_size == 0 || block_size > DIFF_BLOCK_SIZE_MAX) {
+        reply_diff_blocks(token, &c->out, ERR_INV_NUMBER, NULL);
+        free_diff_blocks(d);
+        return;
+    }
+    d->block_size = (size_t)block_size;
+    d->path = loc_strdup(path);
+    handle = create_open_file_info(c, path, -1, NULL);
+    req = create_io_request(token, handle, AsyncReqUser);
+    req->info.u.user.func = diff_blocks_func;
+    req->info.u.user.data = d;
+    post_io_request(handle);
+}
+
 void ini_file_system_service(Protocol * proto) {
     int i;
     static int ini_file_system = 0;
@@ -1617,6 +2781,11 @@ void ini_file_system_service(Protocol * proto) {
     add_command_handler(proto, FILE_SYSTEM, "copy", command_copy);
     add_command_handler(proto, FILE_SYSTEM, "user", command_user);
     add_command_handler(proto, FILE_SYSTEM, "roots", command_roots);
+    add_command_handler(proto, FILE_SYSTEM, "diffBlocks", command_diff_blocks);
+#if ENABLE_FileSystemTree
+    add_command_handler(proto, FILE_SYSTEM, "readTree", command_read_tree);
+    add_command_handler(proto, FILE_SYSTEM, "writeTree", command_write_tree);
+#endif
 }
 
 #endif /* SERVICE_FileSystem */
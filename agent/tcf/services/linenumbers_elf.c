@@ -316,6 +316,59 @@ int line_to_address(Context * ctx, const char * file_name, int line, int column,
     return 0;
 }
 
+static void load_line_rows(UnitAddressRange * range) {
+    CompUnit * unit = range->mUnit;
+    ContextAddress addr_end = range->mAddr + range->mSize;
+    unsigned max = 0;
+    unsigned l = 0;
+    unsigned h = unit->mStatesCnt;
+
+    range->mRowsLoaded = 1;
+    if (unit->mStatesCnt < 2) return;
+
+    /* Find first state at or after the range start */
+    while (l < h) {
+        unsigned k = (h + l) / 2;
+        LineNumbersState * state = unit->mStates + k;
+        if (state->mSection < range->mSection) l = k + 1;
+        else if (state->mSection > range->mSection) h = k;
+        else if (state->mAddress < range->mAddr) l = k + 1;
+        else h = k;
+    }
+    /* The row that covers the range start can begin before it */
+    if (l > 0) {
+        LineNumbersState * prev = unit->mStates + l - 1;
+        if (prev->mSection == range->mSection && (prev->mFlags & LINE_EndSequence) == 0) l--;
+    }
+
+    while (l < unit->mStatesCnt) {
+        LineNumbersState * state = unit->mStates + l;
+        LineNumbersState * code_next = NULL;
+        if (state->mSection != range->mSection) break;
+        if (state->mAddress >= addr_end) break;
+        code_next = get_next_in_code(unit, state);
+        if (code_next == NULL) {
+            l++;
+            continue;
+        }
+        if (state->mAddress < code_next->mAddress && code_next->mAddress > range->mAddr) {
+            LineNumbersRow * row = NULL;
+            if (range->mRowsCnt >= max) {
+                max = max == 0 ? 16 : max * 2;
+                range->mRows = (LineNumbersRow *)loc_realloc(range->mRows, sizeof(LineNumbersRow) * max);
+            }
+            row = range->mRows + range->mRowsCnt++;
+            row->mAddr = state->mAddress;
+            row->mEnd = code_next->mAddress;
+            row->mState = l;
+            row->mNext = (U4_T)(code_next - unit->mStates);
+        }
+        assert(code_next > state);
+        l = (unsigned)(code_next - unit->mStates);
+    }
+    ((DWARFCache *)unit->mFile->dwarf_dt_cache)->mCacheSize += sizeof(LineNumbersRow) * max;
+}
+
 int address_to_line(Context * ctx, ContextAddress addr0, ContextAddress addr1, LineNumbersCallBack * client, void * args) {
     Trap trap;
 
@@ -327,61 +380,29 @@ int address_to_line(Context * ctx, ContextAddress addr0, ContextAddress addr1, L
         UnitAddressRange * range = elf_find_unit(ctx, addr0, addr1 - 1, &range_rt_addr);
         if (range == NULL) break;
         if (!range->mUnit->mLineInfoLoaded) load_line_numbers(range->mUnit);
-        if (range->mUnit->mStatesCnt >= 2) {
+        if (!range->mRowsLoaded) load_line_rows(range);
+        if (range->mRowsCnt > 0) {
             CompUnit * unit = range->mUnit;
             unsigned l = 0;
-            unsigned h = unit->mStatesCnt;
+            unsigned h = range->mRowsCnt;
             ContextAddress addr_min = addr0 - range_rt_addr + range->mAddr;
             ContextAddress addr_max = addr1 - range_rt_addr + range->mAddr;
             if (addr_min < range->mAddr) addr_min = range->mAddr;
             if (addr_max > range->mAddr + range->mSize) addr_max = range->mAddr + range->mSize;
+            /* Rows don't overlap, search first row that ends after 'addr_min' */
             while (l < h) {
                 unsigned k = (h + l) / 2;
-                LineNumbersState * state = unit->mStates + k;
-                if (state->mSection > range->mSection) {
-                    h = k;
-                }
-                else if (state->mSection < range->mSection) {
-                    l = k + 1;
-                }
-                else if (state->mAddress >= addr_max) {
-                    h = k;
-                }
-                else {
-                    LineNumbersState * next = get_next_in_code(unit, state);
-                    if (next == NULL || next->mAddress <= addr_min) {
-                        l = k + 1;
-                    }
-                    else {
-                        while (k > 0) {
-                            LineNumbersState * prev = unit->mStates + k - 1;
-                            if (state->mAddress <= addr_min) break;
-                            if (prev->mAddress >= addr_max) break;
-                            state = prev;
-                            k--;
-                        }
-                        for (;;) {
-                            LineNumbersState * code_next = get_next_in_code(unit, state);
-                            if (code_next != NULL) {
-                                if (state->mAddress < code_next->mAddress) {
-                                    LineNumbersState * text_next = get_next_in_text(unit, state);
-                                    ADDR_TO_LINE_HOOK
-                                    {
-                                    call_client(ctx, unit, state, code_next, text_next, state->mAddress - range->mAddr + range_rt_addr, client, args);
-                                    }
-                                }
-                                assert(code_next > state);
-                                k = code_next - unit->mStates;
-                            }
-                            else {
-                                k++;
-                            }
-                            if (k >= unit->mStatesCnt) break;
-                            state = unit->mStates + k;
-                            if (state->mAddress >= addr_max) break;
-                        }
-                        break;
-                    }
+                if (range->mRows[k].mEnd <= addr_min) l = k + 1;
+                else h = k;
+            }
+            while (l < range->mRowsCnt && range->mRows[l].mAddr < addr_max) {
+                LineNumbersRow * row = range->mRows + l++;
+                LineNumbersState * state = unit->mStates + row->mState;
+                LineNumbersState * code_next = unit->mStates + row->mNext;
+                LineNumbersState * text_next = get_next_in_text(unit, state);
+                ADDR_TO_LINE_HOOK
+                {
+                call_client(ctx, unit, state, code_next, text_next, state->mAddress - range->mAddr + range_rt_addr, client, args);
                 }
             }
         }
@@ -22,6 +22,7 @@
 #if SERVICE_Memory
 
 #include <assert.h>
+#include <string.h>
 #include <tcf/framework/protocol.h>
 #include <tcf/framework/context.h>
 #include <tcf/framework/json.h>
@@ -32,6 +33,13 @@
 #include <tcf/framework/cache.h>
 #include <tcf/services/memoryservice.h>
 #include <tcf/services/runctrl.h>
+#if ENABLE_ELF
+#  include <tcf/services/tcf_elf.h>
+#endif
+#include <tcf/framework/events.h>
+#if SERVICE_Streams
+#  include <tcf/services/streamsservice.h>
+#endif
 
 static const char * MEMORY = "Memory";
 
@@ -46,6 +54,7 @@ static TCFBroadcastGroup * broadcast_group = NULL;
 #define CMD_GET     1
 #define CMD_SET     2
 #define CMD_FILL    3
+#define CMD_STREAM  4
 
 #define BUF_SIZE    (512 * MEM_USAGE_FACTOR)
 
@@ -350,6 +359,9 @@ static MemoryCommandArgs * read_command_args(char * token, Channel * c, int cmd)
         buf.buf = (char *)loc_alloc(buf.max = buf.size > BUF_SIZE ? BUF_SIZE : buf.size);
         json_test_char(&c->inp, MARKER_EOM);
         break;
+    case CMD_STREAM:
+        json_test_char(&c->inp, MARKER_EOM);
+        break;
     case CMD_FILL:
         json_read_array(&c->inp, read_memory_fill_array_cb, &buf);
         json_test_char(&c->inp, MARKER_EOA);
@@ -574,6 +586,191 @@ static void command_get(char * token, Channel * c) {
     cache_enter(memory_get_cache_client, c, args, sizeof(MemoryCommandArgs));
 }
 
+#if SERVICE_Streams
+
+#define STREAM_BUF_SIZE     0x10000
+#define STREAM_CHUNK_SIZE   0x4000
+#define STREAM_PAGE_SIZE    0x1000
+
+typedef struct MemoryStream {
+    LINK link;
+    Channel * channel;
+    char ctx_id[256];
+    MemoryAccessMode mode;
+    ContextAddress addr;
+    ContextAddress end;
+    VirtualStream * vstream;
+    char * buf;
+    size_t buf_pos;
+    size_t buf_len;
+    int eos;
+    int posted;
+} MemoryStream;
+
+#define link2stream(x) ((MemoryStream *)((char *)(x) - offsetof(MemoryStream, link)))
+
+static LINK memory_streams = TCF_LIST_INIT(memory_streams);
+
+static void memory_stream_callback(VirtualStream * stream, int event_code, void * args);
+
+static void memory_stream_event(void * args) {
+    MemoryStream * ms = (MemoryStream *)args;
+    assert(ms->posted);
+    ms->posted = 0;
+    memory_stream_callback(ms->vstream, 0, ms);
+}
+
+static int read_memory_stream_data(Context * ctx, MemoryStream * ms, size_t size) {
+#if ENABLE_MemoryAccessModes
+    return context_read_mem_ext(ctx, &ms->mode, ms->addr + ms->buf_len, ms->buf + ms->buf_len, size);
+#else
+    return context_read_mem(ctx, ms->addr + ms->buf_len, ms->buf + ms->buf_len, size);
+#endif
+}
+
+static void read_memory_stream_chunk(MemoryStream * ms) {
+    /* Read next chunk of memory into stream buffer, set 'eos' at the end of the range or on error */
+    Context * ctx = id2ctx(ms->ctx_id);
+    size_t rd = STREAM_CHUNK_SIZE;
+
+    ms->buf_pos = 0;
+    ms->buf_len = 0;
+    if (ms->addr >= ms->end) {
+        ms->eos = 1;
+        return;
+    }
+    if (ctx == NULL || ctx->exited) {
+        ms->eos = 1;
+        return;
+    }
+#if SERVICE_RunControl
+    if (!is_all_stopped(ctx)) {
+        /* The target has been resumed, stop streaming */
+        ms->eos = 1;
+        return;
+    }
+#endif
+    if (rd > ms->end - ms->addr) rd = (size_t)(ms->end - ms->addr);
+    while (ms->buf_len < rd) {
+        /* Read whole chunk, if it fails - read page by page up to the first unreadable page */
+        size_t n = rd - ms->buf_len;
+        if (n < rd || read_memory_stream_data(ctx, ms, n) < 0) {
+            n = STREAM_PAGE_SIZE - (size_t)((ms->addr + ms->buf_len) % STREAM_PAGE_SIZE);
+            if (n > rd - ms->buf_len) n = rd - ms->buf_len;
+            if (read_memory_stream_data(ctx, ms, n) < 0) {
+                trace(LOG_ALWAYS, "Memory stream stopped at 0x%" PRIX64 ": %s",
+                    (uint64_t)(ms->addr + ms->buf_len), errno_to_str(errno));
+                ms->eos = 1;
+                break;
+            }
+        }
+        ms->buf_len += n;
+    }
+    ms->addr += ms->buf_len;
+    if (ms->addr >= ms->end) ms->eos = 1;
+}
+
+static void memory_stream_callback(VirtualStream * stream, int event_code, void * args) {
+    MemoryStream * ms = (MemoryStream *)args;
+
+    assert(ms->vstream == stream);
+    if (ms->posted) return;
+    if (ms->buf_pos >= ms->buf_len && !ms->eos) read_memory_stream_chunk(ms);
+    if (ms->buf_pos < ms->buf_len || ms->eos) {
+        size_t done = 0;
+        virtual_stream_add_data(stream, ms->buf + ms->buf_pos, ms->buf_len - ms->buf_pos, &done, ms->eos);
+        ms->buf_pos += done;
+    }
+    if (ms->buf_pos < ms->buf_len) {
+        /* Stream buffer is full, wait for VS_EVENT_SPACE_AVAILABLE */
+        return;
+    }
+    if (!ms->eos) {
+        /* Let other events run before reading next chunk */
+        ms->posted = 1;
+        post_event(memory_stream_event, ms);
+    }
+    else {
+        /* EOS is queued, the stream object is disposed when the clients disconnect */
+        list_remove(&ms->link);
+        virtual_stream_delete(stream);
+        loc_free(ms->buf);
+        loc_free(ms);
+    }
+}
+
+static void memory_stream_cache_client(void * parm) {
+    MemoryCommandArgs * args = (MemoryCommandArgs *)parm;
+    Channel * c = cache_channel();
+    Context * ctx = NULL;
+    char id[256];
+    int err = 0;
+
+    ctx = id2ctx(args->ctx_id);
+    if (ctx == NULL) err = ERR_INV_CONTEXT;
+    else if (ctx->exited) err = ERR_ALREADY_EXITED;
+    else if (ctx->mem_access == 0) err = ERR_INV_CONTEXT;
+
+    if (err == 0) check_all_stopped(ctx);
+
+    cache_exit();
+
+    id[0] = 0;
+    if (err == 0 && !is_channel_closed(c)) {
+        MemoryStream * ms = (MemoryStream *)loc_alloc_zero(sizeof(MemoryStream));
+        ms->channel = c;
+        strlcpy(ms->ctx_id, args->ctx_id, sizeof(ms->ctx_id));
+        ms->mode = args->mode;
+        ms->addr = args->addr;
+        ms->end = args->addr + args->size;
+        if (ms->end < ms->addr) ms->end = ~(ContextAddress)0;
+        ms->buf = (char *)loc_alloc(STREAM_CHUNK_SIZE);
+        list_add_last(&ms->link, &memory_streams);
+        virtual_stream_create(MEMORY, ctx->id, STREAM_BUF_SIZE, VS_ENABLE_REMOTE_READ,
+            memory_stream_callback, ms, &ms->vstream);
+        virtual_stream_get_id(ms->vstream, id, sizeof(id));
+        virtual_stream_connect(c, NULL, id);
+        ms->posted = 1;
+        post_event(memory_stream_event, ms);
+    }
+
+    if (!is_channel_closed(c)) {
+        OutputStream * out = &c->out;
+        write_stringz(out, "R");
+        write_stringz(out, args->token);
+        write_errno(out, err);
+        if (err == 0) json_write_string(out, id);
+        else write_string(out, "null");
+        write_stream(out, 0);
+        write_stream(out, MARKER_EOM);
+    }
+}
+
+static void command_get_stream(char * token, Channel * c) {
+    MemoryCommandArgs * args = read_command_args(token, c, CMD_STREAM);
+    cache_enter(memory_stream_cache_client, c, args, sizeof(MemoryCommandArgs));
+}
+
+static void channel_close_listener(Channel * c) {
+    LINK * l = memory_streams.next;
+    while (l != &memory_streams) {
+        MemoryStream * ms = link2stream(l);
+        l = l->next;
+        if (ms->channel != c) continue;
+        /* Nobody is going to read the data, stop reading memory */
+        ms->addr = ms->end;
+        ms->buf_pos = ms->buf_len = 0;
+        ms->channel = NULL;
+        virtual_stream_drop_data(ms->vstream, virtual_stream_data_size(ms->vstream));
+        if (!ms->posted) {
+            ms->posted = 1;
+            post_event(memory_stream_event, ms);
+        }
+    }
+}
+
+#endif /* SERVICE_Streams */
+
 static void memory_fill_cache_client(void * parm) {
     MemoryCommandArgs * args = (MemoryCommandArgs *)parm;
     Channel * c = cache_channel();
@@ -650,6 +847,704 @@ static void command_fill(char * token, Channel * c) {
     cache_enter(memory_fill_cache_client, c, args, sizeof(MemoryCommandArgs));
 }
 
+#define SEARCH_CHUNK_SIZE   0x40000
+#define SEARCH_PAGE_SIZE    0x1000
+
+typedef struct SearchRange {
+    ContextAddress addr;
+    ContextAddress size;
+} SearchRange;
+
+typedef struct MemorySearchArgs {
+    char token[256];
+    char ctx_id[256];
+    SearchRange * ranges;
+    unsigned ranges_cnt;
+    unsigned ranges_max;
+    char * pattern;
+    size_t pattern_len;
+    size_t pattern_max;
+    char * mask;
+    size_t mask_len;
+    size_t mask_max;
+    unsigned align;
+    unsigned max_hits;
+} MemorySearchArgs;
+
+typedef struct MemorySearch {
+    MemorySearchArgs args;
+    Channel * channel;
+    int anchor;             /* Index of first pattern byte that is not masked, or -1 */
+    unsigned range;
+    ContextAddress pos;
+    char * buf;
+    ContextAddress * hits;
+    unsigned hits_cnt;
+    unsigned hits_max;
+    int err;
+} MemorySearch;
+
+static void read_search_range_property(InputStream * inp, const char * name, void * args) {
+    SearchRange * r = (SearchRange *)args;
+    if (strcmp(name, "Addr") == 0) r->addr = (ContextAddress)json_read_uint64(inp);
+    else if (strcmp(name, "Size") == 0) r->size = (ContextAddress)json_read_uint64(inp);
+    else json_skip_object(inp);
+}
+
+static void read_search_range(InputStream * inp, void * args) {
+    MemorySearchArgs * buf = (MemorySearchArgs *)args;
+    SearchRange * r = NULL;
+    if (buf->ranges_cnt >= buf->ranges_max) {
+        buf->ranges_max = buf->ranges_max == 0 ? 16 : buf->ranges_max * 2;
+        buf->ranges = (SearchRange *)loc_realloc(buf->ranges, sizeof(SearchRange) * buf->ranges_max);
+    }
+    r = buf->ranges + buf->ranges_cnt++;
+    memset(r, 0, sizeof(SearchRange));
+    json_read_struct(inp, read_search_range_property, r);
+}
+
+static void read_search_pattern_byte(InputStream * inp, void * args) {
+    MemorySearchArgs * buf = (MemorySearchArgs *)args;
+    if (buf->pattern_len >= buf->pattern_max) {
+        buf->pattern_max = buf->pattern_max == 0 ? 64 : buf->pattern_max * 2;
+        buf->pattern = (char *)loc_realloc(buf->pattern, buf->pattern_max);
+    }
+    buf->pattern[buf->pattern_len++] = (char)json_read_ulong(inp);
+}
+
+static void read_search_mask_byte(InputStream * inp, void * args) {
+    MemorySearchArgs * buf = (MemorySearchArgs *)args;
+    if (buf->mask_len >= buf->mask_max) {
+        buf->mask_max = buf->mask_max == 0 ? 64 : buf->mask_max * 2;
+        buf->mask = (char *)loc_realloc(buf->mask, buf->mask_max);
+    }
+    buf->mask[buf->mask_len++] = (char)json_read_ulong(inp);
+}
+
+static void free_search_args(MemorySearchArgs * args) {
+    loc_free(args->ranges);
+    loc_free(args->pattern);
+    loc_free(args->mask);
+}
+
+static void add_search_hit(MemorySearch * ms, ContextAddress addr) {
+    if (ms->hits_cnt >= ms->hits_max) {
+        ms->hits_max = ms->hits_max == 0 ? 64 : ms->hits_max * 2;
+        ms->hits = (ContextAddress *)loc_realloc(ms->hits, sizeof(ContextAddress) * ms->hits_max);
+    }
+    ms->hits[ms->hits_cnt++] = addr;
+}
+
+static int match_search_pattern(MemorySearch * ms, const char * p) {
+    size_t i;
+    MemorySearchArgs * args = &ms->args;
+    if (args->mask == NULL) return memcmp(p, args->pattern, args->pattern_len) == 0;
+    for (i = 0; i < args->pattern_len; i++) {
+        if ((p[i] ^ args->pattern[i]) & args->mask[i]) return 0;
+    }
+    return 1;
+}
+
+static void search_block(MemorySearch * ms, ContextAddress addr, size_t size, size_t limit) {
+    /* Search pattern occurrences that start in buf[0..limit) and end within buf[0..size) */
+    MemorySearchArgs * args = &ms->args;
+    const char * buf = ms->buf;
+    size_t len = args->pattern_len;
+
+    if (size < len) return;
+    if (limit > size - len + 1) limit = size - len + 1;
+    if (ms->anchor >= 0) {
+        /* memchr() is vectorized by the C library, use it to find candidates */
+        char ch = args->pattern[ms->anchor];
+        const char * p = buf + ms->anchor;
+        const char * e = buf + limit + ms->anchor;
+        while (p < e) {
+            const char * q = (const char *)memchr(p, (unsigned char)ch, e - p);
+            size_t i;
+            if (q == NULL) break;
+            i = q - buf - ms->anchor;
+            if ((addr + i) % args->align == 0 && match_search_pattern(ms, buf + i)) {
+                add_search_hit(ms, addr + i);
+                if (ms->hits_cnt >= args->max_hits) return;
+            }
+            p = q + 1;
+        }
+    }
+    else {
+        size_t i = (size_t)((args->align - addr % args->align) % args->align);
+        while (i < limit) {
+            if (match_search_pattern(ms, buf + i)) {
+                add_search_hit(ms, addr + i);
+                if (ms->hits_cnt >= args->max_hits) return;
+            }
+            i += args->align;
+        }
+    }
+}
+
+static size_t read_search_block(Context * ctx, MemorySearch * ms, ContextAddress addr, size_t size) {
+    /* Read whole block, if it fails - read page by page up to the first unreadable page */
+    size_t pos = 0;
+    if (context_read_mem(ctx, addr, ms->buf, size) == 0) return size;
+    while (pos < size) {
+        size_t n = SEARCH_PAGE_SIZE - (size_t)((addr + pos) % SEARCH_PAGE_SIZE);
+        if (n > size - pos) n = size - pos;
+        if (context_read_mem(ctx, addr + pos, ms->buf + pos, n) < 0) break;
+        pos += n;
+    }
+    return pos;
+}
+
+static void memory_search_done(MemorySearch * ms) {
+    Channel * c = ms->channel;
+
+    if (!is_channel_closed(c)) {
+        OutputStream * out = &c->out;
+        unsigned i;
+        write_stringz(out, "R");
+        write_stringz(out, ms->args.token);
+        write_errno(out, ms->err);
+        write_stream(out, '[');
+        for (i = 0; i < ms->hits_cnt; i++) {
+            if (i > 0) write_stream(out, ',');
+            json_write_uint64(out, ms->hits[i]);
+        }
+        write_stream(out, ']');
+        write_stream(out, 0);
+        write_stream(out, MARKER_EOM);
+    }
+    channel_unlock_with_msg(c, MEMORY);
+    free_search_args(&ms->args);
+    loc_free(ms->hits);
+    loc_free(ms->buf);
+    loc_free(ms);
+}
+
+static void memory_search_event(void * x) {
+    MemorySearch * ms = (MemorySearch *)x;
+    MemorySearchArgs * args = &ms->args;
+    Context * ctx = id2ctx(args->ctx_id);
+    size_t budget = SEARCH_CHUNK_SIZE;
+
+    if (ctx == NULL) ms->err = ERR_INV_CONTEXT;
+    else if (ctx->exited) ms->err = ERR_ALREADY_EXITED;
+#if SERVICE_RunControl
+    else if (!is_all_stopped(ctx)) ms->err = ERR_IS_RUNNING;
+#endif
+
+    while (ms->err == 0 && budget > 0 && ms->range < args->ranges_cnt &&
+            ms->hits_cnt < args->max_hits && !is_channel_closed(ms->channel)) {
+        SearchRange * r = args->ranges + ms->range;
+        ContextAddress addr = r->addr + ms->pos;
+        size_t n = SEARCH_CHUNK_SIZE;
+        size_t rd = 0;
+        size_t got = 0;
+        if (ms->pos >= r->size) {
+            ms->range++;
+            ms->pos = 0;
+            continue;
+        }
+        if (n > r->size - ms->pos) n = (size_t)(r->size - ms->pos);
+        /* Read extra bytes to find occurrences that cross the chunk end */
+        rd = n + args->pattern_len - 1;
+        if (rd > r->size - ms->pos) rd = (size_t)(r->size - ms->pos);
+        got = read_search_block(ctx, ms, addr, rd);
+        if (got == 0) {
+            /* Skip unreadable page, failed reads are charged to the budget too */
+            ms->pos += SEARCH_PAGE_SIZE - addr % SEARCH_PAGE_SIZE;
+            budget = budget > SEARCH_PAGE_SIZE ? budget - SEARCH_PAGE_SIZE : 0;
+            continue;
+        }
+        if (got < n) n = got;
+        search_block(ms, addr, got, n);
+        ms->pos += n;
+        budget = budget > n ? budget - n : 0;
+    }
+
+    if (ms->err == 0 && ms->range < args->ranges_cnt &&
+            ms->hits_cnt < args->max_hits && !is_channel_closed(ms->channel)) {
+        /* Let other events run before searching next chunk */
+        post_event(memory_search_event, ms);
+        return;
+    }
+    memory_search_done(ms);
+}
+
+static void clip_search_ranges(MemorySearchArgs * args, MemoryMap * map) {
+    /* Remove gaps between mapped regions from search ranges, reading unmapped pages one by one is slow */
+    SearchRange * ranges = NULL;
+    unsigned ranges_cnt = 0;
+    unsigned ranges_max = 0;
+    unsigned i, j;
+
+    for (i = 0; i < args->ranges_cnt; i++) {
+        SearchRange * r = args->ranges + i;
+        if (r->size == 0) continue;
+        for (j = 0; j < map->region_cnt; j++) {
+            MemoryRegion * m = map->regions + j;
+            ContextAddress x0 = r->addr;
+            ContextAddress x1 = r->addr + r->size - 1;
+            if (m->size == 0) continue;
+            if (x0 < m->addr) x0 = m->addr;
+            if (x1 > m->addr + m->size - 1) x1 = m->addr + m->size - 1;
+            if (x0 > x1) continue;
+            if (ranges_cnt > 0) {
+                /* Adjacent regions are merged, so patterns crossing region boundary are found */
+                SearchRange * p = ranges + ranges_cnt - 1;
+                if (p->addr + p->size == x0) {
+                    p->size += x1 - x0 + 1;
+                    continue;
+                }
+            }
+            if (ranges_cnt >= ranges_max) {
+                ranges_max = ranges_max == 0 ? 16 : ranges_max * 2;
+                ranges = (SearchRange *)loc_realloc(ranges, sizeof(SearchRange) * ranges_max);
+            }
+            ranges[ranges_cnt].addr = x0;
+            ranges[ranges_cnt].size = x1 - x0 + 1;
+            ranges_cnt++;
+        }
+    }
+    loc_free(args->ranges);
+    args->ranges = ranges;
+    args->ranges_cnt = ranges_cnt;
+    args->ranges_max = ranges_max;
+}
+
+static void memory_search_cache_client(void * parm) {
+    MemorySearchArgs * args = (MemorySearchArgs *)parm;
+    Channel * c = cache_channel();
+    Context * ctx = NULL;
+    MemoryMap map;
+    int err = 0;
+
+    memset(&map, 0, sizeof(map));
+    ctx = id2ctx(args->ctx_id);
+    if (ctx == NULL) err = ERR_INV_CONTEXT;
+    else if (ctx->exited) err = ERR_ALREADY_EXITED;
+    else if (ctx->mem_access == 0) err = ERR_INV_CONTEXT;
+    else if (args->pattern_len == 0) err = set_errno(ERR_INV_DATA_SIZE, "Empty search pattern");
+    else if (args->mask != NULL && args->mask_len != args->pattern_len) err = set_errno(ERR_INV_DATA_SIZE, "Invalid search mask size");
+
+    if (err == 0) check_all_stopped(ctx);
+
+    if (err == 0 && args->ranges_cnt == 0) {
+        /* Search all readable regions of the context memory map */
+        if (context_get_memory_map(ctx, &map) < 0) {
+            err = errno;
+        }
+        else {
+            unsigned i;
+            for (i = 0; i < map.region_cnt; i++) {
+                MemoryRegion * m = map.regions + i;
+                SearchRange * r = NULL;
+                if ((m->flags & MM_FLAG_R) == 0 || m->size == 0) continue;
+                if (i > 0 && args->ranges_cnt > 0) {
+                    /* File mappings can be split into several regions, merge adjacent ones */
+                    r = args->ranges + args->ranges_cnt - 1;
+                    if (r->addr + r->size == m->addr) {
+                        r->size += m->size;
+                        continue;
+                    }
+                }
+                if (args->ranges_cnt >= args->ranges_max) {
+                    args->ranges_max = args->ranges_max == 0 ? 16 : args->ranges_max * 2;
+                    args->ranges = (SearchRange *)loc_realloc(args->ranges, sizeof(SearchRange) * args->ranges_max);
+                }
+                r = args->ranges + args->ranges_cnt++;
+                r->addr = m->addr;
+                r->size = m->size;
+            }
+        }
+        context_clear_memory_map(&map);
+        loc_free(map.regions);
+    }
+    else if (err == 0) {
+        /* The memory map is optional here, the ranges are searched as is if it is not available */
+        if (context_get_memory_map(ctx, &map) == 0 && map.region_cnt > 0) clip_search_ranges(args, &map);
+        context_clear_memory_map(&map);
+        loc_free(map.regions);
+    }
+
+    cache_exit();
+
+    if (err == 0 && !is_channel_closed(c)) {
+        MemorySearch * ms = (MemorySearch *)loc_alloc_zero(sizeof(MemorySearch));
+        size_t i;
+        ms->args = *args;
+        ms->channel = c;
+        ms->anchor = -1;
+        if (ms->args.align == 0) ms->args.align = 1;
+        if (ms->args.max_hits == 0) ms->args.max_hits = ~0u;
+        for (i = 0; i < args->pattern_len; i++) {
+            if (args->mask == NULL || (unsigned char)args->mask[i] == 0xff) {
+                ms->anchor = (int)i;
+                break;
+            }
+        }
+        ms->buf = (char *)loc_alloc(SEARCH_CHUNK_SIZE + args->pattern_len);
+        channel_lock_with_msg(c, MEMORY);
+        post_event(memory_search_event, ms);
+        return;
+    }
+
+    if (!is_channel_closed(c)) {
+        OutputStream * out = &c->out;
+        write_stringz(out, "R");
+        write_stringz(out, args->token);
+        write_errno(out, err);
+        write_stringz(out, "null");
+        write_stream(out, MARKER_EOM);
+    }
+    free_search_args(args);
+}
+
+static void command_search(char * token, Channel * c) {
+    static MemorySearchArgs args;
+
+    memset(&args, 0, sizeof(args));
+    json_read_string(&c->inp, args.ctx_id, sizeof(args.ctx_id));
+    json_test_char(&c->inp, MARKER_EOA);
+    json_read_array(&c->inp, read_search_range, &args);
+    json_test_char(&c->inp, MARKER_EOA);
+    json_read_array(&c->inp, read_search_pattern_byte, &args);
+    json_test_char(&c->inp, MARKER_EOA);
+    if (json_read_array(&c->inp, read_search_mask_byte, &args) && args.mask == NULL) {
+        args.mask = (char *)loc_alloc(1);
+    }
+    json_test_char(&c->inp, MARKER_EOA);
+    args.align = (unsigned)json_read_ulong(&c->inp);
+    json_test_char(&c->inp, MARKER_EOA);
+    args.max_hits = (unsigned)json_read_ulong(&c->inp);
+    json_test_char(&c->inp, MARKER_EOA);
+    json_test_char(&c->inp, MARKER_EOM);
+
+    strlcpy(args.token, token, sizeof(args.token));
+    cache_enter(memory_search_cache_client, c, &args, sizeof(MemorySearchArgs));
+}
+
+#define HASH_BUF_SIZE   0x10000
+#define HASH_CHUNK_SIZE 0x40000
+#define HASH_BLOCKS_MAX 0x100000
+
+typedef struct MemoryHashArgs {
+    char token[256];
+    char ctx_id[256];
+    ContextAddress addr;
+    ContextAddress size;
+    ContextAddress block_size;
+    /* Memory.compare reference data: another memory range or ELF file contents */
+    char ref_ctx_id[256];
+    char * ref_file;
+    ContextAddress ref_addr;
+} MemoryHashArgs;
+
+static uint32_t crc32c_table[256];
+
+static uint32_t calc_crc32c(uint32_t crc, const char * buf, size_t size) {
+    if (crc32c_table[1] == 0) {
+        unsigned i, j;
+        for (i = 0; i < 256; i++) {
+            uint32_t r = i;
+            for (j = 0; j < 8; j++) r = (r >> 1) ^ (0x82f63b78u & (0u - (r & 1)));
+            crc32c_table[i] = r;
+        }
+    }
+    crc = ~crc;
+    while (size-- > 0) crc = crc32c_table[(crc ^ (unsigned char)*buf++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void read_memory_hash_ref(InputStream * inp, const char * name, void * x) {
+    MemoryHashArgs * args = (MemoryHashArgs *)x;
+    if (strcmp(name, "Context") == 0) json_read_string(inp, args->ref_ctx_id, sizeof(args->ref_ctx_id));
+    else if (strcmp(name, "File") == 0) args->ref_file = json_read_alloc_string(inp);
+    else if (strcmp(name, "Addr") == 0) args->ref_addr = (ContextAddress)json_read_uint64(inp);
+    else json_skip_object(inp);
+}
+
+static Context * get_memory_hash_context(const char * id, int * err) {
+    Context * ctx = id2ctx(id);
+    if (ctx == NULL) *err = ERR_INV_CONTEXT;
+    else if (ctx->exited) *err = ERR_ALREADY_EXITED;
+    else if (ctx->mem_access == 0) *err = ERR_INV_CONTEXT;
+    else return ctx;
+    return NULL;
+}
+
+static void write_memory_hash_reply_header(OutputStream * out, MemoryHashArgs * args, int err) {
+    write_stringz(out, "R");
+    write_stringz(out, args->token);
+    write_errno(out, err);
+}
+
+#if ENABLE_ELF
+static int read_elf_file_data(ELF_File * file, ContextAddress addr, char * buf, size_t size, char * valid) {
+    /* Copy bytes of loadable sections of the file, mark bytes that have no file data as not valid */
+    unsigned i;
+    memset(valid, 0, size);
+    for (i = 1; i < file->section_cnt; i++) {
+        ELF_Section * sec = file->sections + i;
+        ContextAddress x, y;
+        if (sec->size == 0) continue;
+        if ((sec->flags & SHF_ALLOC) == 0 || sec->type == SHT_NOBITS) continue;
+        if (sec->addr >= addr + size || sec->addr + sec->size <= addr) continue;
+        if (elf_load(sec) < 0) return -1;
+        x = sec->addr > addr ? (ContextAddress)sec->addr : addr;
+        y = sec->addr + sec->size < addr + size ? (ContextAddress)(sec->addr + sec->size) : addr + size;
+        memcpy(buf + (x - addr), (char *)sec->data + (x - sec->addr), (size_t)(y - x));
+        memset(valid + (x - addr), 1, (size_t)(y - x));
+    }
+    return 0;
+}
+#endif
+
+typedef struct MemoryHash {
+    MemoryHashArgs args;
+    Channel * channel;
+    int compare;
+    ContextAddress pos;
+    char * buf;
+    char * ref;
+    char * valid;
+    uint32_t * hashes;
+    unsigned hashes_cnt;
+    ContextAddress * diffs;
+    unsigned diffs_cnt;
+    unsigned diffs_max;
+    int err;
+} MemoryHash;
+
+static void write_memory_hash_results(OutputStream * out, MemoryHash * mh) {
+    MemoryHashArgs * args = &mh->args;
+    unsigned i;
+    write_stream(out, '[');
+    if (mh->compare) {
+        for (i = 0; i < mh->diffs_cnt; i++) {
+            ContextAddress size = args->block_size;
+            if (mh->diffs[i] + size > args->addr + args->size) size = args->addr + args->size - mh->diffs[i];
+            if (i > 0) write_stream(out, ',');
+            write_stream(out, '{');
+            json_write_string(out, "Addr");
+            write_stream(out, ':');
+            json_write_uint64(out, mh->diffs[i]);
+            write_stream(out, ',');
+            json_write_string(out, "Size");
+            write_stream(out, ':');
+            json_write_uint64(out, size);
+            write_stream(out, '}');
+        }
+    }
+    else {
+        for (i = 0; i < mh->hashes_cnt; i++) {
+            if (i > 0) write_stream(out, ',');
+            json_write_ulong(out, mh->hashes[i]);
+        }
+    }
+    write_stream(out, ']');
+    write_stream(out, 0);
+}
+
+static void memory_hash_done(MemoryHash * mh) {
+    Channel * c = mh->channel;
+
+    if (!is_channel_closed(c)) {
+        OutputStream * out = &c->out;
+        write_memory_hash_reply_header(out, &mh->args, mh->err);
+        if (mh->err != 0) write_stringz(out, "null");
+        else write_memory_hash_results(out, mh);
+        write_stream(out, MARKER_EOM);
+    }
+    channel_unlock_with_msg(c, MEMORY);
+    loc_free(mh->args.ref_file);
+    loc_free(mh->buf);
+    loc_free(mh->ref);
+    loc_free(mh->valid);
+    loc_free(mh->hashes);
+    loc_free(mh->diffs);
+    loc_free(mh);
+}
+
+static void memory_hash_block(MemoryHash * mh, Context * ctx, Context * ref_ctx, void * file, size_t n) {
+    /* Checksum or compare n bytes at mh->pos, the bytes belong to a single block */
+    MemoryHashArgs * args = &mh->args;
+    ContextAddress block_end = (mh->pos / args->block_size + 1) * args->block_size;
+    int diff = 0;
+
+    if (context_read_mem(ctx, args->addr + mh->pos, mh->buf, n) < 0) {
+        mh->err = errno;
+        return;
+    }
+    if (!mh->compare) {
+        unsigned i = (unsigned)(mh->pos / args->block_size);
+        mh->hashes[i] = calc_crc32c(mh->hashes[i], mh->buf, n);
+        mh->pos += n;
+        return;
+    }
+#if ENABLE_ELF
+    if (file != NULL) {
+        size_t i;
+        if (read_elf_file_data((ELF_File *)file, args->ref_addr + mh->pos, mh->ref, n, mh->valid) < 0) {
+            mh->err = errno;
+            return;
+        }
+        for (i = 0; i < n && !diff; i++) {
+            diff = mh->valid[i] && mh->buf[i] != mh->ref[i];
+        }
+    }
+    else
+#endif
+    {
+        if (context_read_mem(ref_ctx, args->ref_addr + mh->pos, mh->ref, n) < 0) {
+            mh->err = errno;
+            return;
+        }
+        diff = memcmp(mh->buf, mh->ref, n) != 0;
+    }
+    if (diff) {
+        /* Report the block once, then skip the rest of it */
+        if (mh->diffs_cnt >= mh->diffs_max) {
+            mh->diffs_max = mh->diffs_max == 0 ? 16 : mh->diffs_max * 2;
+            mh->diffs = (ContextAddress *)loc_realloc(mh->diffs, sizeof(ContextAddress) * mh->diffs_max);
+        }
+        mh->diffs[mh->diffs_cnt++] = args->addr + block_end - args->block_size;
+        mh->pos = block_end;
+        return;
+    }
+    mh->pos += n;
+}
+
+static void memory_hash_event(void * x) {
+    MemoryHash * mh = (MemoryHash *)x;
+    MemoryHashArgs * args = &mh->args;
+    Context * ctx = NULL;
+    Context * ref_ctx = NULL;
+    void * file = NULL;
+    size_t budget = HASH_CHUNK_SIZE;
+
+    ctx = get_memory_hash_context(args->ctx_id, &mh->err);
+    if (mh->err == 0 && mh->compare && args->ref_file == NULL) {
+        ref_ctx = args->ref_ctx_id[0] ? get_memory_hash_context(args->ref_ctx_id, &mh->err) : ctx;
+    }
+#if SERVICE_RunControl
+    if (mh->err == 0 && !is_all_stopped(ctx)) mh->err = ERR_IS_RUNNING;
+    if (mh->err == 0 && ref_ctx != NULL && !is_all_stopped(ref_ctx)) mh->err = ERR_IS_RUNNING;
+#endif
+#if ENABLE_ELF
+    /* The file is looked up every time, the ELF cache can dispose it between events */
+    if (mh->err == 0 && args->ref_file != NULL && (file = elf_open(args->ref_file)) == NULL) mh->err = errno;
+#endif
+
+    while (mh->err == 0 && budget > 0 && mh->pos < args->size && !is_channel_closed(mh->channel)) {
+        ContextAddress block_end = (mh->pos / args->block_size + 1) * args->block_size;
+        ContextAddress n = args->size - mh->pos;
+        if (n > HASH_BUF_SIZE) n = HASH_BUF_SIZE;
+        if (mh->pos + n > block_end) n = block_end - mh->pos;
+        memory_hash_block(mh, ctx, ref_ctx, file, (size_t)n);
+        budget = budget > n ? budget - (size_t)n : 0;
+    }
+
+    if (mh->err == 0 && mh->pos < args->size && !is_channel_closed(mh->channel)) {
+        /* Let other events run before processing next chunk */
+        post_event(memory_hash_event, mh);
+        return;
+    }
+    memory_hash_done(mh);
+}
+
+static void memory_hash_cache_client(MemoryHashArgs * args, int compare) {
+    Channel * c = cache_channel();
+    Context * ctx = NULL;
+    Context * ref_ctx = NULL;
+    ContextAddress blocks = 0;
+    int err = 0;
+
+    ctx = get_memory_hash_context(args->ctx_id, &err);
+    if (err == 0 && compare && args->ref_file == NULL) {
+        ref_ctx = args->ref_ctx_id[0] ? get_memory_hash_context(args->ref_ctx_id, &err) : ctx;
+    }
+    if (ctx != NULL) check_all_stopped(ctx);
+    if (ref_ctx != NULL && ref_ctx != ctx) check_all_stopped(ref_ctx);
+
+#if !ENABLE_ELF
+    if (err == 0 && args->ref_file != NULL) err = set_errno(ERR_UNSUPPORTED, "Cannot compare memory with file contents");
+#endif
+    if (args->block_size == 0 || args->block_size > args->size) args->block_size = args->size;
+    if (args->block_size > 0) blocks = args->size / args->block_size + (args->size % args->block_size != 0);
+    /* The reply lists every block, don't let a small block size make it unbounded */
+    if (err == 0 && blocks > HASH_BLOCKS_MAX) err = set_errno(ERR_INV_DATA_SIZE, "Too many memory blocks");
+
+    cache_exit();
+
+    if (err == 0 && !is_channel_closed(c)) {
+        MemoryHash * mh = (MemoryHash *)loc_alloc_zero(sizeof(MemoryHash));
+        mh->args = *args;
+        mh->channel = c;
+        mh->compare = compare;
+        mh->buf = (char *)loc_alloc(HASH_BUF_SIZE);
+        if (compare) {
+            mh->ref = (char *)loc_alloc(HASH_BUF_SIZE);
+            if (args->ref_file != NULL) mh->valid = (char *)loc_alloc(HASH_BUF_SIZE);
+        }
+        else {
+            mh->hashes_cnt = (unsigned)blocks;
+            mh->hashes = (uint32_t *)loc_alloc_zero(sizeof(uint32_t) * (blocks > 0 ? (size_t)blocks : 1));
+        }
+        channel_lock_with_msg(c, MEMORY);
+        post_event(memory_hash_event, mh);
+        return;
+    }
+
+    if (!is_channel_closed(c)) {
+        OutputStream * out = &c->out;
+        write_memory_hash_reply_header(out, args, err);
+        write_stringz(out, "null");
+        write_stream(out, MARKER_EOM);
+    }
+    loc_free(args->ref_file);
+}
+
+static void memory_checksum_cache_client(void * parm) {
+    memory_hash_cache_client((MemoryHashArgs *)parm, 0);
+}
+
+static void memory_compare_cache_client(void * parm) {
+    memory_hash_cache_client((MemoryHashArgs *)parm, 1);
+}
+
+static void read_memory_hash_args(char * token, Channel * c, MemoryHashArgs * args) {
+    memset(args, 0, sizeof(MemoryHashArgs));
+    json_read_string(&c->inp, args->ctx_id, sizeof(args->ctx_id));
+    json_test_char(&c->inp, MARKER_EOA);
+    args->addr = (ContextAddress)json_read_uint64(&c->inp);
+    json_test_char(&c->inp, MARKER_EOA);
+    args->size = (ContextAddress)json_read_uint64(&c->inp);
+    json_test_char(&c->inp, MARKER_EOA);
+    args->block_size = (ContextAddress)json_read_uint64(&c->inp);
+    json_test_char(&c->inp, MARKER_EOA);
+    strlcpy(args->token, token, sizeof(args->token));
+}
+
+static void command_checksum(char * token, Channel * c) {
+    MemoryHashArgs args;
+
+    read_memory_hash_args(token, c, &args);
+    json_test_char(&c->inp, MARKER_EOM);
+
+    cache_enter(memory_checksum_cache_client, c, &args, sizeof(args));
+}
+
+static void command_compare(char * token, Channel * c) {
+    MemoryHashArgs args;
+
+    read_memory_hash_args(token, c, &args);
+    json_read_struct(&c->inp, read_memory_hash_ref, &args);
+    json_test_char(&c->inp, MARKER_EOA);
+    json_test_char(&c->inp, MARKER_EOM);
+
+    cache_enter(memory_compare_cache_client, c, &args, sizeof(args));
+}
+
 static void send_event_context_added(Context * ctx) {
     OutputStream * out = &broadcast_group->out;
 
@@ -728,6 +1623,13 @@ void ini_memory_service(Protocol * proto, TCFBroadcastGroup * bcg) {
     add_command_handler(proto, MEMORY, "set", command_set);
     add_command_handler(proto, MEMORY, "get", command_get);
     add_command_handler(proto, MEMORY, "fill", command_fill);
+    add_command_handler(proto, MEMORY, "search", command_search);
+    add_command_handler(proto, MEMORY, "checksum", command_checksum);
+    add_command_handler(proto, MEMORY, "compare", command_compare);
+#if SERVICE_Streams
+    add_command_handler(proto, MEMORY, "getStream", command_get_stream);
+    add_channel_close_listener(channel_close_listener);
+#endif
 }
 
 #endif /* SERVICE_Memory */
@@ -89,6 +89,7 @@ static const char * PROCESSES[2] = { "Processes", "ProcessesV1" };
 #define PBUF_SIZE 0x400
 #define PIPE_SIZE 0x400
 #define SBUF_SIZE 0x1000
+#define OBUF_SIZE 0x10000
 
 typedef struct AttachDoneArgs {
     Channel * c;
@@ -123,9 +124,9 @@ typedef struct ProcessOutput {
     ChildProcess * prs;
     AsyncReqInfo req;
     int req_posted;
-    char buf[PBUF_SIZE];
-    size_t buf_pos;
+    int got_output;
     int eos;
+    int err;
     VirtualStream * vstream;
 } ProcessOutput;
 
@@ -469,13 +470,25 @@ static void attach_done(int error, Context * ctx, void * arg) {
     loc_free(data);
 }
 
+static void read_attach_params(InputStream * inp, const char * nm, void * arg) {
+    int * mode = (int *)arg;
+    if (strcmp(nm, "AttachChildren") == 0) *mode |= json_read_boolean(inp) ? CONTEXT_ATTACH_CHILDREN : 0;
+    else if (strcmp(nm, "NonStop") == 0) *mode |= json_read_boolean(inp) ? CONTEXT_ATTACH_NON_STOP : 0;
+    else json_skip_object(inp);
+}
+
 static void command_attach(char * token, Channel * c) {
     int err = 0;
+    int mode = 0;
     char id[256];
     pid_t pid, parent;
 
     json_read_string(&c->inp, id, sizeof(id));
     json_test_char(&c->inp, MARKER_EOA);
+    if (peek_stream(&c->inp) != MARKER_EOM) {
+        json_read_struct(&c->inp, read_attach_params, &mode);
+        json_test_char(&c->inp, MARKER_EOA);
+    }
     json_test_char(&c->inp, MARKER_EOM);
 
     pid = id2pid(id, &parent);
@@ -490,7 +503,7 @@ static void command_attach(char * token, Channel * c) {
         AttachDoneArgs * data = (AttachDoneArgs *)loc_alloc_zero(sizeof *data);
         data->c = c;
         strcpy(data->token, token);
-        if (context_attach(pid, attach_done, data, 0) == 0) {
+        if (context_attach(pid, attach_done, data, mode) == 0) {
             channel_lock_with_msg(c, PROCESSES[0]);
             return;
         }
@@ -959,10 +972,25 @@ static ProcessInput * write_process_input(ChildProcess * prs, int fd) {
     return inp;
 }
 
-static void post_out_read_req(void * args) {
+static int read_process_output_func(void * args) {
+    /* Worker thread: read process output directly into the stream buffer until it is full */
     ProcessOutput * out = (ProcessOutput *)args;
-    assert(out->req_posted);
-    async_req_post(&out->req);
+    for (;;) {
+        char * buf = NULL;
+        size_t size = virtual_stream_reserve(out->vstream, &buf);
+        ssize_t rd = 0;
+        if (size == 0) return 0;
+        rd = read(out->fd, buf, size);
+        if (rd < 0 && errno == EINTR) continue;
+        if (rd <= 0) {
+            out->err = rd < 0 ? errno : 0;
+            out->eos = 1;
+            virtual_stream_commit(out->vstream, 0, 1);
+            return 0;
+        }
+        out->got_output = 1;
+        virtual_stream_commit(out->vstream, rd, 0);
+    }
 }
 
 static void process_output_streams_callback(VirtualStream * stream, int event_code, void * args) {
@@ -970,47 +998,21 @@ static void process_output_streams_callback(VirtualStream * stream, int event_co
 
     assert(out->vstream == stream);
     if (!out->req_posted) {
-        int buf_len = out->req.u.fio.rval;
-        int err = 0;
-        int eos = 0;
-
-        if (buf_len < 0) {
-            buf_len = 0;
-            err = out->req.error;
-        }
-        if (buf_len == 0) eos = 1;
-        if (err && out->prs == NULL) err = 0;
-
-        assert((size_t)buf_len <= sizeof(out->buf));
-        assert(out->buf_pos <= (size_t)buf_len);
-        assert(out->req.u.fio.bufp == out->buf);
-#ifdef __linux__
-        if (err == EIO) err = 0;
-#endif
-        if (err) trace(LOG_ALWAYS, "Can't read process output stream: %d %s", err, errno_to_str(err));
-
-        if (out->buf_pos < (size_t)buf_len || out->eos != eos) {
-            size_t done = 0;
-            virtual_stream_add_data(stream, out->buf + out->buf_pos, buf_len - out->buf_pos, &done, eos);
-            out->buf_pos += done;
-            assert(out->buf_pos <= (size_t)buf_len);
-            if (out->buf_pos == (size_t)buf_len && eos) out->eos = 1;
-        }
-
-        if (out->buf_pos >= (size_t)buf_len) {
-            if (!eos) {
+        char * buf = NULL;
+        if (!out->eos) {
+            if (virtual_stream_reserve(stream, &buf) > 0) {
                 out->req_posted = 1;
-                post_event_with_delay(post_out_read_req, out, 10000);
+                async_req_post(&out->req);
             }
-            else if (virtual_stream_is_empty(stream)) {
-                if (out->prs != NULL) {
-                    if (out == out->prs->out_struct) out->prs->out_struct = NULL;
-                    if (out == out->prs->err_struct) out->prs->err_struct = NULL;
-                }
-                virtual_stream_delete(stream);
-                close(out->fd);
-                loc_free(out);
+        }
+        else if (virtual_stream_is_empty(stream)) {
+            if (out->prs != NULL) {
+                if (out == out->prs->out_struct) out->prs->out_struct = NULL;
+                if (out == out->prs->err_struct) out->prs->err_struct = NULL;
             }
+            virtual_stream_delete(stream);
+            close(out->fd);
+            loc_free(out);
         }
     }
 }
@@ -1019,9 +1021,17 @@ static void read_process_output_done(void * x) {
     AsyncReqInfo * req = (AsyncReqInfo *)x;
     ProcessOutput * out = (ProcessOutput *)req->client_data;
 
-    out->buf_pos = 0;
     out->req_posted = 0;
-    if (out->prs && out->req.u.fio.rval > 0) out->prs->got_output = 1;
+    if (out->prs && out->got_output) out->prs->got_output = 1;
+    if (out->err) {
+        int err = out->err;
+        out->err = 0;
+        if (out->prs == NULL) err = 0;
+#ifdef __linux__
+        if (err == EIO) err = 0;
+#endif
+        if (err) trace(LOG_ALWAYS, "Can't read process output stream: %d %s", err, errno_to_str(err));
+    }
     process_output_streams_callback(out->vstream, 0, out);
 }
 
@@ -1031,11 +1041,10 @@ static ProcessOutput * read_process_output(ChildProcess * prs, int fd) {
     out->prs = prs;
     out->req.client_data = out;
     out->req.done = read_process_output_done;
-    out->req.type = AsyncReqRead;
-    out->req.u.fio.bufp = out->buf;
-    out->req.u.fio.bufsz = sizeof(out->buf);
-    out->req.u.fio.fd = fd;
-    virtual_stream_create(prs->service, pid2id(prs->pid, 0), SBUF_SIZE, VS_ENABLE_REMOTE_READ,
+    out->req.type = AsyncReqUser;
+    out->req.u.user.func = read_process_output_func;
+    out->req.u.user.data = out;
+    virtual_stream_create(prs->service, pid2id(prs->pid, 0), OBUF_SIZE, VS_ENABLE_REMOTE_READ,
         process_output_streams_callback, out, &out->vstream);
     virtual_stream_get_id(out->vstream, out->id, sizeof(out->id));
     out->req_posted = 1;
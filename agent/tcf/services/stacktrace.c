@@ -37,6 +37,7 @@
 #include <tcf/services/symbols.h>
 #include <tcf/services/linenumbers.h>
 #include <tcf/services/memorymap.h>
+#include <tcf/services/runctrl.h>
 #include <tcf/services/stacktrace.h>
 
 #define MAX_FRAMES  1000
@@ -53,6 +54,9 @@ typedef struct StackTrace {
 
 static size_t context_extension_offset = 0;
 
+/* Clients of getProcessStacks wait here until all threads of a process are stopped */
+static AbstractCache stop_cache;
+
 #define EXT(ctx) ((StackTrace *)((char *)(ctx) + context_extension_offset))
 
 static void add_frame(StackTrace * stack, StackFrame * frame) {
@@ -576,6 +580,288 @@ static void command_get_children_range(char * token, Channel * c) {
     cache_enter(command_get_children_cache_client, c, &args, sizeof(args));
 }
 
+typedef struct CommandGetStacksArgs {
+    char token[256];
+    char id[256];
+    int max_frames;
+    int unique;
+    int suspend;
+    int suspended;
+    Context ** resume;      /* Threads that are intercepted by the command, resumed after the reply */
+    unsigned resume_cnt;
+} CommandGetStacksArgs;
+
+typedef struct ThreadStack {
+    Context * ctx;
+    StackTrace * stack;
+    int error;
+    int frame_cnt;
+    uint64_t * ips;
+    unsigned hash;
+    unsigned dup_cnt; /* number of threads with same stack, 0 if the stack is reported by other thread */
+    struct ThreadStack * next_dup;
+} ThreadStack;
+
+static void get_thread_stack(ThreadStack * s, int max_frames) {
+    int i;
+    int inlined = EXT(s->ctx)->inlined;
+    RegisterDefinition * reg_ip = get_PC_definition(s->ctx);
+
+    s->stack = create_stack_trace(s->ctx, inlined + max_frames);
+    if (s->stack == NULL) {
+        s->error = errno;
+        return;
+    }
+    s->frame_cnt = s->stack->frame_cnt - inlined;
+    if (s->frame_cnt > max_frames) s->frame_cnt = max_frames;
+    if (s->frame_cnt < 0) s->frame_cnt = 0;
+    s->ips = (uint64_t *)tmp_alloc_zero(sizeof(uint64_t) * (s->frame_cnt + 1));
+    s->hash = s->frame_cnt;
+    for (i = 0; i < s->frame_cnt; i++) {
+        StackFrame * frame = s->stack->frames + inlined + i;
+        if (reg_ip != NULL) read_reg_value(frame, reg_ip, s->ips + i);
+        s->hash = s->hash * 31 + (unsigned)s->ips[i] + (unsigned)frame->inlined;
+    }
+}
+
+static int is_same_stack(ThreadStack * x, ThreadStack * y) {
+    int i;
+    if (x->error || y->error) return 0;
+    if (x->hash != y->hash) return 0;
+    if (x->frame_cnt != y->frame_cnt) return 0;
+    if (x->stack->complete != y->stack->complete) return 0;
+    for (i = 0; i < x->frame_cnt; i++) {
+        StackFrame * fx = x->stack->frames + EXT(x->ctx)->inlined + i;
+        StackFrame * fy = y->stack->frames + EXT(y->ctx)->inlined + i;
+        if (x->ips[i] != y->ips[i]) return 0;
+        if (fx->inlined != fy->inlined) return 0;
+    }
+    return 1;
+}
+
+static void write_thread_stack(OutputStream * out, ThreadStack * s) {
+    int i;
+    ThreadStack * d;
+
+    write_stream(out, '{');
+
+    json_write_string(out, "Threads");
+    write_stream(out, ':');
+    write_stream(out, '[');
+    for (d = s; d != NULL; d = d->next_dup) {
+        if (d != s) write_stream(out, ',');
+        json_write_string(out, d->ctx->id);
+    }
+    write_stream(out, ']');
+
+    write_stream(out, ',');
+    json_write_string(out, "Count");
+    write_stream(out, ':');
+    json_write_ulong(out, s->dup_cnt);
+
+    if (s->error) {
+        write_stream(out, ',');
+        json_write_string(out, "Error");
+        write_stream(out, ':');
+        write_error_object(out, s->error);
+    }
+    else {
+        write_stream(out, ',');
+        json_write_string(out, "Complete");
+        write_stream(out, ':');
+        json_write_boolean(out, s->stack->complete && s->frame_cnt == s->stack->frame_cnt - EXT(s->ctx)->inlined);
+
+        write_stream(out, ',');
+        json_write_string(out, "Frames");
+        write_stream(out, ':');
+        write_stream(out, '[');
+        for (i = 0; i < s->frame_cnt; i++) {
+            StackFrame * frame = s->stack->frames + EXT(s->ctx)->inlined + i;
+            if (i > 0) write_stream(out, ',');
+            write_stream(out, '{');
+            json_write_string(out, "IP");
+            write_stream(out, ':');
+            json_write_uint64(out, s->ips[i]);
+            if (frame->fp) {
+                write_stream(out, ',');
+                json_write_string(out, "FP");
+                write_stream(out, ':');
+                json_write_uint64(out, frame->fp);
+            }
+            if (frame->inlined) {
+                write_stream(out, ',');
+                json_write_string(out, "Inlined");
+                write_stream(out, ':');
+                json_write_long(out, frame->inlined);
+            }
+            if (frame->func_id != NULL) {
+                write_stream(out, ',');
+                json_write_string(out, "FuncID");
+                write_stream(out, ':');
+                json_write_string(out, frame->func_id);
+            }
+            if (frame->area != NULL) {
+                write_stream(out, ',');
+                json_write_string(out, "CodeArea");
+                write_stream(out, ':');
+                write_code_area(out, frame->area, NULL);
+            }
+            write_stream(out, '}');
+        }
+        write_stream(out, ']');
+    }
+
+    write_stream(out, '}');
+}
+
+static void command_get_stacks_cache_client(void * x) {
+    int err = 0;
+    unsigned i, j;
+    unsigned cnt = 0;
+    unsigned max = 0;
+    int wait = 0;
+    LINK * l;
+    Context * prs = NULL;
+    ThreadStack * buf = NULL;
+    CommandGetStacksArgs * args = (CommandGetStacksArgs *)x;
+    Channel * c = cache_channel();
+
+    prs = id2ctx(args->id);
+    if (prs == NULL) err = ERR_INV_CONTEXT;
+    else prs = context_get_group(prs, CONTEXT_GROUP_PROCESS);
+
+#if SERVICE_RunControl
+    if (err == 0 && args->suspend && !args->suspended) {
+        /* Stop the whole process once, instead of stopping threads one by one */
+        for (l = context_root.next; l != &context_root; l = l->next) {
+            Context * ctx = ctxl2ctxp(l);
+            if (ctx->exited || !context_has_state(ctx)) continue;
+            if (context_get_group(ctx, CONTEXT_GROUP_PROCESS) != prs) continue;
+            if (is_intercepted(ctx)) continue;
+            if (args->resume_cnt >= max) {
+                max = max == 0 ? 64 : max * 2;
+                args->resume = (Context **)loc_realloc(args->resume, sizeof(Context *) * max);
+            }
+            args->resume[args->resume_cnt++] = ctx;
+            context_lock(ctx);
+        }
+        max = 0;
+        if (suspend_debug_context(prs) < 0) err = errno;
+        args->suspended = 1;
+    }
+#endif
+
+    for (l = context_root.next; err == 0 && l != &context_root; l = l->next) {
+        ThreadStack * s = NULL;
+        Context * ctx = ctxl2ctxp(l);
+        if (ctx->exited) continue;
+        if (!context_has_state(ctx)) continue;
+        if (context_get_group(ctx, CONTEXT_GROUP_PROCESS) != prs) continue;
+        if (cnt >= max) {
+            max = max == 0 ? 64 : max * 2;
+            buf = (ThreadStack *)tmp_realloc(buf, sizeof(ThreadStack) * max);
+        }
+        s = buf + cnt++;
+        memset(s, 0, sizeof(ThreadStack));
+        s->ctx = ctx;
+        s->dup_cnt = 1;
+        if (!ctx->stopped) {
+            if (ctx->pending_intercept && !ctx->exiting) wait = 1;
+            s->error = ERR_IS_RUNNING;
+            continue;
+        }
+        /* Keep going after a cache miss, so all data requests are issued at once */
+        get_thread_stack(s, args->max_frames);
+    }
+
+    if (wait && cache_miss_count() == 0) cache_wait(&stop_cache);
+
+    cache_exit();
+
+    if (err == 0 && args->unique) {
+        for (i = 0; i < cnt; i++) {
+            ThreadStack * s = buf + i;
+            for (j = 0; j < i; j++) {
+                ThreadStack * d = buf + j;
+                if (d->dup_cnt == 0) continue;
+                if (!is_same_stack(s, d)) continue;
+                while (d->next_dup != NULL) d = d->next_dup;
+                d->next_dup = s;
+                buf[j].dup_cnt++;
+                s->dup_cnt = 0;
+                break;
+            }
+        }
+    }
+
+    write_stringz(&c->out, "R");
+    write_stringz(&c->out, args->token);
+    write_errno(&c->out, err);
+    if (err) {
+        write_stringz(&c->out, "null");
+    }
+    else {
+        int n = 0;
+        write_stream(&c->out, '[');
+        for (i = 0; i < cnt; i++) {
+            ThreadStack * s = buf + i;
+            if (s->dup_cnt == 0) continue;
+            if (n++ > 0) write_stream(&c->out, ',');
+            write_thread_stack(&c->out, s);
+        }
+        write_stream(&c->out, ']');
+        write_stream(&c->out, 0);
+    }
+    write_stream(&c->out, MARKER_EOM);
+
+#if SERVICE_RunControl
+    /* Resume threads that were running before the command, the client does not own their suspended state */
+    for (i = 0; i < args->resume_cnt; i++) {
+        Context * ctx = args->resume[i];
+        if (!ctx->exited && is_intercepted(ctx)) {
+            if (continue_debug_context(ctx, c, RM_RESUME, 1, 0, 0) < 0) {
+                trace(LOG_ALWAYS, "Cannot resume %s: %s", ctx->id, errno_to_str(errno));
+            }
+        }
+        context_unlock(ctx);
+    }
+    loc_free(args->resume);
+#endif
+}
+
+static void read_get_stacks_params(InputStream * inp, const char * name, void * x) {
+    CommandGetStacksArgs * args = (CommandGetStacksArgs *)x;
+
+    if (strcmp(name, "MaxFrames") == 0) {
+        args->max_frames = (int)json_read_long(inp);
+    }
+    else if (strcmp(name, "Unique") == 0) {
+        args->unique = json_read_boolean(inp);
+    }
+    else if (strcmp(name, "Suspend") == 0) {
+        args->suspend = json_read_boolean(inp);
+    }
+    else {
+        json_skip_object(inp);
+    }
+}
+
+static void command_get_process_stacks(char * token, Channel * c) {
+    CommandGetStacksArgs args;
+
+    memset(&args, 0, sizeof(args));
+    args.max_frames = MAX_FRAMES;
+    json_read_string(&c->inp, args.id, sizeof(args.id));
+    json_test_char(&c->inp, MARKER_EOA);
+    json_read_struct(&c->inp, read_get_stacks_params, &args);
+    json_test_char(&c->inp, MARKER_EOA);
+    json_test_char(&c->inp, MARKER_EOM);
+
+    if (args.max_frames <= 0 || args.max_frames > MAX_FRAMES) args.max_frames = MAX_FRAMES;
+    strlcpy(args.token, token, sizeof(args.token));
+    cache_enter(command_get_stacks_cache_client, c, &args, sizeof(args));
+}
+
 int get_top_frame(Context * ctx) {
 
     if (!ctx->stopped) {
@@ -693,6 +979,15 @@ static void flush_stack_trace(Context * ctx, void * args) {
     EXT(ctx)->inlined = 0;
 }
 
+static void event_context_exited(Context * ctx, void * args) {
+    flush_stack_trace(ctx, args);
+    cache_notify_later(&stop_cache);
+}
+
+static void event_context_stopped(Context * ctx, void * args) {
+    cache_notify_later(&stop_cache);
+}
+
 #if SERVICE_Registers
 static void flush_on_register_change(Context * ctx, int frame, RegisterDefinition * def, void * args) {
     invalidate_stack_trace(EXT(ctx));
@@ -724,8 +1019,8 @@ static void event_map_changed(Context * ctx, void * client_data) {
 void ini_stack_trace_service(Protocol * proto, TCFBroadcastGroup * bcg) {
     static ContextEventListener context_listener = {
         NULL,
-        flush_stack_trace,
-        NULL,
+        event_context_exited,
+        event_context_stopped,
         flush_stack_trace,
         flush_stack_trace,
         delete_stack_trace
@@ -753,6 +1048,7 @@ void ini_stack_trace_service(Protocol * proto, TCFBroadcastGroup * bcg) {
     add_command_handler(proto, STACKTRACE, "getContext", command_get_context);
     add_command_handler(proto, STACKTRACE, "getChildren", command_get_children);
     add_command_handler(proto, STACKTRACE, "getChildrenRange", command_get_children_range);
+    add_command_handler(proto, STACKTRACE, "getProcessStacks", command_get_process_stacks);
     context_extension_offset = context_extension(sizeof(StackTrace));
 }
 
@@ -65,6 +65,10 @@ struct VirtualStream {
     unsigned eos_out;
     unsigned data_available_posted;
     unsigned space_available_posted;
+    /* Producer thread state, see virtual_stream_reserve() */
+    size_t buf_ext;
+    size_t eos_ext;
+    size_t publish_posted;
 };
 
 struct StreamClient {
@@ -116,6 +120,38 @@ static LINK streams = TCF_LIST_INIT(streams);
 static LINK subscriptions = TCF_LIST_INIT(subscriptions);
 static unsigned id_cnt = 0;
 
+/*
+ * Buffer indices that are shared with a producer thread:
+ * the producer only writes buf_ext and eos_ext, the dispatch thread only writes buf_out.
+ */
+#if defined(__GNUC__)
+#  define load_index(p)         __atomic_load_n(p, __ATOMIC_SEQ_CST)
+#  define store_index(p, v)     __atomic_store_n(p, v, __ATOMIC_SEQ_CST)
+#  define test_and_set(p)       __atomic_exchange_n(p, 1, __ATOMIC_SEQ_CST)
+#else
+static pthread_mutex_t index_lock;
+static size_t load_index(size_t * p) {
+    size_t v;
+    check_error(pthread_mutex_lock(&index_lock));
+    v = *p;
+    check_error(pthread_mutex_unlock(&index_lock));
+    return v;
+}
+static void store_index(size_t * p, size_t v) {
+    check_error(pthread_mutex_lock(&index_lock));
+    *p = v;
+    check_error(pthread_mutex_unlock(&index_lock));
+}
+static size_t test_and_set(size_t * p) {
+    size_t v;
+    check_error(pthread_mutex_lock(&index_lock));
+    v = *p;
+    *p = 1;
+    check_error(pthread_mutex_unlock(&index_lock));
+    return v;
+}
+#endif
+
 static unsigned get_client_hash(unsigned id, Channel * c) {
     return (id + (unsigned)(uintptr_t)c) % HANDLE_HASH_SIZE;
 }
@@ -231,6 +267,11 @@ static void delete_stream(void * args) {
     assert(stream->magic == STREAM_MAGIC);
     assert(list_is_empty(&stream->clients));
     assert(stream->deleted);
+    if (load_index(&stream->publish_posted)) {
+        /* publish_data event is pending, it holds a reference to the stream */
+        post_event(delete_stream, stream);
+        return;
+    }
     stream->magic = 0;
     list_remove(&stream->link_all);
     loc_free(stream->buf);
@@ -266,11 +307,11 @@ static void advance_stream_buffer(VirtualStream * stream) {
         if (client->pos < min_pos) min_pos = client->pos;
     }
     if (min_pos == ~(uint64_t)0) {
-        stream->buf_out = stream->buf_inp;
+        store_index(&stream->buf_out, stream->buf_inp);
     }
     else if (min_pos > buf_pos) {
         assert(min_pos - buf_pos <= len);
-        stream->buf_out = (stream->buf_out + (unsigned)(min_pos - buf_pos)) % stream->buf_len;
+        store_index(&stream->buf_out, (stream->buf_out + (unsigned)(min_pos - buf_pos)) % stream->buf_len);
     }
     if (len != (stream->buf_inp + stream->buf_len - stream->buf_out) % stream->buf_len &&
         !stream->space_available_posted) {
@@ -399,6 +440,26 @@ static void send_read_reply(StreamClient * client, char * token, size_t size) {
     write_stream(&c->out, MARKER_EOM);
 }
 
+static void notify_new_data(VirtualStream * stream) {
+    if (stream->access & VS_ENABLE_REMOTE_READ) {
+        LINK * l;
+        for (l = stream->clients.next; l != &stream->clients; l = l->next) {
+            StreamClient * client = stream2client(l);
+            while (!list_is_empty(&client->read_requests) && (client->pos < stream->pos || stream->eos_inp)) {
+                ReadRequest * r = client2read_request(client->read_requests.next);
+                list_remove(&r->link_client);
+                send_read_reply(client, r->token, r->size);
+                loc_free(r);
+            }
+        }
+        advance_stream_buffer(stream);
+    }
+    else if (!stream->data_available_posted) {
+        post_event(notify_data_available, stream);
+        stream->data_available_posted = 1;
+    }
+}
+
 void virtual_stream_create(const char * type, const char * context_id, size_t buf_len, unsigned access,
         VirtualStreamCallBack * callback, void * callback_args, VirtualStream ** res) {
     LINK * l;
@@ -473,30 +534,50 @@ int virtual_stream_add_data(VirtualStream * stream, char * buf, size_t buf_size,
         if (eos && buf_size == len) stream->eos_inp = 1;
     }
 
-    if (stream->access & VS_ENABLE_REMOTE_READ) {
-        if (!err && (stream->eos_inp || *data_size > 0)) {
-            LINK * l;
-            for (l = stream->clients.next; l != &stream->clients; l = l->next) {
-                StreamClient * client = stream2client(l);
-                while (!list_is_empty(&client->read_requests) && (client->pos < stream->pos || stream->eos_inp)) {
-                    ReadRequest * r = client2read_request(client->read_requests.next);
-                    list_remove(&r->link_client);
-                    send_read_reply(client, r->token, r->size);
-                    loc_free(r);
-                }
-            }
-            advance_stream_buffer(stream);
-        }
-    }
-    else if (!stream->data_available_posted) {
-        post_event(notify_data_available, stream);
-        stream->data_available_posted = 1;
+    if ((stream->access & VS_ENABLE_REMOTE_READ) == 0 || (!err && (stream->eos_inp || *data_size > 0))) {
+        notify_new_data(stream);
     }
 
     errno = err;
     return err ? -1 : 0;
 }
 
+static void publish_data(void * args) {
+    VirtualStream * stream = (VirtualStream *)args;
+    size_t eos = 0;
+    size_t ext = 0;
+    size_t len = 0;
+
+    assert(stream->magic == STREAM_MAGIC);
+    store_index(&stream->publish_posted, 0);
+    if (stream->ref_cnt == 0) return;
+    /* EOS is stored by the producer after the data, so it must be loaded first */
+    eos = load_index(&stream->eos_ext);
+    ext = load_index(&stream->buf_ext);
+    len = (ext + stream->buf_len - stream->buf_inp) % stream->buf_len;
+    stream->buf_inp = ext;
+    stream->pos += len;
+    if (eos) stream->eos_inp = 1;
+    if (len > 0 || stream->eos_inp) notify_new_data(stream);
+}
+
+size_t virtual_stream_reserve(VirtualStream * stream, char ** buf) {
+    size_t ext = load_index(&stream->buf_ext);
+    size_t out = load_index(&stream->buf_out);
+    size_t len = (out + stream->buf_len - ext - 1) % stream->buf_len;
+    if (ext + len > stream->buf_len) len = stream->buf_len - ext;
+    *buf = stream->buf + ext;
+    return len;
+}
+
+void virtual_stream_commit(VirtualStream * stream, size_t size, int eos) {
+    size_t ext = load_index(&stream->buf_ext);
+    assert(size <= stream->buf_len - ext);
+    store_index(&stream->buf_ext, (ext + size) % stream->buf_len);
+    if (eos) store_index(&stream->eos_ext, 1);
+    if (!test_and_set(&stream->publish_posted)) post_event(publish_data, stream);
+}
+
 int virtual_stream_get_data(VirtualStream * stream, char * buf, size_t buf_size, size_t * data_size, int * eos) {
     size_t len;
 
@@ -543,7 +624,7 @@ int virtual_stream_get_data(VirtualStream * stream, char * buf, size_t buf_size,
         }
     }
     if ((stream->access & VS_ENABLE_REMOTE_READ) == 0 && len > 0) {
-        stream->buf_out = (stream->buf_out + len) % stream->buf_len;
+        store_index(&stream->buf_out, (stream->buf_out + len) % stream->buf_len);
         assert(!*eos || stream->buf_out == stream->buf_inp);
         if (!stream->space_available_posted) {
             post_event(notify_space_available, stream);
@@ -562,7 +643,7 @@ int virtual_stream_is_empty(VirtualStream * stream) {
 void virtual_stream_drop_data(VirtualStream * stream, size_t size) {
     size_t len = virtual_stream_data_size(stream);
     if (size < len) len = size;
-    stream->buf_out = (stream->buf_out + len) % stream->buf_len;
+    store_index(&stream->buf_out, (stream->buf_out + len) % stream->buf_len);
 }
 
 size_t virtual_stream_data_size(VirtualStream * stream) {
@@ -941,6 +1022,9 @@ void ini_streams_service(Protocol * proto) {
             list_init(&handle_hash[i]);
         }
         add_channel_close_listener(channel_close_listener);
+#if !defined(__GNUC__)
+        check_error(pthread_mutex_init(&index_lock, NULL));
+#endif
         ini_streams = 1;
     }
 
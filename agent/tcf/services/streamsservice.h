@@ -46,6 +46,17 @@ extern int virtual_stream_is_empty(VirtualStream * stream);
 extern void virtual_stream_drop_data(VirtualStream * stream, size_t size);
 extern size_t virtual_stream_data_size(VirtualStream * stream);
 
+/*
+ * Producer interface for VS_ENABLE_REMOTE_READ streams, it can be used by any thread.
+ * Only one thread at a time can produce data, and the stream must not be fed by virtual_stream_add_data().
+ * virtual_stream_reserve() returns size and address of free contiguous space in the stream buffer.
+ * After data is written into the space, virtual_stream_commit() makes it available to stream clients.
+ * When the buffer is full, VS_EVENT_SPACE_AVAILABLE is reported to the stream callback.
+ * The producer must be done with the stream before virtual_stream_delete() is called.
+ */
+extern size_t virtual_stream_reserve(VirtualStream * stream, char ** buf);
+extern void virtual_stream_commit(VirtualStream * stream, size_t size, int eos);
+
 extern int virtual_stream_eos(Channel * c, char * token, char * id);
 extern int virtual_stream_write(Channel * c, char * token, char * id, size_t size, InputStream * inp);
 extern int virtual_stream_read(Channel * c, char * token, char * id, size_t size);
@@ -1198,6 +1198,245 @@ static void command_get_address_info(char * token, Channel * c) {
     cache_enter(command_get_address_info_cache_client, c, &args, sizeof(args));
 }
 
+typedef struct SymbolizeRange {
+    int valid;
+    ContextAddress addr;
+    ContextAddress size;
+    char * json; /* NULL if nothing found */
+} SymbolizeRange;
+
+typedef struct SymbolizeState {
+    unsigned pos;
+    ByteArrayOutputStream buf;
+    SymbolizeRange func;
+    SymbolizeRange line;
+} SymbolizeState;
+
+typedef struct CommandSymbolizeArgs {
+    char token[256];
+    char id[256];
+    ContextAddress * addrs;
+    unsigned addr_cnt;
+    unsigned addr_max;
+    SymbolizeState * state;
+} CommandSymbolizeArgs;
+
+static void read_symbolize_addr(InputStream * inp, void * x) {
+    CommandSymbolizeArgs * args = (CommandSymbolizeArgs *)x;
+    if (args->addr_cnt >= args->addr_max) {
+        args->addr_max = args->addr_max == 0 ? 64 : args->addr_max * 2;
+        args->addrs = (ContextAddress *)loc_realloc(args->addrs, sizeof(ContextAddress) * args->addr_max);
+    }
+    args->addrs[args->addr_cnt++] = (ContextAddress)json_read_uint64(inp);
+}
+
+static void set_symbolize_range(SymbolizeRange * range, ContextAddress addr, ContextAddress size, ByteArrayOutputStream * buf) {
+    char * data = NULL;
+    size_t data_size = 0;
+    write_stream(&buf->out, 0);
+    get_byte_array_output_stream_data(buf, &data, &data_size);
+    if (data_size <= 1) {
+        loc_free(data);
+        data = NULL;
+    }
+    loc_free(range->json);
+    range->valid = 1;
+    range->addr = addr;
+    range->size = size;
+    range->json = data;
+}
+
+static int find_symbolize_function(Context * ctx, ContextAddress addr, SymbolizeRange * range) {
+    /* Outermost function that contains the address, ranges of functions don't overlap */
+    ByteArrayOutputStream buf;
+    OutputStream * out = create_byte_array_output_stream(&buf);
+    Symbol * sym = NULL;
+    char * name = NULL;
+    ContextAddress sym_addr = 0;
+    ContextAddress sym_size = 0;
+
+    if (find_symbol_by_addr(ctx, STACK_NO_FRAME, addr, &sym) < 0) return -1;
+    if (get_symbol_name(sym, &name) < 0) return -1;
+    if (get_symbol_address(sym, &sym_addr) < 0) return -1;
+    if (get_symbol_size(sym, &sym_size) < 0 || sym_addr > addr || sym_addr + sym_size <= addr) {
+        /* Size is unknown for non-contiguous functions, don't reuse the result for other addresses */
+        sym_addr = addr;
+        sym_size = 1;
+    }
+    json_write_string(out, "ID");
+    write_stream(out, ':');
+    json_write_string(out, symbol2id(sym));
+    if (name != NULL) {
+        write_stream(out, ',');
+        json_write_string(out, "Name");
+        write_stream(out, ':');
+        json_write_string(out, name);
+    }
+    set_symbolize_range(range, sym_addr, sym_size, &buf);
+    return 0;
+}
+
+#if ENABLE_LineNumbers
+static void symbolize_line_cb(CodeArea * area, void * x) {
+    CodeArea * res = (CodeArea *)x;
+    if (res->file == NULL && area->start_address <= res->start_address && area->end_address > res->start_address) {
+        *res = *area;
+    }
+}
+
+static int find_symbolize_line(Context * ctx, ContextAddress addr, SymbolizeRange * range) {
+    ByteArrayOutputStream buf;
+    OutputStream * out = create_byte_array_output_stream(&buf);
+    CodeArea area;
+
+    memset(&area, 0, sizeof(area));
+    area.start_address = addr;
+    if (address_to_line(ctx, addr, addr + 1, symbolize_line_cb, &area) < 0) return -1;
+    if (area.file == NULL) {
+        area.start_address = addr;
+        area.end_address = addr + 1;
+    }
+    else {
+        write_code_area(out, &area, NULL);
+    }
+    set_symbolize_range(range, area.start_address, area.end_address - area.start_address, &buf);
+    return 0;
+}
+#endif /* ENABLE_LineNumbers */
+
+static void command_symbolize_cache_client(void * x) {
+    CommandSymbolizeArgs * args = (CommandSymbolizeArgs *)x;
+    SymbolizeState * state = args->state;
+    Channel * c = cache_channel();
+    Context * ctx = NULL;
+    int err = 0;
+
+    ctx = id2ctx(args->id);
+    if (ctx == NULL) err = ERR_INV_CONTEXT;
+    else if (ctx->exited) err = ERR_ALREADY_EXITED;
+
+    if (state == NULL) {
+        state = args->state = (SymbolizeState *)loc_alloc_zero(sizeof(SymbolizeState));
+        create_byte_array_output_stream(&state->buf);
+    }
+
+    /* Addresses are expected to be sorted, consecutive addresses in same function
+     * or same line area reuse the previous result. Progress is kept in 'state',
+     * so a cache miss does not restart the walk from the first address. */
+    while (!err && state->pos < args->addr_cnt) {
+        OutputStream * out = &state->buf.out;
+        ContextAddress addr = args->addrs[state->pos];
+        StackTracingInfo * info = NULL;
+        int func_err = 0;
+        int line_err = 0;
+        int info_err = 0;
+
+        if (!state->func.valid || addr < state->func.addr || addr - state->func.addr >= state->func.size) {
+            if (find_symbolize_function(ctx, addr, &state->func) < 0) {
+                func_err = errno;
+                loc_free(state->func.json);
+                memset(&state->func, 0, sizeof(state->func));
+            }
+        }
+#if ENABLE_LineNumbers
+        if (!state->line.valid || addr < state->line.addr || addr - state->line.addr >= state->line.size) {
+            if (find_symbolize_line(ctx, addr, &state->line) < 0) {
+                line_err = errno;
+                loc_free(state->line.json);
+                memset(&state->line, 0, sizeof(state->line));
+            }
+        }
+#endif
+        if (get_stack_tracing_info(ctx, addr, &info) < 0) info_err = errno;
+
+        if (get_error_code(func_err) == ERR_CACHE_MISS ||
+            get_error_code(line_err) == ERR_CACHE_MISS ||
+            get_error_code(info_err) == ERR_CACHE_MISS) break;
+
+        if (state->pos > 0) write_stream(out, ',');
+        write_stream(out, '{');
+        json_write_string(out, "Addr");
+        write_stream(out, ':');
+        json_write_uint64(out, addr);
+        if (state->func.json != NULL) {
+            write_stream(out, ',');
+            write_string(out, state->func.json);
+            write_stream(out, ',');
+            json_write_string(out, "Offset");
+            write_stream(out, ':');
+            json_write_uint64(out, addr - state->func.addr);
+        }
+        else if (get_error_code(func_err) != ERR_SYM_NOT_FOUND) {
+            write_stream(out, ',');
+            json_write_string(out, "Error");
+            write_stream(out, ':');
+            write_error_object(out, func_err);
+        }
+        if (info != NULL && info->sub_cnt > 0) {
+            int i;
+            write_stream(out, ',');
+            json_write_string(out, "Inlined");
+            write_stream(out, ':');
+            write_stream(out, '[');
+            for (i = 0; i < info->sub_cnt; i++) {
+                if (i > 0) write_stream(out, ',');
+                write_inlined_subroutine_info(out, info->subs[i]);
+            }
+            write_stream(out, ']');
+        }
+        if (state->line.json != NULL) {
+            write_stream(out, ',');
+            json_write_string(out, "Area");
+            write_stream(out, ':');
+            write_string(out, state->line.json);
+        }
+        write_stream(out, '}');
+        state->pos++;
+    }
+
+    cache_exit();
+
+    if (!is_channel_closed(c)) {
+        char * data = NULL;
+        size_t size = 0;
+        get_byte_array_output_stream_data(&state->buf, &data, &size);
+        write_stringz(&c->out, "R");
+        write_stringz(&c->out, args->token);
+        write_errno(&c->out, err);
+        if (err) {
+            write_stringz(&c->out, "null");
+        }
+        else {
+            write_stream(&c->out, '[');
+            write_block_stream(&c->out, data, size);
+            write_stream(&c->out, ']');
+            write_stream(&c->out, 0);
+        }
+        write_stream(&c->out, MARKER_EOM);
+        loc_free(data);
+    }
+
+    loc_free(state->buf.mem);
+    loc_free(state->func.json);
+    loc_free(state->line.json);
+    loc_free(state);
+    loc_free(args->addrs);
+}
+
+static void command_symbolize(char * token, Channel * c) {
+    CommandSymbolizeArgs args;
+
+    memset(&args, 0, sizeof(args));
+    json_read_string(&c->inp, args.id, sizeof(args.id));
+    json_test_char(&c->inp, MARKER_EOA);
+    json_read_array(&c->inp, read_symbolize_addr, &args);
+    json_test_char(&c->inp, MARKER_EOA);
+    json_test_char(&c->inp, MARKER_EOM);
+
+    strlcpy(args.token, token, sizeof(args.token));
+    cache_enter(command_symbolize_cache_client, c, &args, sizeof(args));
+}
+
 void ini_symbols_service(Protocol * proto) {
     static int ini_done = 0;
     if (!ini_done) {
@@ -1217,6 +1456,7 @@ void ini_symbols_service(Protocol * proto) {
     add_command_handler(proto, SYMBOLS, "findFrameProps", command_find_frame_props);
     add_command_handler(proto, SYMBOLS, "getSymFileInfo", command_get_sym_file_info);
     add_command_handler(proto, SYMBOLS, "getAddressInfo", command_get_address_info);
+    add_command_handler(proto, SYMBOLS, "symbolize", command_symbolize);
 }
 
 #endif /* SERVICE_Symbols */
@@ -37,6 +37,7 @@
 #include <tcf/framework/errors.h>
 #include <tcf/framework/myalloc.h>
 #include <tcf/framework/exceptions.h>
+#include <tcf/framework/trace.h>
 #include <tcf/services/tcf_elf.h>
 #include <tcf/services/dwarf.h>
 #include <tcf/services/dwarfcache.h>
@@ -507,15 +508,13 @@ static int symbol_is_weak(ObjectInfo * obj) {
     if (set_trap(&trap)) {
         const char * name = get_linkage_name(obj);
         if (name != NULL) {
-            unsigned h = calc_symbol_name_hash(name);
             ELF_File * file = obj->mCompUnit->mFile;
             unsigned m = 0;
 
             for (m = 1; m < file->section_cnt; m++) {
                 unsigned n;
                 ELF_Section * tbl = file->sections + m;
-                if (tbl->sym_names_hash == NULL) continue;
-                n = tbl->sym_names_hash[h % tbl->sym_names_hash_size];
+                n = elf_find_symbol_by_name(tbl, name);
                 while (n) {
                     ELF_SymbolInfo sym_info;
                     unpack_elf_symbol_info(tbl, n, &sym_info);
@@ -534,7 +533,7 @@ static int symbol_is_weak(ObjectInfo * obj) {
                             break;
                         }
                     }
-                    n = tbl->sym_names_next[n];
+                    n = elf_next_symbol_by_name(tbl, name, n);
                 }
             }
         }
@@ -1130,8 +1129,9 @@ static int same_namespace(ObjectInfo * x, ObjectInfo * y) {
 static ObjectInfo * find_definition(ObjectInfo * decl) {
     while (decl != NULL) {
         int search_pub_names = 0;
-        if (decl->mDefinition != NULL) {
-            decl = decl->mDefinition;
+        ObjectInfo * def = get_object_definition(decl);
+        if (def != NULL) {
+            decl = def;
             continue;
         }
         if (decl->mName == NULL) return decl;
@@ -1148,7 +1148,6 @@ static ObjectInfo * find_definition(ObjectInfo * decl) {
             break;
         }
         if (search_pub_names) {
-            ObjectInfo * def = NULL;
             DWARFCache * cache = get_dwarf_cache(get_dwarf_file(decl->mCompUnit->mFile));
             PubNamesTable * tbl = &cache->mPubNames;
             if (tbl->mHash != NULL) {
@@ -1169,7 +1168,7 @@ static ObjectInfo * find_definition(ObjectInfo * decl) {
                 }
             }
             if (def != NULL) {
-                decl->mDefinition = def;
+                set_object_definition(decl, def);
                 decl = def;
                 continue;
             }
@@ -1361,14 +1360,12 @@ static void find_in_dwarf(const char * name) {
 
 static void find_by_name_in_sym_table(ELF_File * file, const char * name, int globals) {
     unsigned m = 0;
-    unsigned h = calc_symbol_name_hash(name);
     Context * prs = context_get_group(sym_ctx, CONTEXT_GROUP_SYMBOLS);
 
     for (m = 1; m < file->section_cnt; m++) {
         unsigned n;
         ELF_Section * tbl = file->sections + m;
-        if (tbl->sym_names_hash == NULL) continue;
-        n = tbl->sym_names_hash[h % tbl->sym_names_hash_size];
+        n = elf_find_symbol_by_name(tbl, name);
         while (n) {
             ELF_SymbolInfo sym_info;
             unpack_elf_symbol_info(tbl, n, &sym_info);
@@ -1399,7 +1396,7 @@ static void find_by_name_in_sym_table(ELF_File * file, const char * name, int gl
 
                 add_elf_to_find_symbol_buf(&sym_info);
             }
-            n = tbl->sym_names_next[n];
+            n = elf_next_symbol_by_name(tbl, name, n);
         }
     }
 }
@@ -1969,7 +1966,7 @@ static void tmp_app_hex(char ch, uint64_t n) {
     }
 }
 
-const char * symbol2id(const Symbol * sym) {
+static const char * symbol2long_id(const Symbol * sym) {
     int frame = sym->frame;
     assert(sym->magic == SYMBOL_MAGIC);
     if (frame == STACK_TOP_FRAME) frame = get_top_frame(sym->ctx);
@@ -2100,7 +2097,7 @@ static void read_file_id(const char ** s, FileID * id) {
     *s = p;
 }
 
-int id2symbol(const char * id, Symbol ** res) {
+static int long_id2symbol(const char * id, Symbol ** res) {
     Symbol * sym = alloc_symbol();
     unsigned tbl_index = 0;
     const char * p;
@@ -2202,6 +2199,215 @@ int id2symbol(const char * id, Symbol ** res) {
     return -1;
 }
 
+/*
+ * Symbol handles: symbol2id() returns short IDs "@H<index>.<generation>" that refer
+ * to entries of the handle table. An entry keeps the full symbol ID and,
+ * after first use, the decoded symbol, so id2symbol() does not need
+ * to parse the ID and to search ELF files again.
+ * The decoded symbol is dropped when an ELF file is closed or the memory map changes.
+ * An entry is released when its context exits. If the table is full,
+ * the least recently used entry is reused, so a symbol always gets a short ID.
+ */
+
+#ifndef SYMBOL_HANDLE_MAX
+#define SYMBOL_HANDLE_MAX 0x10000
+#endif
+#define SYMBOL_HANDLE_HASH_SIZE 0x1000
+
+typedef struct SymbolHandle {
+    char * id;              /* Full symbol ID, NULL if the entry is free */
+    char * ctx_id;          /* Symbol context ID */
+    unsigned hash;
+    unsigned next;          /* Next entry in hash chain or free list + 1 */
+    unsigned lru_prev;      /* Previous (more recently used) entry in LRU list + 1 */
+    unsigned lru_next;      /* Next (less recently used) entry in LRU list + 1 */
+    unsigned gen;
+    int cached;
+    Symbol sym;             /* Decoded symbol, valid if 'cached' */
+} SymbolHandle;
+
+static SymbolHandle * sym_handles = NULL;
+static unsigned sym_handles_cnt = 0;
+static unsigned sym_handles_max = 0;
+static unsigned sym_handles_free = 0;
+static unsigned sym_handles_lru_head = 0;
+static unsigned sym_handles_lru_tail = 0;
+static unsigned sym_handles_hash[SYMBOL_HANDLE_HASH_SIZE];
+
+static unsigned calc_symbol_id_hash(const char * id) {
+    unsigned h = 0;
+    while (*id) h = h * 31 + (unsigned char)*id++;
+    return h;
+}
+
+static void unlink_symbol_handle_lru(unsigned n) {
+    SymbolHandle * h = sym_handles + n;
+    if (h->lru_prev) sym_handles[h->lru_prev - 1].lru_next = h->lru_next;
+    else sym_handles_lru_head = h->lru_next;
+    if (h->lru_next) sym_handles[h->lru_next - 1].lru_prev = h->lru_prev;
+    else sym_handles_lru_tail = h->lru_prev;
+    h->lru_prev = h->lru_next = 0;
+}
+
+static void link_symbol_handle_lru(unsigned n) {
+    SymbolHandle * h = sym_handles + n;
+    h->lru_next = sym_handles_lru_head;
+    if (sym_handles_lru_head) sym_handles[sym_handles_lru_head - 1].lru_prev = n + 1;
+    else sym_handles_lru_tail = n + 1;
+    sym_handles_lru_head = n + 1;
+}
+
+static void touch_symbol_handle(unsigned n) {
+    /* Move the entry to the head of LRU list */
+    if (sym_handles_lru_head == n + 1) return;
+    unlink_symbol_handle_lru(n);
+    link_symbol_handle_lru(n);
+}
+
+static void free_symbol_handle(unsigned n) {
+    SymbolHandle * h = sym_handles + n;
+    unsigned * p = sym_handles_hash + h->hash % SYMBOL_HANDLE_HASH_SIZE;
+    while (*p != n + 1) p = &sym_handles[*p - 1].next;
+    *p = h->next;
+    unlink_symbol_handle_lru(n);
+    loc_free(h->id);
+    loc_free(h->ctx_id);
+    h->id = NULL;
+    h->ctx_id = NULL;
+    h->cached = 0;
+    /* Old IDs of the entry become invalid */
+    h->gen++;
+    h->next = sym_handles_free;
+    sym_handles_free = n + 1;
+}
+
+static unsigned get_symbol_handle(const char * id, const char * ctx_id) {
+    unsigned hash = calc_symbol_id_hash(id);
+    unsigned * bucket = sym_handles_hash + hash % SYMBOL_HANDLE_HASH_SIZE;
+    unsigned n = *bucket;
+    SymbolHandle * h = NULL;
+
+    while (n != 0) {
+        h = sym_handles + n - 1;
+        if (h->hash == hash && strcmp(h->id, id) == 0) {
+            touch_symbol_handle(n - 1);
+            return n - 1;
+        }
+        n = h->next;
+    }
+    if (sym_handles_free == 0 && sym_handles_cnt >= SYMBOL_HANDLE_MAX) {
+        /* The table is full, reuse the least recently used entry */
+        assert(sym_handles_lru_tail != 0);
+        trace(LOG_ELF, "Symbol handle table is full, dropping %s", sym_handles[sym_handles_lru_tail - 1].id);
+        free_symbol_handle(sym_handles_lru_tail - 1);
+    }
+    if (sym_handles_free != 0) {
+        n = sym_handles_free - 1;
+        sym_handles_free = sym_handles[n].next;
+    }
+    else {
+        assert(sym_handles_cnt < SYMBOL_HANDLE_MAX);
+        if (sym_handles_cnt >= sym_handles_max) {
+            sym_handles_max = sym_handles_max == 0 ? 256 : sym_handles_max * 2;
+            if (sym_handles_max > SYMBOL_HANDLE_MAX) sym_handles_max = SYMBOL_HANDLE_MAX;
+            sym_handles = (SymbolHandle *)loc_realloc(sym_handles, sizeof(SymbolHandle) * sym_handles_max);
+        }
+        n = sym_handles_cnt++;
+        memset(sym_handles + n, 0, sizeof(SymbolHandle));
+    }
+    h = sym_handles + n;
+    h->id = loc_strdup(id);
+    h->ctx_id = loc_strdup(ctx_id);
+    h->hash = hash;
+    h->next = *bucket;
+    *bucket = n + 1;
+    link_symbol_handle_lru(n);
+    return n;
+}
+
+static void symbol_handles_on_elf_close(ELF_File * file) {
+    unsigned n;
+    for (n = 0; n < sym_handles_cnt; n++) {
+        SymbolHandle * h = sym_handles + n;
+        if (!h->cached) continue;
+        if ((h->sym.obj != NULL && h->sym.obj->mCompUnit->mFile == file) ||
+            (h->sym.var != NULL && h->sym.var->mCompUnit->mFile == file) ||
+            (h->sym.ref != NULL && h->sym.ref->mCompUnit->mFile == file) ||
+            (h->sym.tbl != NULL && h->sym.tbl->file == file)) {
+            h->cached = 0;
+        }
+    }
+}
+
+#if ENABLE_MemoryMap
+static void symbol_handles_on_map_changed(Context * ctx) {
+    unsigned n;
+    Context * prs = context_get_group(ctx, CONTEXT_GROUP_PROCESS);
+    for (n = 0; n < sym_handles_cnt; n++) {
+        SymbolHandle * h = sym_handles + n;
+        Context * c = NULL;
+        if (!h->cached) continue;
+        c = id2ctx(h->ctx_id);
+        if (c == NULL || context_get_group(c, CONTEXT_GROUP_PROCESS) == prs) h->cached = 0;
+    }
+}
+#endif
+
+static void symbol_handles_on_context_exited(Context * ctx, void * args) {
+    unsigned n;
+    for (n = 0; n < sym_handles_cnt; n++) {
+        SymbolHandle * h = sym_handles + n;
+        if (h->id == NULL) continue;
+        if (strcmp(h->ctx_id, ctx->id) == 0) free_symbol_handle(n);
+    }
+}
+
+const char * symbol2id(const Symbol * sym) {
+    static char buf[32];
+    unsigned n = get_symbol_handle(symbol2long_id(sym), sym->ctx->id);
+    snprintf(buf, sizeof(buf), "@H%X.%X", n, sym_handles[n].gen);
+    return buf;
+}
+
+int id2symbol(const char * id, Symbol ** res) {
+    if (id != NULL && id[0] == '@' && id[1] == 'H') {
+        const char * p = id + 2;
+        unsigned n = (unsigned)read_hex(&p);
+        unsigned gen = 0;
+        SymbolHandle * h = NULL;
+        if (*p == '.') p++;
+        gen = (unsigned)read_hex(&p);
+        if (*p != 0 || n >= sym_handles_cnt || sym_handles[n].gen != gen || sym_handles[n].id == NULL) {
+            *res = NULL;
+            errno = ERR_INV_CONTEXT;
+            return -1;
+        }
+        h = sym_handles + n;
+        touch_symbol_handle(n);
+        if (h->cached) {
+            Symbol * sym = alloc_symbol();
+            *sym = h->sym;
+            sym->ctx = id2ctx(h->ctx_id);
+            if (sym->obj != NULL) sym->obj->mCompUnit->mFile->age = 0;
+            if (sym->tbl != NULL) sym->tbl->file->age = 0;
+            *res = sym;
+            if (sym->ctx == NULL) {
+                errno = ERR_INV_CONTEXT;
+                return -1;
+            }
+            return 0;
+        }
+        if (long_id2symbol(h->id, res) < 0) return -1;
+        if ((*res)->base == NULL) {
+            h->sym = **res;
+            h->sym.ctx = NULL;
+            h->cached = 1;
+        }
+        return 0;
+    }
+    return long_id2symbol(id, res);
+}
+
 ContextAddress is_plt_section(Context * ctx, ContextAddress addr) {
     ELF_File * file = NULL;
     ELF_Section * sec = NULL;
@@ -2533,6 +2739,7 @@ int get_symbol_file_info(Context * ctx, ContextAddress addr, SymbolFileInfo ** i
 static void event_map_changed(Context * ctx, void * args) {
     /* Make sure there is no stale data in the ELF cache */
     elf_invalidate();
+    symbol_handles_on_map_changed(ctx);
 }
 
 static MemoryMapEventListener map_listener = {
@@ -2544,6 +2751,12 @@ static MemoryMapEventListener map_listener = {
 #endif
 
 void ini_symbols_lib(void) {
+    static ContextEventListener ctx_listener = {
+        NULL,
+        symbol_handles_on_context_exited,
+    };
+    add_context_event_listener(&ctx_listener, NULL);
+    elf_add_close_listener(symbol_handles_on_elf_close);
 #if ENABLE_MemoryMap
     add_memory_map_event_listener(&map_listener, NULL);
 #endif
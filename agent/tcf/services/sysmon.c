@@ -1006,7 +1006,11 @@ static void command_get_environment(char * token, Channel * c) {
 #include <unistd.h>
 #include <pwd.h>
 #include <grp.h>
+#include <time.h>
 #include <linux/param.h>
+#include <tcf/framework/asyncreq.h>
+#include <tcf/framework/events.h>
+#include <tcf/framework/link.h>
 
 #define BUF_EOF (-1)
 
@@ -1056,394 +1060,435 @@ static void write_string_array(OutputStream * out, int f) {
     write_stream(out, ']');
 }
 
-static void write_context(OutputStream * out, char * id, char * parent_id, char * dir) {
+/*
+ * Process information that is read from /proc/<pid>.
+ * The data is read without changing current directory and without using static buffers,
+ * so it can be done by a worker thread.
+ */
+typedef struct ProcInfo {
+    pid_t id;
+    char * cwd;
+    char * root;
+    char * exe;
+    int exe_type;               /* -1 if unknown */
+    int has_owner;
+    uid_t uid;
+    gid_t gid;
+    int has_stat;
+    int pid;                    /* The process ID. */
+    char comm[256];             /* The  filename  of  the  executable,  in parentheses.  This is visible */
+                                /* whether or not the executable is swapped out. */
+    char state;                 /* One character from the string "RSDZTW"  where  R  is  running,  S  is */
+                                /* sleeping  in  an  interruptible wait, D is waiting in uninterruptible */
+                                /* disk sleep, Z is zombie, T is traced or stopped (on a signal), and  W */
+                                /* is paging. */
+    int ppid;                   /* The PID of the parent. */
+    int pgrp;                   /* The process group ID of the process. */
+    int session;                /* The session ID of the process. */
+    int tty_nr;                 /* The tty the process uses. */
+    int tpgid;                  /* The process group ID of the process which currently owns the tty that */
+                                /* the process is connected to. */
+    unsigned long flags;        /* The kernel flags word of the process. For bit meanings, see the  PF_* */
+                                /* defines in <linux/sched.h>.  Details depend on the kernel version. */
+    unsigned long minflt;       /* The  number  of  minor  faults  the  process  has made which have not */
+                                /* required loading a memory page from disk. */
+    unsigned long cminflt;      /* The number of minor faults that  the  process's  waited-for  children */
+                                /* have made. */
+    unsigned long majflt;       /* The  number  of major faults the process has made which have required */
+                                /* loading a memory page from disk. */
+    unsigned long cmajflt;      /* The number of major faults that  the  process's  waited-for  children */
+                                /* have made. */
+    unsigned long utime;        /* The  number  of  jiffies that this process has been scheduled in user */
+                                /* mode. */
+    unsigned long stime;        /* The number of jiffies that this process has been scheduled in  kernel */
+                                /* mode. */
+    long cutime;                /* The  number  of  jiffies that this process's waited-for children have */
+                                /* been scheduled in user mode. (See also times(2).) */
+    long cstime;                /* The number of jiffies that this process's  waited-for  children  have */
+                                /* been scheduled in kernel mode. */
+    long priority;              /* The  standard  nice value, plus fifteen.  The value is never negative */
+                                /* in the kernel. */
+    long nice;                  /* The nice value ranges from 19 (nicest) to -19 (not nice to others). */
+    long dummy;                 /* This value is hard coded to 0 as a placeholder for a removed field. */
+    long itrealvalue;           /* The time in jiffies before the next SIGALRM is sent  to  the  process */
+                                /* due to an interval timer. */
+    unsigned long starttime;    /* The time in jiffies the process started after system boot. */
+    unsigned long vsize;        /* Virtual memory size in bytes. */
+    long rss;                   /* Resident  Set  Size:  number of pages the process has in real memory, */
+                                /* minus 3 for administrative purposes. This is  just  the  pages  which */
+                                /* count  towards  text,  data,  or  stack space.  This does not include */
+                                /* pages which have not been demand-loaded in, or which are swapped out. */
+    unsigned long rlim;         /* Current  limit in bytes on the rss of the process (usually 4294967295 */
+                                /* on i386). */
+    unsigned long startcode;    /* The address above which program text can run. */
+    unsigned long endcode;      /* The address below which program text can run. */
+    unsigned long startstack;   /* The address of the start of the stack. */
+    unsigned long kstkesp;      /* The current value of esp (stack pointer),  as  found  in  the  kernel */
+                                /* stack page for the process. */
+    unsigned long kstkeip;      /* The current EIP (instruction pointer). */
+    unsigned long signal;       /* The bitmap of pending signals. */
+    unsigned long blocked;      /* The bitmap of blocked signals. */
+    unsigned long sigignore;    /* The bitmap of ignored signals. */
+    unsigned long sigcatch;     /* The bitmap of caught signals. */
+    unsigned long wchan;        /* This  is  the  "channel"  in which the process is waiting.  It is the */
+                                /* address of a system call, and can be looked up in a namelist  if  you */
+                                /* need  a  textual  name.   (If you have an up-to-date /etc/psdatabase, */
+                                /* then try ps -l to see the WCHAN field in action.) */
+    unsigned long nswap;        /* Number of pages swapped (not maintained). */
+    unsigned long cnswap;       /* Cumulative nswap for child processes (not maintained). */
+    int exit_signal;            /* Signal to be sent to parent when we die. */
+    int processor;              /* CPU number last executed on. */
+    unsigned long rt_priority;  /* Real-time scheduling priority (see sched_setscheduler(2)). */
+    unsigned long policy;       /* Scheduling policy (see sched_setscheduler(2)). */
+} ProcInfo;
+
+static char * read_proc_link(const char * dir, const char * name) {
+    char path[FILE_PATH_SIZE];
     char fnm[FILE_PATH_SIZE + 1];
     int sz;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if ((sz = readlink(path, fnm, FILE_PATH_SIZE)) <= 0) return NULL;
+    fnm[sz] = 0;
+    return loc_strdup(fnm);
+}
+
+static void read_proc_info(const char * dir, ProcInfo * p) {
+    char path[FILE_PATH_SIZE];
+    char bf[1024];
+    struct stat st;
+    int sz;
     int f;
 
+    memset(p, 0, sizeof(ProcInfo));
+    p->exe_type = -1;
+    p->cwd = read_proc_link(dir, "cwd");
+    p->root = read_proc_link(dir, "root");
+    p->exe = read_proc_link(dir, "exe");
+    if (p->exe != NULL) p->exe_type = EXETYPE_USER;
+    else if (errno == ENOENT) p->exe_type = EXETYPE_KERNEL;
+    else if (errno == EACCES) p->exe_type = EXETYPE_ACCESS_DENIED;
+
+    snprintf(path, sizeof(path), "%s/stat", dir);
+    f = open(path, O_RDONLY);
+    if (f < 0) return;
+    if (fstat(f, &st) == 0) {
+        p->has_owner = 1;
+        p->uid = st.st_uid;
+        p->gid = st.st_gid;
+    }
+    memset(bf, 0, sizeof(bf));
+    if ((sz = read(f, bf, sizeof(bf) - 1)) > 0) {
+        char * str = bf;
+
+        p->has_stat = 1;
+        p->pid = (int)strtol(str, &str, 10);
+        while (*str == ' ') str++;
+
+        if (*str == '(') str++;
+        sz = strlen(str);
+        while (sz > 0 && str[sz] != ')') sz--;
+        if (sz >= (int)sizeof(p->comm)) memcpy(p->comm, str, sizeof(p->comm) - 1);
+        else memcpy(p->comm, str, sz);
+        str += sz;
+        if (*str == ')') str++;
+        while (*str == ' ') str++;
+
+        sscanf(str,
+            "%c %d %d %d %d %d %lu %lu %lu %lu %lu %lu %lu %ld %ld %ld %ld %ld %ld %lu %lu %ld %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %d %d %lu %lu",
+            &p->state, &p->ppid, &p->pgrp, &p->session, &p->tty_nr, &p->tpgid, &p->flags,
+            &p->minflt, &p->cminflt, &p->majflt, &p->cmajflt, &p->utime, &p->stime, &p->cutime, &p->cstime,
+            &p->priority, &p->nice, &p->dummy, &p->itrealvalue, &p->starttime, &p->vsize, &p->rss, &p->rlim,
+            &p->startcode, &p->endcode, &p->startstack, &p->kstkesp, &p->kstkeip, &p->signal, &p->blocked,
+            &p->sigignore, &p->sigcatch, &p->wchan, &p->nswap, &p->cnswap, &p->exit_signal, &p->processor,
+            &p->rt_priority, &p->policy);
+    }
+    close(f);
+}
+
+static void free_proc_info(ProcInfo * p) {
+    loc_free(p->cwd);
+    loc_free(p->root);
+    loc_free(p->exe);
+}
+
+static void write_proc_info(OutputStream * out, char * id, char * parent_id, ProcInfo * p) {
     write_stream(out, '{');
 
-    if (chdir(dir) >= 0) {
-        if ((sz = readlink("cwd", fnm, FILE_PATH_SIZE)) > 0) {
-            fnm[sz] = 0;
-            json_write_string(out, "CWD");
+    if (p->cwd != NULL) {
+        json_write_string(out, "CWD");
+        write_stream(out, ':');
+        json_write_string(out, p->cwd);
+        write_stream(out, ',');
+    }
+
+    if (p->root != NULL) {
+        json_write_string(out, "Root");
+        write_stream(out, ':');
+        json_write_string(out, p->root);
+        write_stream(out, ',');
+    }
+
+    if (p->exe != NULL) {
+        json_write_string(out, "Exe");
+        write_stream(out, ':');
+        json_write_string(out, p->exe);
+        write_stream(out, ',');
+    }
+
+    if (p->exe_type >= 0) {
+        json_write_string(out, "ExeType");
+        write_stream(out, ':');
+        json_write_long(out, p->exe_type);
+        write_stream(out, ',');
+    }
+
+    if (p->has_owner) {
+        struct passwd * pwd;
+        struct group * grp;
+
+        json_write_string(out, "UID");
+        write_stream(out, ':');
+        json_write_long(out, p->uid);
+        write_stream(out, ',');
+
+        json_write_string(out, "UGID");
+        write_stream(out, ':');
+        json_write_long(out, p->gid);
+        write_stream(out, ',');
+
+        pwd = getpwuid(p->uid);
+        if (pwd != NULL) {
+            json_write_string(out, "UserName");
             write_stream(out, ':');
-            json_write_string(out, fnm);
+            json_write_string(out, pwd->pw_name);
             write_stream(out, ',');
         }
 
-        if ((sz = readlink("root", fnm, FILE_PATH_SIZE)) > 0) {
-            fnm[sz] = 0;
-            json_write_string(out, "Root");
+        grp = getgrgid(p->gid);
+        if (grp != NULL) {
+            json_write_string(out, "GroupName");
             write_stream(out, ':');
-            json_write_string(out, fnm);
+            json_write_string(out, grp->gr_name);
             write_stream(out, ',');
         }
+    }
+
+    if (p->has_stat) {
+        json_write_string(out, "PID");
+        write_stream(out, ':');
+        json_write_long(out, p->pid);
+        write_stream(out, ',');
 
-        if ((sz = readlink("exe", fnm, FILE_PATH_SIZE)) > 0) {
-            fnm[sz] = 0;
-            json_write_string(out, "Exe");
+        json_write_string(out, "File");
+        write_stream(out, ':');
+        json_write_string(out, p->comm);
+        write_stream(out, ',');
+
+        json_write_string(out, "State");
+        write_stream(out, ':');
+        write_stream(out, '"');
+        json_write_char(out, p->state);
+        write_stream(out, '"');
+        write_stream(out, ',');
+
+        if (p->ppid > 0) {
+            json_write_string(out, "PPID");
             write_stream(out, ':');
-            json_write_string(out, fnm);
+            json_write_long(out, p->ppid);
             write_stream(out, ',');
-            json_write_string(out, "ExeType");
+        }
+
+        json_write_string(out, "PGRP");
+        write_stream(out, ':');
+        json_write_long(out, p->pgrp);
+        write_stream(out, ',');
+
+        json_write_string(out, "Session");
+        write_stream(out, ':');
+        json_write_long(out, p->session);
+        write_stream(out, ',');
+
+        if (p->tty_nr > 0) {
+            json_write_string(out, "TTY");
             write_stream(out, ':');
-            json_write_long(out, EXETYPE_USER);
+            json_write_long(out, p->tty_nr);
             write_stream(out, ',');
         }
-        else if (errno == ENOENT) {
-            json_write_string(out, "ExeType");
+
+        if (p->tpgid > 0) {
+            json_write_string(out, "TGID");
             write_stream(out, ':');
-            json_write_long(out, EXETYPE_KERNEL);
+            json_write_long(out, p->tpgid);
             write_stream(out, ',');
         }
-        else if (errno == EACCES) {
-            json_write_string(out, "ExeType");
+
+        json_write_string(out, "Flags");
+        write_stream(out, ':');
+        json_write_ulong(out, p->flags);
+        write_stream(out, ',');
+
+        json_write_string(out, "MinFlt");
+        write_stream(out, ':');
+        json_write_ulong(out, p->minflt);
+        write_stream(out, ',');
+
+        json_write_string(out, "CMinFlt");
+        write_stream(out, ':');
+        json_write_ulong(out, p->cminflt);
+        write_stream(out, ',');
+
+        json_write_string(out, "MajFlt");
+        write_stream(out, ':');
+        json_write_ulong(out, p->majflt);
+        write_stream(out, ',');
+
+        json_write_string(out, "CMajFlt");
+        write_stream(out, ':');
+        json_write_ulong(out, p->cmajflt);
+        write_stream(out, ',');
+
+        json_write_string(out, "UTime");
+        write_stream(out, ':');
+        json_write_uint64(out, (uint64_t)p->utime * 1000 / HZ);
+        write_stream(out, ',');
+
+        json_write_string(out, "STime");
+        write_stream(out, ':');
+        json_write_uint64(out, (uint64_t)p->stime * 1000 / HZ);
+        write_stream(out, ',');
+
+        json_write_string(out, "CUTime");
+        write_stream(out, ':');
+        json_write_uint64(out, (uint64_t)p->cutime * 1000 / HZ);
+        write_stream(out, ',');
+
+        json_write_string(out, "CSTime");
+        write_stream(out, ':');
+        json_write_uint64(out, (uint64_t)p->cstime * 1000 / HZ);
+        write_stream(out, ',');
+
+        json_write_string(out, "Priority");
+        write_stream(out, ':');
+        json_write_long(out, (long)p->priority - 15);
+        write_stream(out, ',');
+
+        if (p->nice != 0) {
+            json_write_string(out, "Nice");
             write_stream(out, ':');
-            json_write_long(out, EXETYPE_ACCESS_DENIED);
+            json_write_long(out, p->nice);
             write_stream(out, ',');
         }
 
-        f = open("stat", O_RDONLY);
-        if (f >= 0) {
-            struct stat st;
-            if (fstat(f, &st) == 0) {
-                struct passwd * pwd;
-                struct group * grp;
-
-                json_write_string(out, "UID");
-                write_stream(out, ':');
-                json_write_long(out, st.st_uid);
-                write_stream(out, ',');
-
-                json_write_string(out, "UGID");
-                write_stream(out, ':');
-                json_write_long(out, st.st_gid);
-                write_stream(out, ',');
-
-                pwd = getpwuid(st.st_uid);
-                if (pwd != NULL) {
-                    json_write_string(out, "UserName");
-                    write_stream(out, ':');
-                    json_write_string(out, pwd->pw_name);
-                    write_stream(out, ',');
-                }
+        if (p->itrealvalue != 0) {
+            json_write_string(out, "ITRealValue");
+            write_stream(out, ':');
+            json_write_int64(out, (int64_t)p->itrealvalue * 1000 / HZ);
+            write_stream(out, ',');
+        }
 
-                grp = getgrgid(st.st_gid);
-                if (grp != NULL) {
-                    json_write_string(out, "GroupName");
-                    write_stream(out, ':');
-                    json_write_string(out, grp->gr_name);
-                    write_stream(out, ',');
-                }
-            }
+        json_write_string(out, "StartTime");
+        write_stream(out, ':');
+        json_write_uint64(out, (uint64_t)p->starttime * 1000 / HZ);
+        write_stream(out, ',');
 
-            memset(buf, 0, sizeof(buf));
-            if ((sz = read(f, buf, sizeof(buf) - 1)) > 0) {
-                char * str = buf;
-                int pid = 0;                /* The process ID. */
-                char * comm = fnm;          /* The  filename  of  the  executable,  in parentheses.  This is visible */
-                                            /* whether or not the executable is swapped out. */
-                char state = 0;             /* One character from the string "RSDZTW"  where  R  is  running,  S  is */
-                                            /* sleeping  in  an  interruptible wait, D is waiting in uninterruptible */
-                                            /* disk sleep, Z is zombie, T is traced or stopped (on a signal), and  W */
-                                            /* is paging. */
-                int ppid = 0;               /* The PID of the parent. */
-                int pgrp = 0;               /* The process group ID of the process. */
-                int session = 0;            /* The session ID of the process. */
-                int tty_nr = 0;             /* The tty the process uses. */
-                int tpgid = 0;              /* The process group ID of the process which currently owns the tty that */
-                                            /* the process is connected to. */
-                unsigned long flags = 0;    /* The kernel flags word of the process. For bit meanings, see the  PF_* */
-                                            /* defines in <linux/sched.h>.  Details depend on the kernel version. */
-                unsigned long minflt = 0;   /* The  number  of  minor  faults  the  process  has made which have not */
-                                            /* required loading a memory page from disk. */
-                unsigned long cminflt = 0;  /* The number of minor faults that  the  process's  waited-for  children */
-                                            /* have made. */
-                unsigned long majflt = 0;   /* The  number  of major faults the process has made which have required */
-                                            /* loading a memory page from disk. */
-                unsigned long cmajflt = 0;  /* The number of major faults that  the  process's  waited-for  children */
-                                            /* have made. */
-                unsigned long utime = 0;    /* The  number  of  jiffies that this process has been scheduled in user */
-                                            /* mode. */
-                unsigned long stime = 0;    /* The number of jiffies that this process has been scheduled in  kernel */
-                                            /* mode. */
-                long cutime = 0;            /* The  number  of  jiffies that this process's waited-for children have */
-                                            /* been scheduled in user mode. (See also times(2).) */
-                long cstime = 0;            /* The number of jiffies that this process's  waited-for  children  have */
-                                            /* been scheduled in kernel mode. */
-                long priority = 0;          /* The  standard  nice value, plus fifteen.  The value is never negative */
-                                            /* in the kernel. */
-                long nice = 0;              /* The nice value ranges from 19 (nicest) to -19 (not nice to others). */
-                long dummy = 0;             /* This value is hard coded to 0 as a placeholder for a removed field. */
-                long itrealvalue = 0;       /* The time in jiffies before the next SIGALRM is sent  to  the  process */
-                                            /* due to an interval timer. */
-                unsigned long starttime = 0;/* The time in jiffies the process started after system boot. */
-                unsigned long vsize = 0;    /* Virtual memory size in bytes. */
-                long rss = 0;               /* Resident  Set  Size:  number of pages the process has in real memory, */
-                                            /* minus 3 for administrative purposes. This is  just  the  pages  which */
-                                            /* count  towards  text,  data,  or  stack space.  This does not include */
-                                            /* pages which have not been demand-loaded in, or which are swapped out. */
-                unsigned long rlim = 0;     /* Current  limit in bytes on the rss of the process (usually 4294967295 */
-                                            /* on i386). */
-                unsigned long startcode = 0;/* The address above which program text can run. */
-                unsigned long endcode = 0;  /* The address below which program text can run. */
-                unsigned long startstack =0;/* The address of the start of the stack. */
-                unsigned long kstkesp = 0;  /* The current value of esp (stack pointer),  as  found  in  the  kernel */
-                                            /* stack page for the process. */
-                unsigned long kstkeip = 0;  /* The current EIP (instruction pointer). */
-                unsigned long signal = 0;   /* The bitmap of pending signals. */
-                unsigned long blocked = 0;  /* The bitmap of blocked signals. */
-                unsigned long sigignore = 0;/* The bitmap of ignored signals. */
-                unsigned long sigcatch = 0; /* The bitmap of caught signals. */
-                unsigned long wchan = 0;    /* This  is  the  "channel"  in which the process is waiting.  It is the */
-                                            /* address of a system call, and can be looked up in a namelist  if  you */
-                                            /* need  a  textual  name.   (If you have an up-to-date /etc/psdatabase, */
-                                            /* then try ps -l to see the WCHAN field in action.) */
-                unsigned long nswap = 0;    /* Number of pages swapped (not maintained). */
-                unsigned long cnswap = 0;   /* Cumulative nswap for child processes (not maintained). */
-                int exit_signal = 0;        /* Signal to be sent to parent when we die. */
-                int processor = 0;          /* CPU number last executed on. */
-                unsigned long rt_priority=0;/* Real-time scheduling priority (see sched_setscheduler(2)). */
-                unsigned long policy = 0;   /* Scheduling policy (see sched_setscheduler(2)). */
-
-                pid = (int)strtol(str, &str, 10);
-                while (*str == ' ') str++;
-
-                if (*str == '(') str++;
-                sz = strlen(str);
-                while (sz > 0 && str[sz] != ')') sz--;
-                memcpy(comm, str, sz);
-                comm[sz] = 0;
-                str += sz;
-                if (*str == ')') str++;
-                while (*str == ' ') str++;
-
-                sscanf(str,
-                    "%c %d %d %d %d %d %lu %lu %lu %lu %lu %lu %lu %ld %ld %ld %ld %ld %ld %lu %lu %ld %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %d %d %lu %lu",
-                    &state, &ppid, &pgrp, &session, &tty_nr, &tpgid, &flags,
-                    &minflt, &cminflt, &majflt, &cmajflt, &utime, &stime, &cutime, &cstime,
-                    &priority, &nice, &dummy, &itrealvalue, &starttime, &vsize, &rss, &rlim,
-                    &startcode, &endcode, &startstack, &kstkesp, &kstkeip, &signal, &blocked, &sigignore, &sigcatch,
-                    &wchan, &nswap, &cnswap, &exit_signal, &processor, &rt_priority, &policy);
-
-                json_write_string(out, "PID");
-                write_stream(out, ':');
-                json_write_long(out, pid);
-                write_stream(out, ',');
-
-                json_write_string(out, "File");
-                write_stream(out, ':');
-                json_write_string(out, comm);
-                write_stream(out, ',');
-
-                json_write_string(out, "State");
-                write_stream(out, ':');
-                write_stream(out, '"');
-                json_write_char(out, state);
-                write_stream(out, '"');
-                write_stream(out, ',');
-
-                if (ppid > 0) {
-                    json_write_string(out, "PPID");
-                    write_stream(out, ':');
-                    json_write_long(out, ppid);
-                    write_stream(out, ',');
-                }
+        json_write_string(out, "VSize");
+        write_stream(out, ':');
+        json_write_ulong(out, p->vsize);
+        write_stream(out, ',');
 
-                json_write_string(out, "PGRP");
-                write_stream(out, ':');
-                json_write_long(out, pgrp);
-                write_stream(out, ',');
-
-                json_write_string(out, "Session");
-                write_stream(out, ':');
-                json_write_long(out, session);
-                write_stream(out, ',');
-
-                if (tty_nr > 0) {
-                    json_write_string(out, "TTY");
-                    write_stream(out, ':');
-                    json_write_long(out, tty_nr);
-                    write_stream(out, ',');
-                }
+        json_write_string(out, "PSize");
+        write_stream(out, ':');
+        json_write_ulong(out, getpagesize());
+        write_stream(out, ',');
 
-                if (tpgid > 0) {
-                    json_write_string(out, "TGID");
-                    write_stream(out, ':');
-                    json_write_long(out, tpgid);
-                    write_stream(out, ',');
-                }
+        json_write_string(out, "RSS");
+        write_stream(out, ':');
+        json_write_long(out, p->rss);
+        write_stream(out, ',');
 
-                json_write_string(out, "Flags");
-                write_stream(out, ':');
-                json_write_ulong(out, flags);
-                write_stream(out, ',');
-
-                json_write_string(out, "MinFlt");
-                write_stream(out, ':');
-                json_write_ulong(out, minflt);
-                write_stream(out, ',');
-
-                json_write_string(out, "CMinFlt");
-                write_stream(out, ':');
-                json_write_ulong(out, cminflt);
-                write_stream(out, ',');
-
-                json_write_string(out, "MajFlt");
-                write_stream(out, ':');
-                json_write_ulong(out, majflt);
-                write_stream(out, ',');
-
-                json_write_string(out, "CMajFlt");
-                write_stream(out, ':');
-                json_write_ulong(out, cmajflt);
-                write_stream(out, ',');
-
-                json_write_string(out, "UTime");
-                write_stream(out, ':');
-                json_write_uint64(out, (uint64_t)utime * 1000 / HZ);
-                write_stream(out, ',');
-
-                json_write_string(out, "STime");
-                write_stream(out, ':');
-                json_write_uint64(out, (uint64_t)stime * 1000 / HZ);
-                write_stream(out, ',');
-
-                json_write_string(out, "CUTime");
-                write_stream(out, ':');
-                json_write_uint64(out, (uint64_t)cutime * 1000 / HZ);
-                write_stream(out, ',');
-
-                json_write_string(out, "CSTime");
-                write_stream(out, ':');
-                json_write_uint64(out, (uint64_t)cstime * 1000 / HZ);
-                write_stream(out, ',');
-
-                json_write_string(out, "Priority");
-                write_stream(out, ':');
-                json_write_long(out, (long)priority - 15);
-                write_stream(out, ',');
-
-                if (nice != 0) {
-                    json_write_string(out, "Nice");
-                    write_stream(out, ':');
-                    json_write_long(out, nice);
-                    write_stream(out, ',');
-                }
+        json_write_string(out, "RLimit");
+        write_stream(out, ':');
+        json_write_ulong(out, p->rlim);
+        write_stream(out, ',');
 
-                if (itrealvalue != 0) {
-                    json_write_string(out, "ITRealValue");
-                    write_stream(out, ':');
-                    json_write_int64(out, (int64_t)itrealvalue * 1000 / HZ);
-                    write_stream(out, ',');
-                }
+        if (p->startcode != 0) {
+            json_write_string(out, "CodeStart");
+            write_stream(out, ':');
+            json_write_ulong(out, p->startcode);
+            write_stream(out, ',');
+        }
 
-                json_write_string(out, "StartTime");
-                write_stream(out, ':');
-                json_write_uint64(out, (uint64_t)starttime * 1000 / HZ);
-                write_stream(out, ',');
-
-                json_write_string(out, "VSize");
-                write_stream(out, ':');
-                json_write_ulong(out, vsize);
-                write_stream(out, ',');
-
-                json_write_string(out, "PSize");
-                write_stream(out, ':');
-                json_write_ulong(out, getpagesize());
-                write_stream(out, ',');
-
-                json_write_string(out, "RSS");
-                write_stream(out, ':');
-                json_write_long(out, rss);
-                write_stream(out, ',');
-
-                json_write_string(out, "RLimit");
-                write_stream(out, ':');
-                json_write_ulong(out, rlim);
-                write_stream(out, ',');
-
-                if (startcode != 0) {
-                    json_write_string(out, "CodeStart");
-                    write_stream(out, ':');
-                    json_write_ulong(out, startcode);
-                    write_stream(out, ',');
-                }
+        if (p->endcode != 0) {
+            json_write_string(out, "CodeEnd");
+            write_stream(out, ':');
+            json_write_ulong(out, p->endcode);
+            write_stream(out, ',');
+        }
 
-                if (endcode != 0) {
-                    json_write_string(out, "CodeEnd");
-                    write_stream(out, ':');
-                    json_write_ulong(out, endcode);
-                    write_stream(out, ',');
-                }
+        if (p->startstack != 0) {
+            json_write_string(out, "StackStart");
+            write_stream(out, ':');
+            json_write_ulong(out, p->startstack);
+            write_stream(out, ',');
+        }
 
-                if (startstack != 0) {
-                    json_write_string(out, "StackStart");
-                    write_stream(out, ':');
-                    json_write_ulong(out, startstack);
-                    write_stream(out, ',');
-                }
+        json_write_string(out, "Signals");
+        write_stream(out, ':');
+        json_write_ulong(out, p->signal);
+        write_stream(out, ',');
 
-                json_write_string(out, "Signals");
-                write_stream(out, ':');
-                json_write_ulong(out, signal);
-                write_stream(out, ',');
-
-                json_write_string(out, "SigBlock");
-                write_stream(out, ':');
-                json_write_ulong(out, blocked);
-                write_stream(out, ',');
-
-                json_write_string(out, "SigIgnore");
-                write_stream(out, ':');
-                json_write_ulong(out, sigignore);
-                write_stream(out, ',');
-
-                json_write_string(out, "SigCatch");
-                write_stream(out, ':');
-                json_write_ulong(out, sigcatch);
-                write_stream(out, ',');
-
-                if (wchan != 0) {
-                    json_write_string(out, "WChan");
-                    write_stream(out, ':');
-                    json_write_ulong(out, wchan);
-                    write_stream(out, ',');
-                }
+        json_write_string(out, "SigBlock");
+        write_stream(out, ':');
+        json_write_ulong(out, p->blocked);
+        write_stream(out, ',');
 
-                json_write_string(out, "NSwap");
-                write_stream(out, ':');
-                json_write_ulong(out, nswap);
-                write_stream(out, ',');
-
-                json_write_string(out, "CNSwap");
-                write_stream(out, ':');
-                json_write_ulong(out, cnswap);
-                write_stream(out, ',');
-
-                json_write_string(out, "ExitSignal");
-                write_stream(out, ':');
-                json_write_long(out, exit_signal);
-                write_stream(out, ',');
-
-                json_write_string(out, "Processor");
-                write_stream(out, ':');
-                json_write_long(out, processor);
-                write_stream(out, ',');
-
-                json_write_string(out, "RTPriority");
-                write_stream(out, ':');
-                json_write_ulong(out, rt_priority);
-                write_stream(out, ',');
-
-                json_write_string(out, "Policy");
-                write_stream(out, ':');
-                json_write_ulong(out, policy);
-                write_stream(out, ',');
-            }
-            close(f);
+        json_write_string(out, "SigIgnore");
+        write_stream(out, ':');
+        json_write_ulong(out, p->sigignore);
+        write_stream(out, ',');
+
+        json_write_string(out, "SigCatch");
+        write_stream(out, ':');
+        json_write_ulong(out, p->sigcatch);
+        write_stream(out, ',');
+
+        if (p->wchan != 0) {
+            json_write_string(out, "WChan");
+            write_stream(out, ':');
+            json_write_ulong(out, p->wchan);
+            write_stream(out, ',');
         }
+
+        json_write_string(out, "NSwap");
+        write_stream(out, ':');
+        json_write_ulong(out, p->nswap);
+        write_stream(out, ',');
+
+        json_write_string(out, "CNSwap");
+        write_stream(out, ':');
+        json_write_ulong(out, p->cnswap);
+        write_stream(out, ',');
+
+        json_write_string(out, "ExitSignal");
+        write_stream(out, ':');
+        json_write_long(out, p->exit_signal);
+        write_stream(out, ',');
+
+        json_write_string(out, "Processor");
+        write_stream(out, ':');
+        json_write_long(out, p->processor);
+        write_stream(out, ',');
+
+        json_write_string(out, "RTPriority");
+        write_stream(out, ':');
+        json_write_ulong(out, p->rt_priority);
+        write_stream(out, ',');
+
+        json_write_string(out, "Policy");
+        write_stream(out, ':');
+        json_write_ulong(out, p->policy);
+        write_stream(out, ',');
     }
 
     if (parent_id != NULL && parent_id[0] != 0) {
@@ -1460,12 +1505,387 @@ static void write_context(OutputStream * out, char * id, char * parent_id, char
     write_stream(out, '}');
 }
 
+#if ENABLE_SysMonSampler
+
+/*
+ * Background process sampler.
+ * While there are subscribed clients, a worker thread periodically scans /proc and builds a snapshot of all processes.
+ * getContext and getChildren requests for processes are served from the latest snapshot,
+ * and subscribed clients receive events with differences between consecutive snapshots.
+ */
+
+#define SAMPLER_MIN_PERIOD      100
+#define SAMPLER_DEFAULT_PERIOD  1000
+
+typedef struct ProcSnapshot {
+    ProcInfo * procs;           /* Sorted by process ID */
+    unsigned cnt;
+    uint64_t time;              /* Milliseconds, monotonic clock */
+} ProcSnapshot;
+
+typedef struct SysMonSubscriber {
+    LINK link;
+    Channel * channel;
+    unsigned period;
+} SysMonSubscriber;
+
+#define link2subscriber(A) ((SysMonSubscriber *)((char *)(A) - offsetof(SysMonSubscriber, link)))
+
+static LINK subscribers = TCF_LIST_INIT(subscribers);
+static ProcSnapshot * snapshot = NULL;
+static ProcSnapshot * next_snapshot = NULL;
+static AsyncReqInfo sampler_req;
+static int sampler_active = 0;
+
+static int cmp_proc_info(const void * x, const void * y) {
+    const ProcInfo * a = (const ProcInfo *)x;
+    const ProcInfo * b = (const ProcInfo *)y;
+    if (a->id < b->id) return -1;
+    if (a->id > b->id) return +1;
+    return 0;
+}
+
+static void free_snapshot(ProcSnapshot * s) {
+    unsigned i;
+    if (s == NULL) return;
+    for (i = 0; i < s->cnt; i++) free_proc_info(s->procs + i);
+    loc_free(s->procs);
+    loc_free(s);
+}
+
+static int sampler_scan(void * args) {
+    /* Worker thread: read all processes */
+    ProcSnapshot * s = (ProcSnapshot *)loc_alloc_zero(sizeof(ProcSnapshot));
+    unsigned max = 0;
+    struct timespec ts;
+    DIR * proc = opendir("/proc");
+
+    if (proc != NULL) {
+        for (;;) {
+            char dir[sizeof("/proc/") + NAME_MAX];
+            struct dirent * ent = readdir(proc);
+            if (ent == NULL) break;
+            if (ent->d_name[0] < '1' || ent->d_name[0] > '9') continue;
+            if (s->cnt >= max) {
+                max = max == 0 ? 256 : max * 2;
+                s->procs = (ProcInfo *)loc_realloc(s->procs, sizeof(ProcInfo) * max);
+            }
+            snprintf(dir, sizeof(dir), "/proc/%s", ent->d_name);
+            read_proc_info(dir, s->procs + s->cnt);
+            if (!s->procs[s->cnt].has_stat) {
+                /* The process has exited */
+                free_proc_info(s->procs + s->cnt);
+                continue;
+            }
+            s->procs[s->cnt++].id = (pid_t)atol(ent->d_name);
+        }
+        closedir(proc);
+    }
+    if (s->cnt > 0) qsort(s->procs, s->cnt, sizeof(ProcInfo), cmp_proc_info);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    s->time = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    next_snapshot = s;
+    return 0;
+}
+
+static ProcInfo * find_proc_info(pid_t pid) {
+    unsigned l = 0;
+    unsigned h = 0;
+    if (snapshot == NULL) return NULL;
+    h = snapshot->cnt;
+    while (l < h) {
+        unsigned k = (l + h) / 2;
+        ProcInfo * p = snapshot->procs + k;
+        if (p->id == pid) return p;
+        if (p->id < pid) l = k + 1;
+        else h = k;
+    }
+    return NULL;
+}
+
+static int is_proc_changed(ProcInfo * x, ProcInfo * y) {
+    return x->state != y->state || x->utime != y->utime || x->stime != y->stime ||
+        x->rss != y->rss || x->vsize != y->vsize || x->minflt != y->minflt || x->majflt != y->majflt ||
+        x->priority != y->priority || x->nice != y->nice || x->processor != y->processor || x->ppid != y->ppid;
+}
+
+static void write_proc_changes(OutputStream * out, ProcInfo * x, ProcInfo * y, uint64_t period) {
+    /* Changed fields and rates: CPU usage in percents of one CPU, RSS change in bytes per second */
+    double cpu = 0;
+    double rss_rate = 0;
+
+    if (period > 0) {
+        cpu = (double)((y->utime + y->stime) - (x->utime + x->stime)) * 1000 / HZ * 100 / period;
+        rss_rate = (double)(y->rss - x->rss) * getpagesize() * 1000 / period;
+    }
+
+    write_stream(out, '{');
+    json_write_string(out, "ID");
+    write_stream(out, ':');
+    json_write_string(out, pid2id(y->id, 0));
+    if (x->state != y->state) {
+        write_stream(out, ',');
+        json_write_string(out, "State");
+        write_stream(out, ':');
+        write_stream(out, '"');
+        json_write_char(out, y->state);
+        write_stream(out, '"');
+    }
+    if (x->ppid != y->ppid) {
+        write_stream(out, ',');
+        json_write_string(out, "PPID");
+        write_stream(out, ':');
+        json_write_long(out, y->ppid);
+    }
+    if (x->utime != y->utime) {
+        write_stream(out, ',');
+        json_write_string(out, "UTime");
+        write_stream(out, ':');
+        json_write_uint64(out, (uint64_t)y->utime * 1000 / HZ);
+    }
+    if (x->stime != y->stime) {
+        write_stream(out, ',');
+        json_write_string(out, "STime");
+        write_stream(out, ':');
+        json_write_uint64(out, (uint64_t)y->stime * 1000 / HZ);
+    }
+    if (x->minflt != y->minflt) {
+        write_stream(out, ',');
+        json_write_string(out, "MinFlt");
+        write_stream(out, ':');
+        json_write_ulong(out, y->minflt);
+    }
+    if (x->majflt != y->majflt) {
+        write_stream(out, ',');
+        json_write_string(out, "MajFlt");
+        write_stream(out, ':');
+        json_write_ulong(out, y->majflt);
+    }
+    if (x->priority != y->priority) {
+        write_stream(out, ',');
+        json_write_string(out, "Priority");
+        write_stream(out, ':');
+        json_write_long(out, (long)y->priority - 15);
+    }
+    if (x->nice != y->nice) {
+        write_stream(out, ',');
+        json_write_string(out, "Nice");
+        write_stream(out, ':');
+        json_write_long(out, y->nice);
+    }
+    if (x->processor != y->processor) {
+        write_stream(out, ',');
+        json_write_string(out, "Processor");
+        write_stream(out, ':');
+        json_write_long(out, y->processor);
+    }
+    if (x->vsize != y->vsize) {
+        write_stream(out, ',');
+        json_write_string(out, "VSize");
+        write_stream(out, ':');
+        json_write_ulong(out, y->vsize);
+    }
+    if (x->rss != y->rss) {
+        write_stream(out, ',');
+        json_write_string(out, "RSS");
+        write_stream(out, ':');
+        json_write_long(out, y->rss);
+    }
+    write_stream(out, ',');
+    json_write_string(out, "CPUUsage");
+    write_stream(out, ':');
+    json_write_double(out, cpu);
+    write_stream(out, ',');
+    json_write_string(out, "RSSRate");
+    write_stream(out, ':');
+    json_write_double(out, rss_rate);
+    write_stream(out, '}');
+}
+
+static int is_same_proc(ProcInfo * x, ProcInfo * y) {
+    /* Same process ID with different start time is a new process */
+    return x->id == y->id && x->starttime == y->starttime;
+}
+
+static void write_delta_events(OutputStream * out, ProcSnapshot * x, ProcSnapshot * y) {
+    /* Events are sent only if they have at least one item */
+    unsigned i, j, cnt;
+    uint64_t period = y->time - x->time;
+
+    for (i = j = cnt = 0; i < x->cnt; i++) {
+        while (j < y->cnt && y->procs[j].id < x->procs[i].id) j++;
+        if (j < y->cnt && is_same_proc(x->procs + i, y->procs + j)) continue;
+        if (cnt++ == 0) {
+            write_stringz(out, "E");
+            write_stringz(out, SYS_MON);
+            write_stringz(out, "contextRemoved");
+            write_stream(out, '[');
+        }
+        else {
+            write_stream(out, ',');
+        }
+        json_write_string(out, pid2id(x->procs[i].id, 0));
+    }
+    if (cnt > 0) {
+        write_stream(out, ']');
+        write_stream(out, 0);
+        write_stream(out, MARKER_EOM);
+    }
+
+    for (i = j = cnt = 0; j < y->cnt; j++) {
+        while (i < x->cnt && x->procs[i].id < y->procs[j].id) i++;
+        if (i < x->cnt && is_same_proc(x->procs + i, y->procs + j)) continue;
+        if (cnt++ == 0) {
+            write_stringz(out, "E");
+            write_stringz(out, SYS_MON);
+            write_stringz(out, "contextAdded");
+            write_stream(out, '[');
+        }
+        else {
+            write_stream(out, ',');
+        }
+        write_proc_info(out, pid2id(y->procs[j].id, 0), NULL, y->procs + j);
+    }
+    if (cnt > 0) {
+        write_stream(out, ']');
+        write_stream(out, 0);
+        write_stream(out, MARKER_EOM);
+    }
+
+    for (i = j = cnt = 0; j < y->cnt; j++) {
+        while (i < x->cnt && x->procs[i].id < y->procs[j].id) i++;
+        if (i >= x->cnt || !is_same_proc(x->procs + i, y->procs + j)) continue;
+        if (!is_proc_changed(x->procs + i, y->procs + j)) continue;
+        if (cnt++ == 0) {
+            write_stringz(out, "E");
+            write_stringz(out, SYS_MON);
+            write_stringz(out, "contextChanged");
+            write_stream(out, '[');
+        }
+        else {
+            write_stream(out, ',');
+        }
+        write_proc_changes(out, x->procs + i, y->procs + j, period);
+    }
+    if (cnt > 0) {
+        write_stream(out, ']');
+        write_stream(out, 0);
+        write_stream(out, MARKER_EOM);
+    }
+}
+
+static unsigned get_sampler_period(void) {
+    LINK * l;
+    unsigned period = 0;
+    for (l = subscribers.next; l != &subscribers; l = l->next) {
+        SysMonSubscriber * s = link2subscriber(l);
+        if (period == 0 || s->period < period) period = s->period;
+    }
+    return period;
+}
+
+static void sampler_start(void * args) {
+    if (list_is_empty(&subscribers)) {
+        sampler_active = 0;
+        free_snapshot(snapshot);
+        snapshot = NULL;
+        return;
+    }
+    async_req_post(&sampler_req);
+}
+
+static void sampler_done(void * args) {
+    ProcSnapshot * s = next_snapshot;
+    LINK * l;
+
+    next_snapshot = NULL;
+    if (snapshot != NULL) {
+        for (l = subscribers.next; l != &subscribers; l = l->next) {
+            SysMonSubscriber * h = link2subscriber(l);
+            write_delta_events(&h->channel->out, snapshot, s);
+        }
+    }
+    free_snapshot(snapshot);
+    snapshot = s;
+    post_event_with_delay(sampler_start, NULL, (unsigned long)get_sampler_period() * 1000);
+}
+
+static void command_subscribe(char * token, Channel * c) {
+    SysMonSubscriber * s = NULL;
+    unsigned period = 0;
+    LINK * l;
+
+    period = (unsigned)json_read_ulong(&c->inp);
+    json_test_char(&c->inp, MARKER_EOA);
+    json_test_char(&c->inp, MARKER_EOM);
+
+    if (period == 0) period = SAMPLER_DEFAULT_PERIOD;
+    if (period < SAMPLER_MIN_PERIOD) period = SAMPLER_MIN_PERIOD;
+    for (l = subscribers.next; l != &subscribers; l = l->next) {
+        SysMonSubscriber * h = link2subscriber(l);
+        if (h->channel == c) s = h;
+    }
+    if (s == NULL) {
+        s = (SysMonSubscriber *)loc_alloc_zero(sizeof(SysMonSubscriber));
+        s->channel = c;
+        list_add_last(&s->link, &subscribers);
+    }
+    s->period = period;
+
+    write_stringz(&c->out, "R");
+    write_stringz(&c->out, token);
+    write_errno(&c->out, 0);
+    write_stream(&c->out, MARKER_EOM);
+
+    if (!sampler_active) {
+        sampler_active = 1;
+        sampler_req.type = AsyncReqUser;
+        sampler_req.done = sampler_done;
+        sampler_req.u.user.func = sampler_scan;
+        async_req_post(&sampler_req);
+    }
+}
+
+static void unsubscribe(Channel * c) {
+    LINK * l;
+    for (l = subscribers.next; l != &subscribers; l = l->next) {
+        SysMonSubscriber * s = link2subscriber(l);
+        if (s->channel == c) {
+            list_remove(&s->link);
+            loc_free(s);
+            break;
+        }
+    }
+}
+
+static void command_unsubscribe(char * token, Channel * c) {
+    json_test_char(&c->inp, MARKER_EOM);
+
+    unsubscribe(c);
+
+    write_stringz(&c->out, "R");
+    write_stringz(&c->out, token);
+    write_errno(&c->out, 0);
+    write_stream(&c->out, MARKER_EOM);
+}
+
+static void channel_close_listener(Channel * c) {
+    unsubscribe(c);
+}
+
+#else
+
+#define find_proc_info(pid) ((ProcInfo *)NULL)
+
+#endif /* ENABLE_SysMonSampler */
+
 static void command_get_context(char * token, Channel * c) {
     char id[256];
     pid_t pid = 0;
     pid_t parent = 0;
     int err = 0;
     char dir[FILE_PATH_SIZE];
+    ProcInfo * p = NULL;
 
     json_read_string(&c->inp, id, sizeof(id));
     json_test_char(&c->inp, MARKER_EOA);
@@ -1475,7 +1895,8 @@ static void command_get_context(char * token, Channel * c) {
     write_stringz(&c->out, token);
 
     pid = id2pid(id, &parent);
-    if (pid != 0) {
+    if (pid != 0 && parent == 0) p = find_proc_info(pid);
+    if (pid != 0 && p == NULL) {
         struct stat st;
         if (parent != 0) {
             snprintf(dir, sizeof(dir), "/proc/%d/task/%d", parent, pid);
@@ -1489,9 +1910,16 @@ static void command_get_context(char * token, Channel * c) {
 
     write_errno(&c->out, err);
 
-    if (err == 0 && pid != 0) {
+    if (p != NULL) {
+        write_proc_info(&c->out, id, NULL, p);
+        write_stream(&c->out, 0);
+    }
+    else if (err == 0 && pid != 0) {
         char bf[256];
-        write_context(&c->out, id, parent == 0 ? NULL : strcpy(bf, pid2id(parent, 0)), dir);
+        ProcInfo info;
+        read_proc_info(dir, &info);
+        write_proc_info(&c->out, id, parent == 0 ? NULL : strcpy(bf, pid2id(parent, 0)), &info);
+        free_proc_info(&info);
         write_stream(&c->out, 0);
     }
     else {
@@ -1519,6 +1947,19 @@ static void command_get_children(char * token, Channel * c) {
         write_errno(&c->out, 0);
         write_stringz(&c->out, "null");
     }
+#if ENABLE_SysMonSampler
+    else if (pid == 0 && snapshot != NULL) {
+        unsigned i;
+        write_errno(&c->out, 0);
+        write_stream(&c->out, '[');
+        for (i = 0; i < snapshot->cnt; i++) {
+            if (i > 0) write_stream(&c->out, ',');
+            json_write_string(&c->out, pid2id(snapshot->procs[i].id, 0));
+        }
+        write_stream(&c->out, ']');
+        write_stream(&c->out, 0);
+    }
+#endif
     else {
         DIR * proc = NULL;
         char dir[FILE_PATH_SIZE];
@@ -1655,6 +2096,11 @@ extern void ini_sys_mon_service(Protocol * proto) {
     add_command_handler(proto, SYS_MON, "getChildren", command_get_children);
     add_command_handler(proto, SYS_MON, "getCommandLine", command_get_command_line);
     add_command_handler(proto, SYS_MON, "getEnvironment", command_get_environment);
+#if ENABLE_SysMonSampler
+    add_command_handler(proto, SYS_MON, "subscribe", command_subscribe);
+    add_command_handler(proto, SYS_MON, "unsubscribe", command_unsubscribe);
+    add_channel_close_listener(channel_close_listener);
+#endif
 }
 
 #endif /* SERVICE_SysMonitor */
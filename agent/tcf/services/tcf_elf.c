@@ -36,6 +36,7 @@
 #include <tcf/framework/myalloc.h>
 #include <tcf/framework/exceptions.h>
 #include <tcf/framework/events.h>
+#include <tcf/framework/asyncreq.h>
 #include <tcf/framework/cache.h>
 #include <tcf/framework/trace.h>
 #include <tcf/framework/json.h>
@@ -60,7 +61,11 @@
 
 #define MIN_FILE_AGE 3
 #define MAX_FILE_AGE 60
-#define MAX_FILE_CNT 100
+
+/* Memory budget of the ELF file cache, including DWARF and other service caches */
+#ifndef MAX_FILE_CACHE_SIZE
+#define MAX_FILE_CACHE_SIZE ((size_t)512 * 1024 * 1024)
+#endif
 
 #ifndef ARCH_SHF_SMALL
 #define ARCH_SHF_SMALL 0
@@ -80,6 +85,24 @@ typedef struct ElfListState {
     struct ElfListState * next;
 } ElfListState;
 
+typedef struct FileStatItem {
+    char * name;
+    int64_t mtime;
+    int changed;
+} FileStatItem;
+
+typedef struct FileStatRequest {
+    AsyncReqInfo req;
+    FileStatItem * items;
+    unsigned cnt;
+} FileStatRequest;
+
+typedef struct FileCacheUsage {
+    ELF_File * file;
+    size_t size;
+    int mapped;
+} FileCacheUsage;
+
 typedef struct KernelModuleAddress {
     U8_T module_init;
     U8_T module_core;
@@ -99,7 +122,11 @@ static unsigned openlisteners_max = 0;
 static ELFCloseListener * closelisteners = NULL;
 static unsigned closelisteners_cnt = 0;
 static unsigned closelisteners_max = 0;
+static ELFSizeListener * sizelisteners = NULL;
+static unsigned sizelisteners_cnt = 0;
+static unsigned sizelisteners_max = 0;
 static int elf_cleanup_posted = 0;
+static int elf_stat_posted = 0;
 static ino_t elf_ino_cnt = 0;
 static ElfListState * elf_list_state = NULL;
 
@@ -127,6 +154,14 @@ void elf_add_close_listener(ELFCloseListener listener) {
     closelisteners[closelisteners_cnt++] = listener;
 }
 
+void elf_add_size_listener(ELFSizeListener listener) {
+    if (sizelisteners_cnt >= sizelisteners_max) {
+        sizelisteners_max = sizelisteners_max == 0 ? 16 : sizelisteners_max * 2;
+        sizelisteners = (ELFSizeListener *)loc_realloc(sizelisteners, sizeof(ELFSizeListener) * sizelisteners_max);
+    }
+    sizelisteners[sizelisteners_cnt++] = listener;
+}
+
 static void elf_dispose(ELF_File * file) {
     unsigned n;
     assert(file->lock_cnt == 0);
@@ -153,6 +188,8 @@ static void elf_dispose(ELF_File * file) {
             else munmap(s->mmap_addr, s->mmap_size);
 #endif
             loc_free(s->sym_addr_table);
+            loc_free(s->sym_addr_keys);
+            loc_free(s->sym_addr_order);
             loc_free(s->sym_names_hash);
             loc_free(s->sym_names_next);
             loc_free(s->reloc_zones_bondaries);
@@ -231,41 +268,214 @@ static int is_file_mapped(ELF_File * file, int * cache_miss) {
 }
 #endif /* ENABLE_MemoryMap */
 
-static void elf_cleanup_event(void * arg);
+static size_t get_file_cache_size(ELF_File * file) {
+    unsigned n;
+    size_t size = sizeof(ELF_File);
+    size += sizeof(ELF_Section) * file->section_cnt;
+    size += sizeof(ELF_PHeader) * file->pheader_cnt;
+    for (n = 0; n < file->section_cnt; n++) {
+        ELF_Section * s = file->sections + n;
+        if (s->mmap_addr != NULL) size += s->mmap_size;
+        else if (s->data != NULL) size += (size_t)s->size;
+        size += sizeof(ELF_SecSymbol) * s->sym_addr_max;
+        if (s->sym_addr_keys != NULL) size += (sizeof(U8_T) + sizeof(unsigned)) * (s->sym_addr_cnt + 1);
+        if (s->sym_names_hash != NULL) size += sizeof(unsigned) * s->sym_names_hash_size;
+        if (s->sym_names_next != NULL) size += sizeof(unsigned) * s->sym_count;
+        size += sizeof(unsigned) * s->reloc_num_zones;
+    }
+    for (n = 0; n < sizelisteners_cnt; n++) {
+        size += sizelisteners[n](file);
+    }
+    return size;
+}
 
-static void elf_cleanup_cache_client(void * arg) {
+static int file_cache_usage_comparator(const void * x, const void * y) {
+    const FileCacheUsage * a = (const FileCacheUsage *)x;
+    const FileCacheUsage * b = (const FileCacheUsage *)y;
+    if (a->mapped != b->mapped) return a->mapped ? +1 : -1;
+    if (a->file->age > b->file->age) return -1;
+    if (a->file->age < b->file->age) return +1;
+    return 0;
+}
+
+static void remove_file(ELF_File * file) {
     ELF_File * prev = NULL;
-    ELF_File * file = NULL;
-    unsigned file_cnt = 0;
-    unsigned max_file_age = MAX_FILE_AGE;
-    static unsigned event_cnt = 0;
+    ELF_File * next = files;
+    while (next != file) {
+        prev = next;
+        next = next->next;
+    }
+    if (prev != NULL) prev->next = file->next;
+    else files = file->next;
+    elf_dispose(file);
+}
 
-    assert(elf_cleanup_posted);
+#if ENABLE_MemoryMap
+static int mark_file_cache_usage_mapped(FileCacheUsage * buf, unsigned buf_cnt, ELF_File * file) {
+    unsigned i;
+    if (file == NULL) return 0;
+    for (i = 0; i < buf_cnt; i++) {
+        if (buf[i].file != file) continue;
+        if (buf[i].mapped) return 0;
+        buf[i].mapped = 1;
+        return 1;
+    }
+    return 0;
+}
 
-    file = files;
-    while (file != NULL) {
-        if (event_cnt % 5 == 0) {
-            struct stat st;
-            if (!file->mtime_changed && stat(file->name, &st) == 0 && file->mtime != st.st_mtime) {
-                file->mtime_changed = 1;
+static void mark_linked_files_mapped(FileCacheUsage * buf, unsigned buf_cnt) {
+    /* Separate debug info files and dwz files are never mapped,
+     * they are in use while the file that links them is mapped or otherwise in use */
+    int changed = 1;
+    while (changed) {
+        ELF_File * file = files;
+        changed = 0;
+        while (file != NULL) {
+            unsigned i = 0;
+            while (i < buf_cnt && buf[i].file != file) i++;
+            if (i >= buf_cnt || buf[i].mapped) {
+                if (file->debug_info_file_name) {
+                    ELF_File * dbg = find_open_file_by_name(file->debug_info_file_name);
+                    if (mark_file_cache_usage_mapped(buf, buf_cnt, dbg)) changed = 1;
+                }
+                if (mark_file_cache_usage_mapped(buf, buf_cnt, file->dwz_file)) changed = 1;
             }
+            file = file->next;
+        }
+    }
+}
+#endif /* ENABLE_MemoryMap */
+
+static void trim_file_cache(void) {
+    /* Dispose least recently used files until the cache fits into the memory budget,
+     * files that are not mapped into any process go first. Must be called from a cache client. */
+    ELF_File * file = files;
+    FileCacheUsage * buf = NULL;
+    unsigned buf_cnt = 0;
+    unsigned buf_max = 0;
+    size_t total = 0;
+    unsigned i;
+
+    while (file != NULL) {
+        size_t size = get_file_cache_size(file);
+        total += size;
+        if (file->lock_cnt == 0 && file->age > MIN_FILE_AGE) {
+            if (buf_cnt >= buf_max) {
+                buf_max = buf_max == 0 ? 64 : buf_max * 2;
+                buf = (FileCacheUsage *)loc_realloc(buf, sizeof(FileCacheUsage) * buf_max);
+            }
+            buf[buf_cnt].file = file;
+            buf[buf_cnt].size = size;
+            buf[buf_cnt].mapped = 0;
+            buf_cnt++;
         }
         file = file->next;
-        file_cnt++;
     }
+    if (total > MAX_FILE_CACHE_SIZE && buf_cnt > 0) {
+#if ENABLE_MemoryMap
+        for (i = 0; i < buf_cnt; i++) {
+            int cache_miss = 0;
+            if (is_file_mapped(buf[i].file, &cache_miss) || cache_miss) buf[i].mapped = 1;
+        }
+        mark_linked_files_mapped(buf, buf_cnt);
+#endif
+        qsort(buf, buf_cnt, sizeof(FileCacheUsage), file_cache_usage_comparator);
+        for (i = 0; i < buf_cnt && total > MAX_FILE_CACHE_SIZE; i++) {
+            trace(LOG_ELF, "ELF file cache is over budget, evicting %s", buf[i].file->name);
+            total -= buf[i].size;
+            remove_file(buf[i].file);
+        }
+    }
+    loc_free(buf);
+}
 
-    if (file_cnt > MAX_FILE_AGE + MAX_FILE_CNT - MIN_FILE_AGE) {
-        max_file_age = MIN_FILE_AGE;
+static int stat_files_func(void * args) {
+    /* Runs on a worker thread, must not access the file cache */
+    FileStatRequest * r = (FileStatRequest *)args;
+    unsigned i;
+    for (i = 0; i < r->cnt; i++) {
+        struct stat st;
+        FileStatItem * item = r->items + i;
+        if (stat(item->name, &st) == 0 && item->mtime != st.st_mtime) item->changed = 1;
     }
-    else if (file_cnt > MAX_FILE_CNT) {
-        max_file_age = MAX_FILE_AGE + MAX_FILE_CNT - file_cnt;
+    return 0;
+}
+
+static void stat_files_done(void * args) {
+    AsyncReqInfo * req = (AsyncReqInfo *)args;
+    FileStatRequest * r = (FileStatRequest *)req->client_data;
+    unsigned i;
+
+    assert(elf_stat_posted);
+    elf_stat_posted = 0;
+    for (i = 0; i < r->cnt; i++) {
+        FileStatItem * item = r->items + i;
+        if (item->changed) {
+            ELF_File * file = files;
+            while (file != NULL) {
+                if (!file->mtime_changed && file->mtime == item->mtime && strcmp(file->name, item->name) == 0) {
+                    trace(LOG_ELF, "ELF file changed on disk %s", file->name);
+                    file->mtime_changed = 1;
+                }
+                file = file->next;
+            }
+        }
+        loc_free(item->name);
     }
+    loc_free(r->items);
+    loc_free(r);
+}
+
+static void post_stat_files(void) {
+    /* Check files modification time on a worker thread, stat() can block for a long time */
+    FileStatRequest * r = NULL;
+    ELF_File * file = files;
+    unsigned max = 0;
+
+    if (elf_stat_posted) return;
+    r = (FileStatRequest *)loc_alloc_zero(sizeof(FileStatRequest));
+    while (file != NULL) {
+        if (!file->mtime_changed) {
+            FileStatItem * item = NULL;
+            if (r->cnt >= max) {
+                max = max == 0 ? 64 : max * 2;
+                r->items = (FileStatItem *)loc_realloc(r->items, sizeof(FileStatItem) * max);
+            }
+            item = r->items + r->cnt++;
+            item->name = loc_strdup(file->name);
+            item->mtime = file->mtime;
+            item->changed = 0;
+        }
+        file = file->next;
+    }
+    if (r->cnt == 0) {
+        loc_free(r->items);
+        loc_free(r);
+        return;
+    }
+    r->req.type = AsyncReqUser;
+    r->req.done = stat_files_done;
+    r->req.client_data = r;
+    r->req.u.user.func = stat_files_func;
+    r->req.u.user.data = r;
+    elf_stat_posted = 1;
+    async_req_post(&r->req);
+}
+
+static void elf_cleanup_event(void * arg);
+
+static void elf_cleanup_cache_client(void * arg) {
+    ELF_File * prev = NULL;
+    ELF_File * file = NULL;
+    static unsigned event_cnt = 0;
+
+    assert(elf_cleanup_posted);
 
 #if ENABLE_MemoryMap
     file = files;
     while (file != NULL) {
         int cache_miss = 0;
-        if (!file->mtime_changed && file->age > max_file_age && is_file_mapped(file, &cache_miss)) {
+        if (!file->mtime_changed && file->age > MAX_FILE_AGE && is_file_mapped(file, &cache_miss)) {
             file->age = 0;
             if (file->debug_info_file_name) {
                 ELF_File * dbg = find_open_file_by_name(file->debug_info_file_name);
@@ -274,17 +484,18 @@ static void elf_cleanup_cache_client(void * arg) {
         }
         else if (cache_miss) {
             /* May be mapped, don't dispose this time */
-            assert(file->age > max_file_age);
-            file->age = max_file_age;
+            assert(file->age > MAX_FILE_AGE);
+            file->age = MAX_FILE_AGE;
             if (file->debug_info_file_name) {
                 ELF_File * dbg = find_open_file_by_name(file->debug_info_file_name);
-                if (dbg != NULL && dbg->age > max_file_age) dbg->age = max_file_age;
+                if (dbg != NULL && dbg->age > MAX_FILE_AGE) dbg->age = MAX_FILE_AGE;
             }
         }
         file = file->next;
     }
 #endif
 
+    trim_file_cache();
     cache_exit();
     elf_cleanup_posted = 0;
 
@@ -294,7 +505,7 @@ static void elf_cleanup_cache_client(void * arg) {
         if (file->lock_cnt > 0) {
             prev = file;
         }
-        else if (file->age > max_file_age || (file->age > MIN_FILE_AGE && list_is_empty(&context_root))) {
+        else if (file->age > MAX_FILE_AGE || (file->age > MIN_FILE_AGE && list_is_empty(&context_root))) {
             elf_dispose(file);
             if (prev != NULL) prev->next = next;
             else files = next;
@@ -309,6 +520,8 @@ static void elf_cleanup_cache_client(void * arg) {
         file = next;
     }
 
+    if (event_cnt % 5 == 0) post_stat_files();
+
     if (files != NULL) {
         post_event_with_delay(elf_cleanup_event, NULL, 1000000);
         elf_cleanup_posted = 1;
@@ -559,6 +772,7 @@ static int is_debug_info_file(ELF_File * file) {
 }
 
 static void create_symbol_names_hash(ELF_Section * tbl);
+static int check_symbol_names_section(ELF_Section * sec, ELF_Section * tbl);
 
 static void reopen_file(ELF_File * file) {
     int error = 0;
@@ -922,10 +1136,22 @@ static ELF_File * create_elf_cache(const char * file_name) {
     if (error == 0) {
         unsigned m = 0;
         file->section_opd = 0;
+        for (m = 1; m < file->section_cnt; m++) {
+            /* Dynamic symbol tables come with a hash section, which can be used as is */
+            ELF_Section * sec = file->sections + m;
+            ELF_Section * tbl = NULL;
+            if (sec->type != SHT_GNU_HASH && sec->type != SHT_HASH) continue;
+            if (sec->link == 0 || sec->link >= file->section_cnt) continue;
+            tbl = file->sections + sec->link;
+            if (tbl->type != SHT_DYNSYM || tbl->sym_count == 0) continue;
+            if (tbl->sym_names_section != NULL && tbl->sym_names_section->type == SHT_GNU_HASH) continue;
+            if (check_symbol_names_section(sec, tbl)) tbl->sym_names_section = sec;
+        }
         for (m = 1; m < file->section_cnt; m++) {
             ELF_Section * tbl = file->sections + m;
             if (file->machine == EM_PPC64 && strcmp (tbl->name, ".opd") == 0) file->section_opd = m;
             if (tbl->sym_count == 0) continue;
+            if (tbl->sym_names_section != NULL) continue;
             create_symbol_names_hash(tbl);
         }
         file->debug_info_file = is_debug_info_file(file);
@@ -1928,6 +2154,124 @@ static void create_symbol_names_hash(ELF_Section * tbl) {
     }
 }
 
+static U4_T get_hash_word(ELF_Section * sec, U8_T pos) {
+    U4_T x = ((U4_T *)sec->data)[pos];
+    if (sec->file->byte_swap) SWAP(x);
+    return x;
+}
+
+static U4_T calc_gnu_hash(const char * s) {
+    /* Same as calc_symbol_name_hash(), but using the hash function of .gnu.hash sections */
+    U4_T h = 5381;
+    while (*s) {
+        if (s[0] == '@' && s[1] == '@') break;
+        if (s[0] == ' ' && (s[1] == '{' || s[1] == '(' || s[1] == '[')) {
+            s++;
+            continue;
+        }
+        h = h * 33 + (unsigned char)*s++;
+    }
+    return h;
+}
+
+static int is_undef_symbol(ELF_Section * tbl, unsigned n) {
+    U2_T shndx = 0;
+    if (tbl->file->elf64) shndx = ((Elf64_Sym *)tbl->data)[n].st_shndx;
+    else shndx = ((Elf32_Sym *)tbl->data)[n].st_shndx;
+    if (tbl->file->byte_swap) SWAP(shndx);
+    return shndx == SHN_UNDEF;
+}
+
+static int check_symbol_names_section(ELF_Section * sec, ELF_Section * tbl) {
+    U8_T words = sec->size / 4;
+    if (words < 4) return 0;
+    if (elf_load(sec) < 0 || elf_load(tbl) < 0) return 0;
+    if (sec->type == SHT_GNU_HASH) {
+        U4_T nbuckets = get_hash_word(sec, 0);
+        U4_T symoffset = get_hash_word(sec, 1);
+        U4_T bloom_size = get_hash_word(sec, 2);
+        if (nbuckets == 0 || bloom_size == 0) return 0;
+        if (symoffset > tbl->sym_count) return 0;
+        if (words < 4 + (U8_T)bloom_size * (tbl->file->elf64 ? 2 : 1) + nbuckets + (tbl->sym_count - symoffset)) return 0;
+    }
+    else {
+        U4_T nbucket = get_hash_word(sec, 0);
+        U4_T nchain = get_hash_word(sec, 1);
+        if (nbucket == 0 || nchain != tbl->sym_count) return 0;
+        if (words < 2 + (U8_T)nbucket + nchain) return 0;
+    }
+    return 1;
+}
+
+static unsigned next_gnu_hash_symbol(ELF_Section * tbl, U4_T h, unsigned n) {
+    ELF_Section * sec = tbl->sym_names_section;
+    U4_T nbuckets = get_hash_word(sec, 0);
+    U4_T symoffset = get_hash_word(sec, 1);
+    U4_T bloom_size = get_hash_word(sec, 2);
+    U8_T chain = 4 + (U8_T)bloom_size * (tbl->file->elf64 ? 2 : 1) + nbuckets;
+    while (n >= symoffset && n < tbl->sym_count) {
+        U4_T c = get_hash_word(sec, chain + n - symoffset);
+        if ((c | 1) == (h | 1) && !is_undef_symbol(tbl, n)) return n;
+        if (c & 1) break;
+        n++;
+    }
+    return 0;
+}
+
+unsigned elf_find_symbol_by_name(ELF_Section * tbl, const char * name) {
+    ELF_Section * sec = tbl->sym_names_section;
+    if (sec == NULL) {
+        if (tbl->sym_names_hash == NULL) return 0;
+        return tbl->sym_names_hash[calc_symbol_name_hash(name) % tbl->sym_names_hash_size];
+    }
+    if (sec->type == SHT_GNU_HASH) {
+        U4_T h = calc_gnu_hash(name);
+        U4_T nbuckets = get_hash_word(sec, 0);
+        U4_T bloom_size = get_hash_word(sec, 2);
+        U4_T bloom_shift = get_hash_word(sec, 3);
+        U8_T buckets = 4;
+        if (tbl->file->elf64) {
+            U8_T word = ((U8_T *)sec->data)[2 + (h / 64) % bloom_size];
+            U8_T mask = ((U8_T)1 << (h % 64)) | ((U8_T)1 << ((h >> bloom_shift) % 64));
+            if (tbl->file->byte_swap) SWAP(word);
+            if ((word & mask) != mask) return 0;
+            buckets += (U8_T)bloom_size * 2;
+        }
+        else {
+            U4_T word = get_hash_word(sec, 4 + (h / 32) % bloom_size);
+            U4_T mask = ((U4_T)1 << (h % 32)) | ((U4_T)1 << ((h >> bloom_shift) % 32));
+            if ((word & mask) != mask) return 0;
+            buckets += bloom_size;
+        }
+        return next_gnu_hash_symbol(tbl, h, get_hash_word(sec, buckets + h % nbuckets));
+    }
+    else {
+        U4_T nbucket = get_hash_word(sec, 0);
+        unsigned n = get_hash_word(sec, 2 + calc_symbol_name_hash(name) % nbucket);
+        while (n != 0 && n < tbl->sym_count && is_undef_symbol(tbl, n)) n = get_hash_word(sec, 2 + nbucket + n);
+        return n < tbl->sym_count ? n : 0;
+    }
+}
+
+unsigned elf_next_symbol_by_name(ELF_Section * tbl, const char * name, unsigned index) {
+    ELF_Section * sec = tbl->sym_names_section;
+    if (sec == NULL) return tbl->sym_names_next[index];
+    if (sec->type == SHT_GNU_HASH) {
+        U4_T symoffset = get_hash_word(sec, 1);
+        U4_T nbuckets = get_hash_word(sec, 0);
+        U4_T bloom_size = get_hash_word(sec, 2);
+        U8_T chain = 4 + (U8_T)bloom_size * (tbl->file->elf64 ? 2 : 1) + nbuckets;
+        if (get_hash_word(sec, chain + index - symoffset) & 1) return 0;
+        return next_gnu_hash_symbol(tbl, calc_gnu_hash(name), index + 1);
+    }
+    else {
+        U4_T nbucket = get_hash_word(sec, 0);
+        unsigned n = get_hash_word(sec, 2 + nbucket + index);
+        while (n != 0 && n < tbl->sym_count && is_undef_symbol(tbl, n)) n = get_hash_word(sec, 2 + nbucket + n);
+        return n < tbl->sym_count ? n : 0;
+    }
+}
+
 static int section_symbol_comparator(const void * x, const void * y) {
     ELF_SecSymbol * rx = (ELF_SecSymbol *)x;
     ELF_SecSymbol * ry = (ELF_SecSymbol *)y;
@@ -1938,6 +2282,17 @@ static int section_symbol_comparator(const void * x, const void * y) {
     return 0;
 }
 
+static unsigned build_symbol_addr_keys(ELF_Section * sec, unsigned i, unsigned k) {
+    /* In-order walk of the implicit tree maps sorted entries to Eytzinger positions */
+    if (k <= sec->sym_addr_cnt) {
+        i = build_symbol_addr_keys(sec, i, 2 * k);
+        sec->sym_addr_keys[k] = sec->sym_addr_table[i].address;
+        sec->sym_addr_order[k] = i++;
+        i = build_symbol_addr_keys(sec, i, 2 * k + 1);
+    }
+    return i;
+}
+
 static void create_symbol_addr_search_index(ELF_Section * sec) {
     ELF_File * file = sec->file;
     int elf64 = file->elf64;
@@ -2032,36 +2387,32 @@ static void create_symbol_addr_search_index(ELF_Section * sec) {
     }
 
     qsort(sec->sym_addr_table, sec->sym_addr_cnt, sizeof(ELF_SecSymbol), section_symbol_comparator);
+    sec->sym_addr_keys = (U8_T *)loc_alloc(sizeof(U8_T) * (sec->sym_addr_cnt + 1));
+    sec->sym_addr_order = (unsigned *)loc_alloc(sizeof(unsigned) * (sec->sym_addr_cnt + 1));
+    build_symbol_addr_keys(sec, 0, 1);
 }
 
 void elf_find_symbol_by_address(ELF_Section * sec, ContextAddress addr, ELF_SymbolInfo * sym_info) {
-    unsigned l = 0;
-    unsigned h = 0;
+    unsigned n = 0;
+    unsigned k = 1;
+    unsigned i = 0;
+    ELF_SecSymbol * info = NULL;
     memset(sym_info, 0, sizeof(ELF_SymbolInfo));
     if (sec == NULL || addr < sec->addr) return;
-    if (sec->sym_addr_table == NULL) create_symbol_addr_search_index(sec);
-    h = sec->sym_addr_cnt;
-    while (l < h) {
-        unsigned k = (h + l) / 2;
-        ELF_SecSymbol * info = sec->sym_addr_table + k;
-        if (info->address > addr) {
-            h = k;
-        }
-        else {
-            ContextAddress next = (ContextAddress)(k < sec->sym_addr_cnt - 1 ?
-                (info + 1)->address : sec->addr + sec->size);
-            assert(next >= info->address);
-            if (next <= addr) {
-                l = k + 1;
-            }
-            else {
-                unpack_elf_symbol_info(info->section, info->index, sym_info);
-                assert(IS_PPC64_FUNC_OPD(info->section->file, sym_info) || sym_info->section == sec);
-                sym_info->addr_index = k;
-                return;
-            }
-        }
-    }
+    if (sec->sym_addr_keys == NULL) create_symbol_addr_search_index(sec);
+    n = sec->sym_addr_cnt;
+    while (k <= n) k = 2 * k + (sec->sym_addr_keys[k] <= addr);
+    /* Undo trailing right turns: 'k' becomes position of first entry above 'addr', or 0 if none */
+    while (k & 1) k >>= 1;
+    k >>= 1;
+    i = k == 0 ? n : sec->sym_addr_order[k];
+    if (i == 0) return;
+    i--;
+    if (i == n - 1 && addr >= sec->addr + sec->size) return;
+    info = sec->sym_addr_table + i;
+    unpack_elf_symbol_info(info->section, info->index, sym_info);
+    assert(IS_PPC64_FUNC_OPD(info->section->file, sym_info) || sym_info->section == sec);
+    sym_info->addr_index = i;
 }
 
 void elf_prev_symbol_by_address(ELF_SymbolInfo * sym_info) {
@@ -109,6 +109,7 @@
 #define SHT_REL         9
 #define SHT_SHLIB      10
 #define SHT_DYNSYM     11
+#define SHT_GNU_HASH   0x6ffffff6
 
 #define STN_UNDEF       0
 
@@ -513,11 +514,16 @@ struct ELF_Section {
     ELF_SecSymbol * sym_addr_table;
     unsigned sym_addr_cnt;
     unsigned sym_addr_max;
+    /* Addresses of 'sym_addr_table' entries in Eytzinger (breadth-first) order, starting at index 1 */
+    U8_T * sym_addr_keys;
+    unsigned * sym_addr_order;
 
     /* Symbol by name search index */
     unsigned sym_names_hash_size;
     unsigned * sym_names_hash;
     unsigned * sym_names_next;
+    /* .gnu.hash or .hash section that is used instead of 'sym_names_hash' */
+    ELF_Section * sym_names_section;
 
     /* Relocations blocks */
     unsigned reloc_num_zones;
@@ -579,6 +585,15 @@ extern void elf_add_close_listener(ELFCloseListener listener);
 typedef void (*ELFOpenListener)(ELF_File *);
 extern void elf_add_open_listener(ELFOpenListener listener);
 
+/*
+ * Register ELF file cache size callback.
+ * The callback returns amount of memory that a service has allocated
+ * to cache data related to the file. The ELF cache uses the sizes
+ * to keep total memory usage within its budget.
+ */
+typedef size_t (*ELFSizeListener)(ELF_File *);
+extern void elf_add_size_listener(ELFSizeListener listener);
+
 /*
  * Return ELF file that contains DWARF info for given file.
  * On some systems, DWARF is kept in a separate file.
@@ -661,6 +676,19 @@ extern int cmp_symbol_names(const char * x, const char * y);
  */
 extern void unpack_elf_symbol_info(ELF_Section * section, U4_T index, ELF_SymbolInfo * info);
 
+/*
+ * Search symbol table 'tbl' by name.
+ * Return index of first symbol that can have given name, or 0 if none.
+ * The name hash can have collisions, caller should compare names of returned symbols.
+ * Undefined symbols are not returned.
+ */
+extern unsigned elf_find_symbol_by_name(ELF_Section * tbl, const char * name);
+
+/*
+ * Return index of next symbol after 'index' that can have given name, or 0 if none.
+ */
+extern unsigned elf_next_symbol_by_name(ELF_Section * tbl, const char * name, unsigned index);
+
 /*
  * Find ELF symbol by link-time address in a section.
  * Return info for nearest symbol at or before given address.
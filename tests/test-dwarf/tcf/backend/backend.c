@@ -279,8 +279,8 @@ static void print_symbol(Symbol * sym) {
         if (obj->mType != NULL) {
             printf("  Type  : 0x%" PRIX64 "\n", (uint64_t)obj->mType->mID);
         }
-        if (obj->mDefinition != NULL) {
-            printf("  Def   : 0x%" PRIX64 "\n", (uint64_t)obj->mDefinition->mID);
+        if (obj->mFlags & DOIF_definition) {
+            printf("  Def   : 0x%" PRIX64 "\n", (uint64_t)get_object_definition(obj)->mID);
         }
     }
 }
@@ -1555,9 +1555,9 @@ static void test_public_names(void) {
     }
     for (m = 1; m < elf_file->section_cnt; m++) {
         ELF_Section * tbl = elf_file->sections + m;
-        if (tbl->sym_names_hash == NULL) continue;
+        if (tbl->sym_count == 0) continue;
         time_start = time(0);
-        for (n = 0; n < tbl->sym_names_hash_size; n++) {
+        for (n = 0; n < tbl->sym_count; n++) {
             Trap trap;
             if (set_trap(&trap)) {
                 ELF_SymbolInfo sym_info;